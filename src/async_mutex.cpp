@@ -0,0 +1,72 @@
+/*
+ * async_mutex.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <thread>
+
+#include <concurrentfw/async_mutex.hpp>
+
+namespace ConcurrentFW
+{
+
+bool AsyncMutex::LockAwaiter::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+    handle = awaiting;
+    uintptr_t current = mutex.state.load<AtomicMemoryOrder::RELAXED>();
+    while (true)
+    {
+        if (current == UNLOCKED)  // unlocked meanwhile, do not suspend
+        {
+            if (mutex.state.compare_exchange_weak<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(
+                    current, LOCKED
+                ))
+                return false;
+        }
+        else
+        {
+            next = reinterpret_cast<AsyncWaiter*>(current);  // LOCKED: nullptr, end of list
+            if (mutex.state.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(
+                    current, reinterpret_cast<uintptr_t>(static_cast<AsyncWaiter*>(this))
+                ))
+                return true;
+        }
+    }
+}
+
+void AsyncMutex::unlock_contended()
+{
+    AsyncWaiter* waiter = waiters;
+    if (waiter == nullptr)  // take the new waiters, the mutex stays locked for the one to be resumed
+    {
+        AsyncWaiter* newest = reinterpret_cast<AsyncWaiter*>(state.exchange<AtomicMemoryOrder::ACQUIRE>(LOCKED));
+        while (newest != nullptr)  // reverse LIFO into FIFO
+        {
+            AsyncWaiter* older = newest->next;
+            newest->next = waiter;
+            waiter = newest;
+            newest = older;
+        }
+    }
+    waiters = waiter->next;
+    waiter->resume();  // ownership is handed over, the mutex must not be accessed anymore
+}
+
+void AsyncSemaphore::release_contended()
+{
+    // the waiter has committed itself with its fetch_sub, but may not have been enqueued yet
+    AsyncWaiter* waiter = nullptr;
+    for (uint32_t spins = 0; !waiters.dequeue(waiter); spins++)
+    {
+        if (spins < 64)
+            cpu_relax();
+        else
+            std::this_thread::yield();
+    }
+    waiter->resume();  // permit is handed over
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,187 @@
+/*
+ * bump_arena.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <errno.h>
+#include <sys/mman.h>  // mmap(), munmap()
+
+#include <concurrentfw/bump_arena.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+namespace ConcurrentFW
+{
+
+static void* map_memory(size_t bytes)
+{
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) [[unlikely]]
+        throw std::system_error(errno, std::system_category(), "error in mmap()");
+    return mapped;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// chunk pool
+//////////////////////////////////////////////////////////////////////////
+
+BumpArena::ChunkPool::ChunkPool(size_t chunk_pages)
+: chunk_bytes(chunk_pages * page_size())
+{
+    if (chunk_pages == 0)
+        throw std::invalid_argument("chunk must have at least one page");
+}
+
+BumpArena::ChunkPool::~ChunkPool()
+{
+    void* chunk;
+    while ((chunk = free_chunks.pop()) != nullptr)
+        munmap(chunk, chunk_bytes);
+}
+
+void* BumpArena::ChunkPool::acquire()
+{
+    void* chunk = free_chunks.pop();
+    if (chunk == nullptr) [[unlikely]]
+    {
+        chunk = map_memory(chunk_bytes);
+        mapped.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    }
+    return chunk;
+}
+
+void BumpArena::ChunkPool::release(void* chunk)
+{
+    free_chunks.push(chunk);
+}
+
+void BumpArena::ChunkPool::release_list(void* first, void* last)
+{
+    free_chunks.push_list(first, last);
+}
+
+BumpArena::ChunkPool& BumpArena::ChunkPool::global()
+{
+    static ChunkPool pool;
+    return pool;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// arena
+//////////////////////////////////////////////////////////////////////////
+
+BumpArena::BumpArena(ChunkPool& chunk_pool)
+: pool(chunk_pool)
+{}  // first chunk is acquired lazily by first allocation
+
+BumpArena::~BumpArena()
+{
+    reset();
+    if (newest != nullptr)
+        pool.release(newest);
+}
+
+void BumpArena::use_chunk(ChunkHeader* chunk, size_t bytes)
+{
+    current = reinterpret_cast<uintptr_t>(chunk) + sizeof(ChunkHeader);
+    end = reinterpret_cast<uintptr_t>(chunk) + bytes;
+}
+
+void* BumpArena::allocate_slow(size_t bytes, size_t alignment)
+{
+    if (alignment + sizeof(ChunkHeader) >= pool.chunk_size()
+        || bytes > pool.chunk_size() - sizeof(ChunkHeader) - alignment)
+        return allocate_oversized(bytes, alignment);
+
+    // remaining space of current chunk is wasted, but accounted as used
+    stats.bytes_in_use += end - current;
+
+    auto* chunk = static_cast<ChunkHeader*>(pool.acquire());
+    chunk->link = newest;
+    newest = chunk;
+    if (oldest == nullptr)
+        oldest = chunk;
+    use_chunk(chunk, pool.chunk_size());
+
+    stats.chunks_in_use++;
+    update_high_water();
+
+    return allocate(bytes, alignment);  // fits now
+}
+
+void* BumpArena::allocate_oversized(size_t bytes, size_t alignment)
+{
+    const size_t page = page_size();
+    if (bytes > SIZE_MAX / 2 || alignment > SIZE_MAX / 4) [[unlikely]]  // mapped size would overflow
+        throw std::bad_alloc();
+    const size_t mapped_bytes = (sizeof(ChunkHeader) + alignment + bytes + page - 1) & ~(page - 1);
+    auto* chunk = static_cast<ChunkHeader*>(map_memory(mapped_bytes));
+    chunk->link = oversized;
+    chunk->bytes = mapped_bytes;
+    oversized = chunk;
+
+    stats.bytes_in_use += bytes;
+    stats.chunks_in_use++;
+    stats.oversized_allocations++;
+    update_high_water();
+
+    uintptr_t payload = reinterpret_cast<uintptr_t>(chunk) + sizeof(ChunkHeader);
+    return reinterpret_cast<void*>((payload + alignment - 1) & ~(alignment - 1));
+}
+
+void BumpArena::update_high_water() noexcept
+{
+    // bytes in use only grow between resets, so the high water marks need no update on the fast path
+    if (stats.bytes_in_use > stats.bytes_high_water)
+        stats.bytes_high_water = stats.bytes_in_use;
+    if (stats.chunks_in_use > stats.chunks_high_water)
+        stats.chunks_high_water = stats.chunks_in_use;
+}
+
+void BumpArena::reset()
+{
+    update_high_water();
+
+    while (oversized != nullptr)
+    {
+        ChunkHeader* chunk = oversized;
+        oversized = chunk->link;
+        munmap(chunk, chunk->bytes);
+    }
+
+    if (newest != nullptr)
+    {
+        if (newest != oldest)  // give all older chunks back at once
+            pool.release_list(newest->link, oldest);
+        newest->link = nullptr;
+        oldest = newest;
+        use_chunk(newest, pool.chunk_size());
+    }
+
+    stats.bytes_in_use = 0;
+    stats.chunks_in_use = (newest != nullptr) ? 1 : 0;
+    stats.resets++;
+}
+
+BumpArena::Statistics BumpArena::statistics() const noexcept
+{
+    Statistics result = stats;
+    if (result.bytes_in_use > result.bytes_high_water)
+        result.bytes_high_water = result.bytes_in_use;
+    return result;
+}
+
+BumpArena& BumpArena::this_thread()
+{
+    static thread_local BumpArena arena;
+    return arena;
+}
+
+}  // namespace ConcurrentFW
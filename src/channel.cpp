@@ -0,0 +1,250 @@
+/*
+ * channel.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include <concurrentfw/channel.hpp>
+
+namespace ConcurrentFW
+{
+
+EventCount ChannelBase::shared_event;
+Atomic<uint32_t> ChannelBase::shared_waiters {0};
+
+void ChannelBase::link(WaiterList& list, Waiter& waiter) noexcept
+{
+    waiter.previous = list.tail;
+    waiter.next = nullptr;
+    if (list.tail != nullptr)
+        list.tail->next = &waiter;
+    else
+        list.head = &waiter;
+    list.tail = &waiter;
+    waiter.linked = true;
+}
+
+void ChannelBase::unlink(WaiterList& list, Waiter& waiter) noexcept
+{
+    if (waiter.previous != nullptr)
+        waiter.previous->next = waiter.next;
+    else
+        list.head = waiter.next;
+    if (waiter.next != nullptr)
+        waiter.next->previous = waiter.previous;
+    else
+        list.tail = waiter.previous;
+    waiter.linked = false;
+}
+
+ChannelBase::Waiter* ChannelBase::claim_first(WaiterList& list) noexcept
+{
+    for (Waiter* waiter = list.head; waiter != nullptr; waiter = waiter->next)
+    {
+        // fails for waiters of a select(), which was claimed by another channel or takes a case itself
+        size_t expected = SELECT_NONE;
+        if (waiter->claim->compare_exchange_strong<AtomicMemoryOrder::ACQ_REL, AtomicMemoryOrder::RELAXED>(
+                expected, waiter->index
+            ))
+        {
+            unlink(list, *waiter);
+            return waiter;
+        }
+    }
+    return nullptr;
+}
+
+void ChannelBase::wake_all(WaiterList& list) noexcept
+{
+    for (Waiter* waiter = list.head; waiter != nullptr; waiter = waiter->next)
+        notify(*waiter->wakeup);  // waiters unlink themselves
+}
+
+// start of the search, so no case starves another one
+static uint32_t random_start() noexcept
+{
+    thread_local uint32_t state {0x9E3779B9U ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&state))};
+    state ^= state << 13;  // xorshift32
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+namespace
+{
+
+// holds the Futexes of all unbuffered channels of a select(), taken in address order
+class LockAll
+{
+public:
+    LockAll(Futex* const* all_locks, size_t count)
+    : locks(all_locks)
+    {
+        for (; locked < count; locked++)
+            locks[locked]->lock();
+    }
+
+    ~LockAll()
+    {
+        while (locked != 0)
+            locks[--locked]->unlock();
+    }
+
+    LockAll(const LockAll&) = delete;
+    LockAll& operator=(const LockAll&) = delete;
+
+private:
+    Futex* const* locks;
+    size_t locked {0};
+};
+
+}  // namespace
+
+size_t select_cases(SelectCase* const* cases, size_t count, bool block)
+{
+    if (count == 0 || count >= EventCount::WAIT_ANY_MAX)  // one more event for the own wake-up
+        throw std::invalid_argument("select(): 1 to EventCount::WAIT_ANY_MAX - 1 cases");
+
+    Futex* locks[EventCount::WAIT_ANY_MAX];
+    size_t lock_count = 0;
+    for (size_t index = 0; index < count; index++)
+        if (Futex* lock = cases[index]->lock())
+            locks[lock_count++] = lock;
+    std::sort(locks, locks + lock_count, std::less<Futex*>());
+    lock_count = static_cast<size_t>(std::unique(locks, locks + lock_count) - locks);
+
+    const size_t start = random_start() % count;
+    size_t selected = SELECT_NONE;
+    auto attempt = [&]()  // locks are held, true: a case is taken or all cases are finished
+    {
+        bool all_finished = true;
+        for (size_t offset = 0; offset < count; offset++)
+        {
+            const size_t index = (start + offset) % count;
+            if (cases[index]->try_take())
+            {
+                selected = index;
+                return true;
+            }
+            all_finished = all_finished && cases[index]->finished();
+        }
+        if (!all_finished)
+            return false;
+        selected = SELECT_CLOSED;
+        return true;
+    };
+
+    {
+        LockAll guard(locks, lock_count);
+        if (attempt() || !block)
+            return selected;
+    }
+    for (uint32_t spins = 0; spins < ChannelBase::SPINS_BEFORE_PARKING; spins++)
+    {
+        cpu_relax();
+        LockAll guard(locks, lock_count);
+        if (attempt())
+            return selected;
+    }
+
+    // the waiters of the unbuffered cases are linked, until a counterpart claims one of them or select() takes
+    // a case itself, the counterpart wakes this select() with wakeup
+    Atomic<size_t> claim {SELECT_NONE};
+    EventCount wakeup;
+    {
+        LockAll guard(locks, lock_count);
+        if (attempt())
+            return selected;
+        for (size_t index = 0; index < count; index++)
+            cases[index]->park(claim, index, wakeup);
+    }
+    auto parked_attempt = [&]()
+    {
+        LockAll guard(locks, lock_count);
+        const size_t claimed = claim.load<AtomicMemoryOrder::ACQUIRE>();
+        if (claimed != SELECT_NONE)
+            selected = claimed;
+        else
+        {
+            claim.store<AtomicMemoryOrder::RELAXED>(ChannelBase::CLAIM_BUSY);  // own cases must not claim it
+            if (!attempt())
+            {
+                claim.store<AtomicMemoryOrder::RELAXED>(SELECT_NONE);
+                return false;
+            }
+        }
+        for (size_t index = 0; index < count; index++)
+            cases[index]->unpark();
+        return true;
+    };
+
+    bool shared_waiter = false;
+    try
+    {
+        if (EventCount::wait_any_supported())
+        {
+            EventCount* events[EventCount::WAIT_ANY_MAX];
+            EventCount::Key keys[EventCount::WAIT_ANY_MAX];
+            size_t event_count = 0;
+            for (size_t index = 0; index < count; index++)
+                if (EventCount* event = cases[index]->event())
+                    events[event_count++] = event;
+            if (lock_count != 0)
+                events[event_count++] = &wakeup;
+            while (true)
+            {
+                for (size_t index = 0; index < event_count; index++)
+                    keys[index] = events[index]->prepare_wait();
+                if (parked_attempt())
+                {
+                    for (size_t index = 0; index < event_count; index++)
+                        events[index]->cancel_wait();
+                    break;
+                }
+                EventCount::wait_any(events, keys, event_count);
+            }
+        }
+        else
+        {
+            // memory order: channels must see the waiter, before the cases are checked again
+            ChannelBase::shared_waiters.fetch_add<AtomicMemoryOrder::SEQ_CST>(1);
+            shared_waiter = true;
+            while (true)
+            {
+                EventCount::Key key = ChannelBase::shared_event.prepare_wait();
+                if (parked_attempt())
+                {
+                    ChannelBase::shared_event.cancel_wait();
+                    break;
+                }
+                ChannelBase::shared_event.wait(key);
+            }
+            ChannelBase::shared_waiters.fetch_sub<AtomicMemoryOrder::RELAXED>(1);
+        }
+    }
+    catch (...)
+    {
+        if (shared_waiter)
+            ChannelBase::shared_waiters.fetch_sub<AtomicMemoryOrder::RELAXED>(1);
+        LockAll guard(locks, lock_count);
+        for (size_t index = 0; index < count; index++)
+            cases[index]->unpark();
+        const size_t claimed = claim.load<AtomicMemoryOrder::RELAXED>();
+        if (claimed == SELECT_NONE || claimed == ChannelBase::CLAIM_BUSY)
+            throw;
+        selected = claimed;  // too late, a counterpart has taken a case
+    }
+    for (size_t index = 0; index < count; index++)
+        if (index != selected)  // the wake-up for this select() may have been meant for another waiter
+            cases[index]->pass_on();
+    return selected;
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,230 @@
+/*
+ * concurrentfw/async_mutex.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::AsyncMutex, AsyncSemaphore
+// Purpose: C++20 coroutine-aware lock and counting semaphore, which suspend the coroutine instead of the thread
+//
+// AsyncMutex: one word holds the state: UNLOCKED, LOCKED (without new waiters) or the head of a lock-free LIFO
+// list of waiters. co_await lock() takes the single-CAS fast path of Futex (UNLOCKED -> LOCKED), a contending
+// coroutine pushes its awaiter (part of its coroutine frame, no allocation) onto the list and suspends.
+// unlock() detaches the whole list once it finds its owner-private FIFO empty, reverses it into that FIFO and
+// hands the lock directly to the oldest waiter, so the lock stays locked and the waiter cannot be overtaken.
+// AsyncSemaphore: a signed counter (permits minus committed waiters) with a single fetch_sub fast path,
+// waiters are kept in an MsQueue and release() hands its permit to the oldest one.
+// A waiter is resumed inline by the thread calling unlock()/release(), or posted to an executor, if it waits
+// with lock_on()/acquire_on(). An executor is any type with post(std::coroutine_handle<>), e.g. ThreadPool.
+// Inline resumption runs the waiter up to its next suspension inside of unlock()/release().
+
+#pragma once
+#ifndef CONCURRENTFW_ASYNC_MUTEX_HPP
+#define CONCURRENTFW_ASYNC_MUTEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/ms_queue.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename EXECUTOR>
+concept CoroutineExecutor = requires(EXECUTOR& executor, std::coroutine_handle<> handle) { executor.post(handle); };
+
+// suspended coroutine, lives in the awaiter inside of the coroutine frame
+class AsyncWaiter
+{
+public:
+    AsyncWaiter() = default;
+
+    template<CoroutineExecutor EXECUTOR>
+    explicit AsyncWaiter(EXECUTOR& resume_executor)
+    : executor(&resume_executor)
+    , post([](void* target, std::coroutine_handle<> handle) { static_cast<EXECUTOR*>(target)->post(handle); })
+    {}
+
+    void resume()
+    {
+        if (post == nullptr)
+            handle.resume();
+        else
+            post(executor, handle);
+    }
+
+    AsyncWaiter* next {nullptr};
+    std::coroutine_handle<> handle;
+
+private:
+    void* executor {nullptr};
+    void (*post)(void*, std::coroutine_handle<>) {nullptr};
+};
+
+class AsyncMutex
+{
+private:
+    static constexpr uintptr_t LOCKED {0};
+    static constexpr uintptr_t UNLOCKED {1};  // any other value: locked, head of the new waiters
+
+public:
+    class LockAwaiter : public AsyncWaiter
+    {
+    public:
+        explicit LockAwaiter(AsyncMutex& owning_mutex) noexcept
+        : mutex(owning_mutex)
+        {}
+
+        template<CoroutineExecutor EXECUTOR>
+        LockAwaiter(AsyncMutex& owning_mutex, EXECUTOR& resume_executor) noexcept
+        : AsyncWaiter(resume_executor)
+        , mutex(owning_mutex)
+        {}
+
+        ALWAYS_INLINE bool await_ready() noexcept
+        {
+            return mutex.try_lock();
+        }
+
+        bool await_suspend(std::coroutine_handle<> awaiting) noexcept;  // false: acquired meanwhile
+
+        void await_resume() const noexcept
+        {}
+
+    private:
+        AsyncMutex& mutex;
+    };
+
+    AsyncMutex() = default;
+    AsyncMutex(const AsyncMutex&) = delete;
+    AsyncMutex& operator=(const AsyncMutex&) = delete;
+    ~AsyncMutex() = default;  // must not be locked
+
+    ALWAYS_INLINE bool try_lock() noexcept
+    {
+        uintptr_t expected = UNLOCKED;
+        return state.compare_exchange_strong<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(expected, LOCKED);
+    }
+
+    // co_await mutex.lock(): resumed inline by the unlocking coroutine
+    LockAwaiter lock() noexcept
+    {
+        return LockAwaiter(*this);
+    }
+
+    // co_await mutex.lock_on(executor): resumed on the executor, if it had to wait
+    template<CoroutineExecutor EXECUTOR>
+    LockAwaiter lock_on(EXECUTOR& executor) noexcept
+    {
+        return LockAwaiter(*this, executor);
+    }
+
+    ALWAYS_INLINE void unlock()
+    {
+        uintptr_t expected = LOCKED;
+        if (waiters != nullptr
+            || !state.compare_exchange_strong<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(
+                expected, UNLOCKED
+            )) [[unlikely]]
+            unlock_contended();
+    }
+
+private:
+    void unlock_contended();
+
+    Atomic<uintptr_t> state {UNLOCKED};
+    AsyncWaiter* waiters {nullptr};  // FIFO, only accessed by the lock owner
+};
+
+class AsyncSemaphore
+{
+public:
+    class AcquireAwaiter : public AsyncWaiter
+    {
+    public:
+        explicit AcquireAwaiter(AsyncSemaphore& owning_semaphore) noexcept
+        : semaphore(owning_semaphore)
+        {}
+
+        template<CoroutineExecutor EXECUTOR>
+        AcquireAwaiter(AsyncSemaphore& owning_semaphore, EXECUTOR& resume_executor) noexcept
+        : AsyncWaiter(resume_executor)
+        , semaphore(owning_semaphore)
+        {}
+
+        // a waiter is committed by the fetch_sub, it must be queued even if a permit is released meanwhile
+        ALWAYS_INLINE bool await_ready() noexcept
+        {
+            return semaphore.count.fetch_sub<AtomicMemoryOrder::ACQUIRE>(1) > 0;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting)
+        {
+            handle = awaiting;
+            semaphore.waiters.enqueue(this);
+        }
+
+        void await_resume() const noexcept
+        {}
+
+    private:
+        AsyncSemaphore& semaphore;
+    };
+
+    explicit AsyncSemaphore(uint32_t initial = 0, size_t reserved_waiters = 0)
+    : count(initial)
+    , waiters(reserved_waiters)
+    {}
+
+    AsyncSemaphore(const AsyncSemaphore&) = delete;
+    AsyncSemaphore& operator=(const AsyncSemaphore&) = delete;
+    ~AsyncSemaphore() = default;  // must not have waiters
+
+    ALWAYS_INLINE bool try_acquire() noexcept
+    {
+        int64_t current = count.load<AtomicMemoryOrder::RELAXED>();
+        while (current > 0)
+            if (count.compare_exchange_weak<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(
+                    current, current - 1
+                ))
+                return true;
+        return false;
+    }
+
+    AcquireAwaiter acquire() noexcept
+    {
+        return AcquireAwaiter(*this);
+    }
+
+    template<CoroutineExecutor EXECUTOR>
+    AcquireAwaiter acquire_on(EXECUTOR& executor) noexcept
+    {
+        return AcquireAwaiter(*this, executor);
+    }
+
+    ALWAYS_INLINE void release()  // may also be called outside of coroutines
+    {
+        if (count.fetch_add<AtomicMemoryOrder::RELEASE>(1) < 0) [[unlikely]]  // committed waiter
+            release_contended();
+    }
+
+    int64_t available() const noexcept  // negative: number of waiters
+    {
+        return count.load<AtomicMemoryOrder::RELAXED>();
+    }
+
+private:
+    void release_contended();
+
+    Atomic<int64_t> count;  // permits minus committed waiters
+    MsQueue<AsyncWaiter*> waiters;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_ASYNC_MUTEX_HPP
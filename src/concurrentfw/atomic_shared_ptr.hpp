@@ -0,0 +1,273 @@
+/*
+ * concurrentfw/atomic_shared_ptr.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::AtomicSharedPtr
+// Purpose: lock-free atomic std::shared_ptr with split reference counts
+// see: Anthony Williams, "C++ Concurrency in Action", 2nd edition, chapter 7.2.4
+//
+// The published std::shared_ptr is kept in a node. The double word (like in ABA_Wrapper) contains
+// the node pointer and an external count of loaders, which currently access the node.
+// A loader increments the external count, copies the std::shared_ptr out of the node and decrements
+// the external count again. If the node has been replaced meanwhile, the loader decrements the internal count
+// of the node instead. The replacing thread transfers the external count to the internal count,
+// the last one reaching zero deletes the node.
+//
+// On DWCAS platforms the double word is modified with cmpxchg16b (cmpxchg8b),
+// on LL/SC platforms with exclusive load/store pairs (ldaxp/stlxp, ldrexd/strexd).
+// libstdc++ implements std::atomic<std::shared_ptr> with an internal lock instead.
+
+#pragma once
+#ifndef CONCURRENTFW_ATOMIC_SHARED_PTR_HPP
+#define CONCURRENTFW_ATOMIC_SHARED_PTR_HPP
+
+#include <memory>
+#include <utility>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/aba_wrapper.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename T>
+class AtomicSharedPtr
+{
+private:
+    struct Node
+    {
+        explicit Node(std::shared_ptr<T>&& init)
+        : value(std::move(init))
+        {}
+
+        std::shared_ptr<T> value;
+        Atomic<intptr_t> internal_count {0};
+    };
+
+    using Word = Atomic_ABA_BaseType<Node*>;
+
+    struct State
+    {
+        Node* node;
+        Word external_count;  // number of loaders currently accessing node
+    };
+
+    union alignas(ABA_ATOMIC_ALIGNMENT<Node*>) Content
+    {
+        Word atomic[2];
+        State state;
+    };
+
+    static_assert(sizeof(State) == 2 * sizeof(Word), "state does not fit into double word");
+
+public:
+    explicit AtomicSharedPtr(std::shared_ptr<T> init = nullptr)
+    {
+        Content initial;
+        initial.state = {init ? new Node(std::move(init)) : nullptr, 0};
+        if constexpr (ABA_IS_PLATFORM_DWCAS)
+            atomic_dw_store(content.atomic, initial.atomic);
+        else  // constexpr(LLSC)
+            modify(
+                [&initial](const State& /* cached */, State& desired) -> bool
+                {
+                    desired = initial.state;
+                    return true;
+                }
+            );
+    }
+
+    ~AtomicSharedPtr()  // no other thread may access the pointer anymore
+    {
+        delete content.state.node;
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr(AtomicSharedPtr&&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(AtomicSharedPtr&&) = delete;
+
+    // the pointer is never locked, but store(), exchange() and compare_exchange_strong() allocate a node with new,
+    // which is not guaranteed to be lock-free
+    static constexpr bool is_always_lock_free {false};
+
+    std::shared_ptr<T> load()
+    {
+        Node* node = acquire();
+        if (node == nullptr)
+            return nullptr;
+        std::shared_ptr<T> copy = node->value;
+        release(node);
+        return copy;
+    }
+
+    void store(std::shared_ptr<T> desired)
+    {
+        exchange(std::move(desired));  // replaced value is destructed here
+    }
+
+    std::shared_ptr<T> exchange(std::shared_ptr<T> desired)
+    {
+        Node* new_node = desired ? new Node(std::move(desired)) : nullptr;
+        State replaced;
+        modify(
+            [&replaced, new_node](const State& cached, State& next) -> bool
+            {
+                replaced = cached;
+                next = {new_node, 0};
+                return true;
+            }
+        );
+        return detach(replaced);
+    }
+
+    // compares the stored pointers (not the owners), on failure the current value is stored in expected,
+    // a node replaced by one with an equal pointer is no failure, the exchange is retried
+    bool compare_exchange_strong(std::shared_ptr<T>& expected, std::shared_ptr<T> desired)
+    {
+        Node* new_node = nullptr;
+        while (true)
+        {
+            Node* node = acquire();
+            if ((node == nullptr ? nullptr : node->value.get()) != expected.get())
+            {
+                expected = (node == nullptr ? nullptr : node->value);
+                if (node != nullptr)
+                    release(node);
+                delete new_node;
+                return false;
+            }
+
+            if (desired)  // allocated once for all attempts
+                new_node = new Node(std::move(desired));
+            State replaced;
+            bool exchanged = modify(
+                [&replaced, node, new_node](const State& cached, State& next) -> bool
+                {
+                    if (cached.node != node)
+                        return false;
+                    replaced = cached;
+                    next = {new_node, 0};
+                    return true;
+                }
+            );
+            if (exchanged)
+            {
+                if (node != nullptr)
+                {
+                    replaced.external_count--;  // own access ends with the replacement
+                    detach(replaced);
+                }
+                return true;
+            }
+            if (node != nullptr)
+                release(node);
+        }
+    }
+
+private:
+    // returns node with incremented external count
+    ALWAYS_INLINE Node* acquire()
+    {
+        Node* node;
+        modify(
+            [&node](const State& cached, State& next) -> bool
+            {
+                node = cached.node;
+                if (node == nullptr)
+                    return false;
+                next = {cached.node, cached.external_count + 1};
+                return true;
+            }
+        );
+        return node;
+    }
+
+    ALWAYS_INLINE void release(Node* node)
+    {
+        // keeps the external count small as long as the node is published
+        bool released = modify(
+            [node](const State& cached, State& next) -> bool
+            {
+                if (cached.node != node)
+                    return false;
+                next = {cached.node, cached.external_count - 1};
+                return true;
+            }
+        );
+        if (released)
+            return;
+
+        // node has been replaced, external count has been transferred to internal count
+        if (node->internal_count.template fetch_sub<AtomicMemoryOrder::ACQ_REL>(1) == 1)
+            delete node;
+    }
+
+    // transfers external count of a replaced node to the internal count
+    std::shared_ptr<T> detach(const State& replaced)
+    {
+        Node* node = replaced.node;
+        if (node == nullptr)
+            return nullptr;
+        std::shared_ptr<T> value = node->value;  // node is alive until external count is transferred
+        const intptr_t transfer = static_cast<intptr_t>(replaced.external_count);
+        if (node->internal_count.template add_fetch<AtomicMemoryOrder::ACQ_REL>(transfer) == 0)
+            delete node;
+        return value;
+    }
+
+    template<typename MODIFIER>
+    inline bool modify [[gnu::always_inline, ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (MODIFIER&& modifier_func)
+    {
+        bool success;
+        bool stored;
+
+        if constexpr (ABA_IS_PLATFORM_DWCAS)
+        {
+            Content cache;
+            atomic_dw_load(content.atomic, cache.atomic);
+
+            do
+            {
+                Content desired;
+                success = modifier_func(cache.state, desired.state);  // will be inlined
+                if (!success) [[unlikely]]
+                    break;
+                stored = atomic_dw_cas(content.atomic, cache.atomic, desired.atomic);
+            }
+            while (UNLIKELY(!stored));
+        }
+        else  // constexpr(LLSC)
+        {
+            do
+            {
+                Content desired;
+                Content cache;
+                atomic_exclusive_load_pair_aquire(content.atomic, cache.atomic);
+
+                success = modifier_func(cache.state, desired.state);  // will be inlined
+                if (!success) [[unlikely]]
+                {
+                    atomic_exclusive_abort(content.atomic[0]);
+                    break;
+                }
+
+                stored = atomic_exclusive_store_pair_release(content.atomic, desired.atomic);
+            }
+            while (UNLIKELY(!stored));
+        }
+
+        return success;
+    }
+
+    Content content;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_ATOMIC_SHARED_PTR_HPP
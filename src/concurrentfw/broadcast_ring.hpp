@@ -0,0 +1,311 @@
+/*
+ * concurrentfw/broadcast_ring.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::BroadcastRing
+// Purpose: bounded ring for one producer and several consumers, every consumer sees every item
+// see: M. Thompson, D. Farley, M. Barker et al., "Disruptor", https://lmax-exchange.github.io/disruptor/
+//
+// The items stay in one preallocated ring, consumers read them in place, nothing is copied per consumer.
+// The producer publishes the number of written items with a release store, each consumer publishes the number
+// of items it has finished. The per-consumer sequences are allocated separately, padded to cache_line().
+// A consumer can depend on other consumers: it only sees items, which all of its dependencies have finished,
+// so consumers can form a graph (e.g. journal and replicate in parallel, then apply). The producer only
+// overwrites an item, when all consumers have finished it. Both sides cache the sequences of the other side
+// and only reload them, when the cached values indicate a full or an empty ring.
+// Consumers take all available items at once and release them with a single store.
+// WAIT selects how both sides wait: BUSY_SPIN (lowest latency, one core per waiting thread), YIELD (spin, then
+// yield the core) or PARK (spin, then sleep on an EventCount, publish and release only issue a futex wake,
+// if someone sleeps).
+// Consumers must be added before the first item is published.
+
+#pragma once
+#ifndef CONCURRENTFW_BROADCAST_RING_HPP
+#define CONCURRENTFW_BROADCAST_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <bit>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <initializer_list>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/sysconf.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+enum class BroadcastWait : uint8_t
+{
+    BUSY_SPIN,
+    YIELD,
+    PARK
+};
+
+template<typename T, BroadcastWait WAIT = BroadcastWait::PARK>
+class BroadcastRing
+{
+    static_assert(std::is_default_constructible_v<T>, "T must be default constructible");
+
+public:
+    static constexpr uint32_t SPINS_BEFORE_WAITING {256};
+
+    class Consumer
+    {
+    public:
+        Consumer(const Consumer&) = delete;
+        Consumer& operator=(const Consumer&) = delete;
+
+        // waits for at least one item, calls function(const T&) for up to max_items available items in order,
+        // returns the number of items, 0: ring is closed and all items are consumed
+        template<typename FUNC>
+        size_t consume(FUNC&& function, size_t max_items = SIZE_MAX)
+        {
+            const size_t next = consumed.template load<AtomicMemoryOrder::RELAXED>();
+            if (next == available_cached)
+            {
+                ring.wait_until(
+                    [&]()
+                    {
+                        available_cached = barrier();
+                        if (next != available_cached)
+                            return true;
+                        // memory order: all items are published before the ring is closed
+                        if (!ring.closed.template load<AtomicMemoryOrder::ACQUIRE>())
+                            return false;
+                        available_cached = barrier();  // dependencies may still be busy with the last items
+                        return next != available_cached
+                               || next == ring.published.template load<AtomicMemoryOrder::ACQUIRE>();
+                    }
+                );
+                if (next == available_cached)
+                    return 0;
+            }
+            return process(next, std::forward<FUNC>(function), max_items);
+        }
+
+        // as consume(), but does not wait, 0: no item available
+        template<typename FUNC>
+        size_t try_consume(FUNC&& function, size_t max_items = SIZE_MAX)
+        {
+            const size_t next = consumed.template load<AtomicMemoryOrder::RELAXED>();
+            if (next == available_cached)
+            {
+                available_cached = barrier();
+                if (next == available_cached)
+                    return 0;
+            }
+            return process(next, std::forward<FUNC>(function), max_items);
+        }
+
+        size_t sequence() const noexcept  // number of finished items
+        {
+            return consumed.template load<AtomicMemoryOrder::ACQUIRE>();
+        }
+
+    private:
+        friend BroadcastRing;
+
+        Consumer(BroadcastRing& owner, std::initializer_list<const Consumer*> barrier_dependencies)
+        : ring(owner)
+        , dependencies(barrier_dependencies)
+        {}
+
+        ~Consumer() = default;
+
+        // end of the items available for this consumer
+        ALWAYS_INLINE size_t barrier() const noexcept
+        {
+            size_t available = ring.published.template load<AtomicMemoryOrder::ACQUIRE>();
+            for (const Consumer* dependency : dependencies)
+                available = std::min(available, dependency->consumed.template load<AtomicMemoryOrder::ACQUIRE>());
+            return available;
+        }
+
+        template<typename FUNC>
+        ALWAYS_INLINE size_t process(size_t next, FUNC&& function, size_t max_items)
+        {
+            const size_t end = next + std::min(available_cached - next, max_items);
+            for (size_t sequence = next; sequence < end; sequence++)
+                function(static_cast<const T&>(ring.slots[sequence & ring.mask]));
+            // memory order: items are read before the producer may overwrite them
+            consumed.template store<AtomicMemoryOrder::RELEASE>(end);
+            ring.notify_progress();
+            return end - next;
+        }
+
+        Atomic<size_t> consumed {0};  // written by this consumer only
+        size_t available_cached {0};
+        BroadcastRing& ring;
+        const std::vector<const Consumer*> dependencies;
+    };
+
+    explicit BroadcastRing(size_t capacity)
+    : mask(capacity - 1)
+    , slots(std::make_unique<T[]>(capacity))
+    {
+        if (capacity < 2 || !std::has_single_bit(capacity))
+            throw std::invalid_argument("capacity must be a power of two, at least 2");
+    }
+
+    ~BroadcastRing()
+    {
+        for (Consumer* consumer : consumers)
+        {
+            consumer->~Consumer();
+            std::free(consumer);
+        }
+    }
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing(BroadcastRing&&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(BroadcastRing&&) = delete;
+
+    // the consumer sees an item after all dependencies have finished it
+    Consumer& add_consumer(std::initializer_list<const Consumer*> dependencies = {})
+    {
+        if (published.template load<AtomicMemoryOrder::RELAXED>() != 0)
+            throw std::logic_error("BroadcastRing: consumers must be added before the first publish");
+        for (const Consumer* dependency : dependencies)
+            if (std::find(consumers.begin(), consumers.end(), dependency) == consumers.end())
+                throw std::invalid_argument("BroadcastRing: dependency is no consumer of this ring");
+
+        const size_t size = (sizeof(Consumer) + cache_line() - 1) / cache_line() * cache_line();
+        void* memory = std::aligned_alloc(cache_line(), size);
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        consumers.reserve(consumers.size() + 1);
+        Consumer* consumer = new (memory) Consumer(*this, dependencies);
+        consumers.push_back(consumer);
+        return *consumer;
+    }
+
+    /////////////////////////////////////////
+    // producer side
+    /////////////////////////////////////////
+
+    // slot of the next item, blocks while the slowest consumer is a full ring behind
+    ALWAYS_INLINE T& claim()
+    {
+        const size_t position = published.template load<AtomicMemoryOrder::RELAXED>();
+        if (UNLIKELY(position - gating_cached > mask))
+            wait_until(
+                [&]()
+                {
+                    gating_cached = slowest_consumer(position);
+                    return position - gating_cached <= mask;
+                }
+            );
+        return slots[position & mask];
+    }
+
+    // publishes the item written into the slot of claim()
+    ALWAYS_INLINE void publish() noexcept
+    {
+        const size_t position = published.template load<AtomicMemoryOrder::RELAXED>();
+        published.template store<AtomicMemoryOrder::RELEASE>(position + 1);
+        notify_progress();
+    }
+
+    template<typename U>
+    ALWAYS_INLINE void push(U&& item)
+    {
+        claim() = std::forward<U>(item);
+        publish();
+    }
+
+    // consumers return 0 after the last item
+    void close() noexcept
+    {
+        closed.template store<AtomicMemoryOrder::RELEASE>(true);
+        notify_progress();
+    }
+
+    size_t capacity() const noexcept
+    {
+        return mask + 1;
+    }
+
+    size_t sequence() const noexcept  // number of published items
+    {
+        return published.template load<AtomicMemoryOrder::ACQUIRE>();
+    }
+
+private:
+    size_t slowest_consumer(size_t position) const noexcept
+    {
+        size_t slowest = position;
+        for (const Consumer* consumer : consumers)
+            slowest = std::min(slowest, consumer->consumed.template load<AtomicMemoryOrder::ACQUIRE>());
+        return slowest;
+    }
+
+    ALWAYS_INLINE void notify_progress() noexcept
+    {
+        if constexpr (WAIT == BroadcastWait::PARK)
+            progress.notify_all();  // only a syscall, if a thread is parked
+    }
+
+    template<typename READY>
+    void wait_until(READY&& ready)
+    {
+        if constexpr (WAIT == BroadcastWait::BUSY_SPIN)
+        {
+            while (!ready())
+                cpu_relax();
+            return;
+        }
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_WAITING; spins++)
+        {
+            if (ready())
+                return;
+            cpu_relax();
+        }
+        if constexpr (WAIT == BroadcastWait::YIELD)
+        {
+            while (!ready())
+                std::this_thread::yield();
+        }
+        else
+        {
+            while (true)
+            {
+                EventCount::Key key = progress.prepare_wait();
+                if (ready())
+                {
+                    progress.cancel_wait();
+                    return;
+                }
+                progress.wait(key);
+            }
+        }
+    }
+
+    const size_t mask;
+    const std::unique_ptr<T[]> slots;
+    std::vector<Consumer*> consumers;  // fixed after the first publish
+
+    alignas(64) Atomic<size_t> published {0};  // align to cache line, written by the producer only
+    size_t gating_cached {0};                  // producer only
+    alignas(64) Atomic<bool> closed {false};   // align to cache line
+    EventCount progress;                       // any publish or release, only used by PARK
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_BROADCAST_RING_HPP
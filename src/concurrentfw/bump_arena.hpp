@@ -0,0 +1,145 @@
+/*
+ * concurrentfw/bump_arena.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::BumpArena
+// Purpose: bump-pointer allocator for short-lived allocations, which are freed all together with reset().
+// An arena is owned by one thread (see BumpArena::this_thread()), only the chunks are shared:
+// they are recycled through the lock-free Stack of a ChunkPool, new chunks are mapped directly with mmap(),
+// so chunk turnover neither takes a lock nor calls malloc().
+// reset() keeps the newest chunk and hands all older chunks back to the pool with one atomic operation.
+// Allocations which do not fit into a chunk get an own mapping, which is unmapped by reset().
+
+#pragma once
+#ifndef CONCURRENTFW_BUMP_ARENA_HPP
+#define CONCURRENTFW_BUMP_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class BumpArena
+{
+public:
+    static constexpr size_t DEFAULT_CHUNK_PAGES {16};  // 64 KiB with 4 KiB pages
+
+    class ChunkPool
+    {
+    public:
+        explicit ChunkPool(size_t chunk_pages = DEFAULT_CHUNK_PAGES);
+        ~ChunkPool();  // all arenas using this pool must be destroyed before
+
+        ChunkPool(const ChunkPool&) = delete;
+        ChunkPool(ChunkPool&&) = delete;
+        ChunkPool& operator=(const ChunkPool&) = delete;
+        ChunkPool& operator=(ChunkPool&&) = delete;
+
+        void* acquire();  // recycled chunk or freshly mapped one
+        void release(void* chunk);
+        void release_list(void* first, void* last);  // chunks linked in their first word
+
+        size_t chunk_size() const noexcept
+        {
+            return chunk_bytes;
+        }
+
+        size_t mapped_chunks() const noexcept
+        {
+            return mapped.load<AtomicMemoryOrder::RELAXED>();
+        }
+
+        static ChunkPool& global();  // pool with default chunk size
+
+    private:
+        size_t chunk_bytes;
+        Stack free_chunks;
+        Atomic<size_t> mapped {0};
+    };
+
+    struct Statistics
+    {
+        size_t bytes_in_use {0};  // including alignment padding, since last reset()
+        size_t bytes_high_water {0};
+        size_t chunks_in_use {0};  // including chunks of oversized allocations
+        size_t chunks_high_water {0};
+        size_t oversized_allocations {0};
+        size_t resets {0};
+    };
+
+    explicit BumpArena(ChunkPool& chunk_pool = ChunkPool::global());
+    ~BumpArena();
+
+    BumpArena(const BumpArena&) = delete;
+    BumpArena(BumpArena&&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+    BumpArena& operator=(BumpArena&&) = delete;
+
+    // allocate(0) returns a unique pointer like other memory resources, alignment must be a power of two
+    ALWAYS_INLINE void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        if (UNLIKELY(bytes == 0))
+            bytes = 1;
+        uintptr_t aligned = (current + alignment - 1) & ~(alignment - 1);
+        if (UNLIKELY(aligned > end || bytes > end - aligned))  // aligned + bytes may overflow
+            return allocate_slow(bytes, alignment);
+        stats.bytes_in_use += aligned + bytes - current;
+        current = aligned + bytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // objects are never destroyed, so only trivially destructible types are allowed
+    template<typename T, typename... ARGS>
+    T* create(ARGS&&... args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "T must be trivially destructible");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<ARGS>(args)...);
+    }
+
+    void reset();  // O(1), except oversized allocations
+
+    Statistics statistics() const noexcept;
+
+    size_t chunk_size() const noexcept
+    {
+        return pool.chunk_size();
+    }
+
+    static BumpArena& this_thread();  // arena of the calling thread, using the global chunk pool
+
+private:
+    struct ChunkHeader
+    {
+        ChunkHeader* link;  // first word: used by Stack of ChunkPool
+        size_t bytes;       // mapped size, only used for oversized chunks
+    };
+
+    void* allocate_slow(size_t bytes, size_t alignment);
+    void* allocate_oversized(size_t bytes, size_t alignment);
+    void use_chunk(ChunkHeader* chunk, size_t bytes);
+    void update_high_water() noexcept;
+
+    ChunkPool& pool;
+    uintptr_t current {0};
+    uintptr_t end {0};
+    ChunkHeader* newest {nullptr};  // linked list of chunks, newest to oldest
+    ChunkHeader* oldest {nullptr};
+    ChunkHeader* oversized {nullptr};
+    Statistics stats;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_BUMP_ARENA_HPP
@@ -0,0 +1,541 @@
+/*
+ * concurrentfw/channel.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::Channel
+// Purpose: Go-style blocking channel for several senders and receivers, with close() and select()
+// see: The Go Programming Language Specification, "Channel types" and "Select statements", https://go.dev/ref/spec
+//
+// A buffered channel (capacity > 0, rounded up to a power of two) stores its items in an MpmcQueue, send() and
+// recv() spin briefly and then park on the EventCounts readable and writable, notifications only cost a syscall,
+// if someone sleeps. A word counts the senders inside send(), so recv() only reports the end of a closed channel,
+// when no sender can push anymore.
+//
+// An unbuffered channel (capacity 0) is a rendezvous, like the channels of Go: a sender or receiver, which finds
+// no counterpart, links a Waiter on its stack into the channel and parks. The counterpart claims the Waiter with a
+// CAS on its claim word, moves the item directly and wakes it. Both happen under a Futex of the channel, the woken
+// thread takes the Futex once before it returns, so the counterpart has finished the transfer. A waiter, which
+// was not claimed, unlinks itself, nothing is left behind: try_send() and try_recv() never block on a hand-off,
+// they only succeed with a waiting counterpart, close() releases all waiters with false.
+//
+// select() waits for the first of several send and receive cases and runs its function. The Waiters of all its
+// unbuffered cases share one claim word, so only one case can be claimed. While select() takes a case itself,
+// it holds the Futexes of all its unbuffered channels (in address order, so selects cannot deadlock each other)
+// and marks its claim word busy, so its own cases cannot claim each other. It sleeps on the EventCounts of its
+// buffered cases and its own wake-up with one futex_waitv() (Linux 5.16), on older kernels on one EventCount
+// shared by all channels, which every channel notifies while a select() is parked. A woken select() passes the
+// wake-up on to other waiters for the buffered channels of all cases it did not run.
+
+#pragma once
+#ifndef CONCURRENTFW_CHANNEL_HPP
+#define CONCURRENTFW_CHANNEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/mpmc_queue.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+constexpr size_t SELECT_NONE {SIZE_MAX};        // try_select(): no case is ready
+constexpr size_t SELECT_CLOSED {SIZE_MAX - 1};  // all channels of the cases are closed (and drained)
+
+/*
+ * one case of select(), created with on_recv() or on_send()
+ */
+
+class SelectCase
+{
+public:
+    virtual Futex* lock() noexcept = 0;        // unbuffered: held by select() while it takes or parks
+    virtual bool try_take() = 0;               // receives or sends without blocking, does not run the function yet
+    virtual bool finished() const noexcept = 0;  // case can never become ready anymore
+    virtual EventCount* event() noexcept = 0;  // buffered: notified, when the case may have become ready
+    virtual void park(Atomic<size_t>& claim, size_t index, EventCount& wakeup) noexcept = 0;  // unbuffered: link
+    virtual void unpark() noexcept = 0;   // unbuffered: unlink, if not claimed
+    virtual void pass_on() noexcept = 0;  // buffered: wakes another waiter, if the case is ready but not selected
+    virtual void run() = 0;               // runs the function of the taken case
+
+protected:
+    SelectCase() = default;
+    ~SelectCase() = default;
+};
+
+size_t select_cases(SelectCase* const* cases, size_t count, bool block);
+
+class ChannelBase
+{
+public:
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+protected:
+    // waiting sender or receiver of an unbuffered channel, lives on the stack of the waiting thread,
+    // linked into the channel while its Futex is held
+    struct Waiter
+    {
+        Waiter() = default;
+
+        Waiter(Atomic<size_t>* waiter_claim, size_t waiter_index, void* waiter_item, EventCount* waiter_wakeup)
+        : claim(waiter_claim)
+        , index(waiter_index)
+        , item(waiter_item)
+        , wakeup(waiter_wakeup)
+        {}
+
+        Atomic<size_t>* claim {nullptr};  // SELECT_NONE until claimed, shared by all cases of one select()
+        size_t index {0};                 // stored into claim by the claiming counterpart
+        void* item {nullptr};             // T to move from (sender) or to move into (receiver)
+        EventCount* wakeup {nullptr};
+        Waiter* previous {nullptr};
+        Waiter* next {nullptr};
+        bool linked {false};
+    };
+
+    struct WaiterList  // FIFO
+    {
+        Waiter* head {nullptr};
+        Waiter* tail {nullptr};
+    };
+
+    ChannelBase() = default;
+    ~ChannelBase() = default;
+
+    ALWAYS_INLINE static void notify(EventCount& event_count, bool all = false) noexcept
+    {
+        if (all)
+            event_count.notify_all();
+        else
+            event_count.notify_one();
+        // notify() of the EventCount has a full fence, no other fence is needed for this load
+        if (shared_waiters.load<AtomicMemoryOrder::RELAXED>() != 0) [[unlikely]]
+            shared_event.notify_all();
+    }
+
+    template<typename READY>
+    ALWAYS_INLINE static void wait_until(EventCount& event_count, READY&& ready)
+    {
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING; spins++)
+        {
+            if (ready())
+                return;
+            cpu_relax();
+        }
+        while (true)
+        {
+            EventCount::Key key = event_count.prepare_wait();
+            if (ready())
+            {
+                event_count.cancel_wait();
+                return;
+            }
+            event_count.wait(key);
+        }
+    }
+
+    // the Futex of the channel is held for all of them
+    static void link(WaiterList& list, Waiter& waiter) noexcept;
+    static void unlink(WaiterList& list, Waiter& waiter) noexcept;
+    static Waiter* claim_first(WaiterList& list) noexcept;  // unlinks the claimed waiter
+    static void wake_all(WaiterList& list) noexcept;
+
+private:
+    friend size_t select_cases(SelectCase* const* cases, size_t count, bool block);
+
+    static constexpr size_t CLAIM_BUSY {SIZE_MAX - 2};  // select() takes a case itself
+
+    // fallback of select() without futex_waitv()
+    static EventCount shared_event;
+    static Atomic<uint32_t> shared_waiters;
+};
+
+template<typename T, typename FUNC>
+class ChannelRecv;
+
+template<typename T, typename FUNC>
+class ChannelSend;
+
+template<typename T>
+class Channel : public ChannelBase
+{
+    static_assert(std::is_default_constructible_v<T>, "T must be default constructible");
+    static_assert(std::is_nothrow_move_constructible_v<T>, "T must be nothrow move constructible");
+    static_assert(std::is_nothrow_move_assignable_v<T>, "T must be nothrow move assignable");
+
+public:
+    explicit Channel(size_t capacity = 0)  // 0: unbuffered
+    : buffered(capacity != 0)
+    , queue(buffered ? std::bit_ceil(std::max<size_t>(capacity, 2)) : 2)  // unbuffered: stays empty
+    {}
+
+    ~Channel() = default;  // no other thread may use the channel anymore
+
+    Channel(const Channel&) = delete;
+    Channel(Channel&&) = delete;
+    Channel& operator=(const Channel&) = delete;
+    Channel& operator=(Channel&&) = delete;
+
+    // blocks while the channel is full, unbuffered until a receiver has taken the item, false: channel is closed
+    bool send(T item)
+    {
+        if (!buffered)
+            return exchange(item, true, true);
+        if (!enter_send()) [[unlikely]]
+            return false;
+        bool pushed = queue.try_push(std::move(item));
+        if (!pushed) [[unlikely]]
+            wait_until(writable, [&]() { return (pushed = queue.try_push(std::move(item))) || is_closed(); });
+        if (pushed)
+            notify(readable);
+        leave_send();
+        return pushed;
+    }
+
+    // false: channel is full (unbuffered: no receiver is waiting) or closed, item is only moved from on success
+    bool try_send(T& item)
+    {
+        if (!buffered)
+            return exchange(item, true, false);
+        if (!enter_send()) [[unlikely]]
+            return false;
+        const bool pushed = queue.try_push(std::move(item));
+        if (pushed)
+            notify(readable);
+        leave_send();
+        return pushed;
+    }
+
+    // blocks while the channel is empty, false: channel is closed and all items are received
+    bool recv(T& item)
+    {
+        if (!buffered)
+            return exchange(item, false, true);
+        if (take(item)) [[likely]]
+            return true;
+        bool received = false;
+        wait_until(
+            readable,
+            [&]()
+            {
+                if ((received = take(item)))
+                    return true;
+                if (!drained())
+                    return false;
+                received = take(item);  // in case the item of the last sender was pushed meanwhile
+                return true;
+            }
+        );
+        return received;
+    }
+
+    bool try_recv(T& item)  // false: channel is empty (unbuffered: no sender is waiting)
+    {
+        return buffered ? take(item) : exchange(item, false, false);
+    }
+
+    void close()  // idempotent, unbuffered: waiting senders and receivers return false
+    {
+        if (buffered)
+        {
+            if ((send_state.fetch_or<AtomicMemoryOrder::ACQ_REL>(CLOSED) & CLOSED) != 0)
+                return;
+            notify(readable, true);
+            notify(writable, true);
+            return;
+        }
+        std::lock_guard guard(waiters_lock);
+        if ((send_state.fetch_or<AtomicMemoryOrder::ACQ_REL>(CLOSED) & CLOSED) != 0)
+            return;
+        wake_all(senders);
+        wake_all(receivers);
+    }
+
+    bool is_closed() const noexcept
+    {
+        return (send_state.load<AtomicMemoryOrder::ACQUIRE>() & CLOSED) != 0;
+    }
+
+    size_t capacity() const noexcept  // 0: unbuffered
+    {
+        return buffered ? queue.capacity() : 0;
+    }
+
+private:
+    template<typename, typename>
+    friend class ChannelRecv;
+    template<typename, typename>
+    friend class ChannelSend;
+
+    static constexpr uint32_t CLOSED {1U << 31};  // buffered, lower bits: number of senders inside send()
+    static constexpr uint32_t SENDER {1};
+
+    ALWAYS_INLINE bool enter_send() noexcept
+    {
+        if ((send_state.fetch_add<AtomicMemoryOrder::ACQUIRE>(SENDER) & CLOSED) == 0) [[likely]]
+            return true;
+        leave_send();
+        return false;
+    }
+
+    ALWAYS_INLINE void leave_send() noexcept
+    {
+        // memory order: the pushed item is visible to receivers, which find the channel closed without senders
+        if (send_state.sub_fetch<AtomicMemoryOrder::RELEASE>(SENDER) == CLOSED) [[unlikely]]
+            notify(readable, true);
+    }
+
+    ALWAYS_INLINE bool drained() const noexcept  // closed, no senders left and empty
+    {
+        return send_state.load<AtomicMemoryOrder::ACQUIRE>() == CLOSED && queue.size_approx() == 0;
+    }
+
+    ALWAYS_INLINE bool take(T& item)  // buffered
+    {
+        if (!queue.try_pop(item))
+            return false;
+        notify(writable);
+        return true;
+    }
+
+    // unbuffered: hands the item over to a waiting counterpart, if block waits to be claimed by one
+    bool exchange(T& item, bool sending, bool block)
+    {
+        std::unique_lock guard(waiters_lock);
+        if (hand_over(item, sending))
+            return true;
+        if (!block || is_closed())
+            return false;
+
+        Atomic<size_t> claim {SELECT_NONE};
+        EventCount wakeup;
+        Waiter waiter(&claim, 0, &item, &wakeup);
+        link(sending ? senders : receivers, waiter);
+        guard.unlock();
+        try
+        {
+            wait_until(
+                wakeup, [&]() { return claim.load<AtomicMemoryOrder::ACQUIRE>() != SELECT_NONE || is_closed(); }
+            );
+        }
+        catch (...)
+        {
+            guard.lock();
+            if (claim.load<AtomicMemoryOrder::RELAXED>() != SELECT_NONE)
+                return true;  // too late, the item is transferred
+            unlink(sending ? senders : receivers, waiter);
+            throw;
+        }
+        guard.lock();  // a claiming counterpart has finished the transfer
+        if (claim.load<AtomicMemoryOrder::RELAXED>() != SELECT_NONE)
+            return true;
+        unlink(sending ? senders : receivers, waiter);
+        return false;
+    }
+
+    // unbuffered, waiters_lock is held
+    bool hand_over(T& item, bool sending) noexcept
+    {
+        if (is_closed())
+            return false;
+        Waiter* waiter = claim_first(sending ? receivers : senders);
+        if (waiter == nullptr)
+            return false;
+        T& counterpart = *static_cast<T*>(waiter->item);
+        if (sending)
+            counterpart = std::move(item);
+        else
+            item = std::move(counterpart);
+        notify(*waiter->wakeup);  // still locked, the waiter takes the lock before it returns
+        return true;
+    }
+
+    const bool buffered;
+    MpmcQueue<T> queue;
+
+    alignas(64) Atomic<uint32_t> send_state {0};  // align to cache line
+    EventCount writable;
+    alignas(64) EventCount readable;  // align to cache line
+
+    Futex waiters_lock;  // unbuffered only
+    WaiterList senders;
+    WaiterList receivers;
+};
+
+template<typename T, typename FUNC>
+class ChannelRecv final : public SelectCase
+{
+public:
+    ChannelRecv(Channel<T>& recv_channel, FUNC&& recv_function)
+    : channel(recv_channel)
+    , function(std::move(recv_function))
+    {}
+
+    Futex* lock() noexcept override
+    {
+        return channel.buffered ? nullptr : &channel.waiters_lock;
+    }
+
+    bool try_take() override
+    {
+        return channel.buffered ? channel.take(item) : channel.hand_over(item, false);
+    }
+
+    bool finished() const noexcept override
+    {
+        return channel.buffered ? channel.drained() : channel.is_closed();
+    }
+
+    EventCount* event() noexcept override
+    {
+        return channel.buffered ? &channel.readable : nullptr;
+    }
+
+    void park(Atomic<size_t>& claim, size_t index, EventCount& wakeup) noexcept override
+    {
+        if (channel.buffered)
+            return;
+        waiter = typename Channel<T>::Waiter(&claim, index, &item, &wakeup);
+        Channel<T>::link(channel.receivers, waiter);
+    }
+
+    void unpark() noexcept override
+    {
+        if (waiter.linked)
+            Channel<T>::unlink(channel.receivers, waiter);
+    }
+
+    void pass_on() noexcept override
+    {
+        if (channel.buffered && (channel.queue.size_approx() != 0 || channel.is_closed()))
+            Channel<T>::notify(channel.readable);
+    }
+
+    void run() override
+    {
+        function(std::move(item));
+    }
+
+private:
+    Channel<T>& channel;
+    FUNC function;
+    T item {};
+    typename Channel<T>::Waiter waiter;
+};
+
+template<typename T, typename FUNC>
+class ChannelSend final : public SelectCase
+{
+public:
+    ChannelSend(Channel<T>& send_channel, T send_item, FUNC&& send_function)
+    : channel(send_channel)
+    , function(std::move(send_function))
+    , item(std::move(send_item))
+    {}
+
+    Futex* lock() noexcept override
+    {
+        return channel.buffered ? nullptr : &channel.waiters_lock;
+    }
+
+    bool try_take() override
+    {
+        return channel.buffered ? channel.try_send(item) : channel.hand_over(item, true);
+    }
+
+    bool finished() const noexcept override
+    {
+        return channel.is_closed();
+    }
+
+    EventCount* event() noexcept override
+    {
+        return channel.buffered ? &channel.writable : nullptr;
+    }
+
+    void park(Atomic<size_t>& claim, size_t index, EventCount& wakeup) noexcept override
+    {
+        if (channel.buffered)
+            return;
+        waiter = typename Channel<T>::Waiter(&claim, index, &item, &wakeup);
+        Channel<T>::link(channel.senders, waiter);
+    }
+
+    void unpark() noexcept override
+    {
+        if (waiter.linked)
+            Channel<T>::unlink(channel.senders, waiter);
+    }
+
+    void pass_on() noexcept override
+    {
+        if (channel.buffered && channel.queue.size_approx() < channel.queue.capacity())
+            Channel<T>::notify(channel.writable);
+    }
+
+    void run() override
+    {
+        function();
+    }
+
+private:
+    Channel<T>& channel;
+    FUNC function;
+    T item;
+    typename Channel<T>::Waiter waiter;
+};
+
+// case of select(): receives an item and calls function(T&&)
+template<typename T, typename FUNC>
+ChannelRecv<T, std::decay_t<FUNC>> on_recv(Channel<T>& channel, FUNC&& function)
+{
+    return ChannelRecv<T, std::decay_t<FUNC>>(channel, std::decay_t<FUNC>(std::forward<FUNC>(function)));
+}
+
+// case of select(): sends item and calls function()
+template<typename T, typename FUNC>
+ChannelSend<T, std::decay_t<FUNC>> on_send(Channel<T>& channel, T item, FUNC&& function)
+{
+    return ChannelSend<T, std::decay_t<FUNC>>(
+        channel, std::move(item), std::decay_t<FUNC>(std::forward<FUNC>(function))
+    );
+}
+
+// blocks until one case is ready, runs it and returns its index, SELECT_CLOSED: all cases are finished
+template<typename... CASES>
+size_t select(CASES&&... cases)
+{
+    static_assert((std::is_base_of_v<SelectCase, std::remove_reference_t<CASES>> && ...), "on_recv(), on_send()");
+    SelectCase* const list[] {&cases...};
+    const size_t selected = select_cases(list, sizeof...(CASES), true);
+    if (selected < sizeof...(CASES))
+        list[selected]->run();
+    return selected;
+}
+
+// as select(), but returns SELECT_NONE, if no case is ready
+template<typename... CASES>
+size_t try_select(CASES&&... cases)
+{
+    static_assert((std::is_base_of_v<SelectCase, std::remove_reference_t<CASES>> && ...), "on_recv(), on_send()");
+    SelectCase* const list[] {&cases...};
+    const size_t selected = select_cases(list, sizeof...(CASES), false);
+    if (selected < sizeof...(CASES))
+        list[selected]->run();
+    return selected;
+}
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_CHANNEL_HPP
@@ -17,7 +17,16 @@
 namespace ConcurrentFW
 {
 
-template<typename T>
+// reclamation policy of Concurrent_Ptr: replaced objects are not reclaimed, the caller keeps their ownership
+// other policies: EpochReclamation (epoch_reclamation.hpp), HazardReclamation (hazard_pointer.hpp)
+struct NoReclamation
+{
+    template<typename T>
+    static void retire(T* /* object */) noexcept
+    {}
+};
+
+template<typename T, typename RECLAIMER = NoReclamation>
 class Concurrent_Ptr
 {
 public:
@@ -26,8 +35,12 @@ public:
     {}
 
     void set(T* const ptr);
+    T* exchange(T* const ptr);  // returns replaced pointer, e.g. for retiring it
+    void replace(T* const ptr);  // retires replaced object with RECLAIMER
     T* get();
 
+    using Reclaimer = RECLAIMER;
+
     // TODO: [[deprecated("usage of get_counter() only for testing")]]
     typename ABA_Wrapper<T*>::Counter get_counter();
 
@@ -36,8 +49,8 @@ public:
     static constexpr size_t alignment {decltype(aba_ptr)::alignment};
 };
 
-template<typename T>
-void Concurrent_Ptr<T>::set [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (T* const ptr)
+template<typename T, typename RECLAIMER>
+void Concurrent_Ptr<T, RECLAIMER>::set [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (T* const ptr)
 {
     aba_ptr.modify(
         [&](T* const& /* ptr_cached */, T*& ptr_modify) -> bool
@@ -76,14 +89,37 @@ void Concurrent_Ptr<T>::set [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (T* const ptr)
 	 */
 }
 
-template<typename T>
-T* Concurrent_Ptr<T>::get()
+template<typename T, typename RECLAIMER>
+T* Concurrent_Ptr<T, RECLAIMER>::exchange [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (T* const ptr)
+{
+    T* replaced;
+    aba_ptr.modify(
+        [&](T* const& ptr_cached, T*& ptr_modify) -> bool
+        {
+            replaced = ptr_cached;
+            ptr_modify = ptr;
+            return true;
+        }
+    );
+    return replaced;
+}
+
+template<typename T, typename RECLAIMER>
+void Concurrent_Ptr<T, RECLAIMER>::replace(T* const ptr)
+{
+    T* replaced = exchange(ptr);
+    if (replaced != nullptr)
+        RECLAIMER::retire(replaced);  // replaced object is unlinked, readers may still use it
+}
+
+template<typename T, typename RECLAIMER>
+T* Concurrent_Ptr<T, RECLAIMER>::get()
 {
     return aba_ptr.get();
 }
 
-template<typename T>
-typename ABA_Wrapper<T*>::Counter Concurrent_Ptr<T>::get_counter()
+template<typename T, typename RECLAIMER>
+typename ABA_Wrapper<T*>::Counter Concurrent_Ptr<T, RECLAIMER>::get_counter()
 {
     return aba_ptr.get_counter();
 }
@@ -0,0 +1,242 @@
+/*
+ * concurrentfw/coroutine_scheduler.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::CoroutineScheduler, CoroutineTask, co_spawn(), schedule_on()
+// Purpose: work-stealing executor for C++20 coroutines
+//
+// Each worker owns a WorkStealingDeque as FIFO run queue (the owner takes from the top like a thief) and a
+// LIFO slot: a coroutine resumed by a running coroutine (post(), e.g. by AsyncMutex::unlock()) is run next on
+// the same worker while its data is still in the cache, the coroutine it displaces goes to the run queue.
+// The LIFO slot is used at most LIFO_BUDGET times in a row and the global injection queue (MsQueue, for
+// coroutines spawned or posted by other threads) is checked every GLOBAL_QUEUE_INTERVAL tasks, so neither
+// can starve the run queue. Idle workers steal from random victims, spin briefly and park on an EventCount.
+// Frames of CoroutineTasks are allocated from a per-worker cache of power-of-two size classes, a frame is
+// returned to the cache of the worker it finishes on, so after warm-up spawning does not call malloc.
+// CoroutineTasks must not throw, a spawned task destroys its own frame at its end.
+// schedule_on(executor) continues the calling coroutine on any CoroutineExecutor.
+
+#pragma once
+#ifndef CONCURRENTFW_COROUTINE_SCHEDULER_HPP
+#define CONCURRENTFW_COROUTINE_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <coroutine>
+#include <exception>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/ms_queue.hpp>
+#include <concurrentfw/work_stealing_deque.hpp>
+#include <concurrentfw/pool_resource.hpp>
+#include <concurrentfw/async_mutex.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class CoroutineScheduler;
+
+// fire-and-forget coroutine, starts suspended and runs when it is spawned with co_spawn()
+class CoroutineTask
+{
+public:
+    struct promise_type
+    {
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() const noexcept
+            {}
+        };
+
+        CoroutineTask get_return_object() noexcept
+        {
+            return CoroutineTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+        FinalAwaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+        void return_void() const noexcept
+        {}
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+
+        static void* operator new(size_t size);
+        static void operator delete(void* frame, size_t size) noexcept;
+
+        CoroutineScheduler* scheduler {nullptr};
+    };
+
+    CoroutineTask(CoroutineTask&& other) noexcept
+    : handle(std::exchange(other.handle, nullptr))
+    {}
+
+    CoroutineTask(const CoroutineTask&) = delete;
+    CoroutineTask& operator=(const CoroutineTask&) = delete;
+    CoroutineTask& operator=(CoroutineTask&&) = delete;
+
+    ~CoroutineTask()  // not spawned
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+private:
+    friend CoroutineScheduler;
+
+    explicit CoroutineTask(std::coroutine_handle<promise_type> coroutine) noexcept
+    : handle(coroutine)
+    {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+class CoroutineScheduler
+{
+public:
+    static constexpr uint32_t LIFO_BUDGET {3};
+    static constexpr uint32_t GLOBAL_QUEUE_INTERVAL {61};
+
+    explicit CoroutineScheduler(uint32_t workers = 0);  // workers == 0: one worker per hardware thread
+    ~CoroutineScheduler();                              // waits for all spawned tasks
+
+    CoroutineScheduler(const CoroutineScheduler&) = delete;
+    CoroutineScheduler(CoroutineScheduler&&) = delete;
+    CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+    CoroutineScheduler& operator=(CoroutineScheduler&&) = delete;
+
+    void spawn(CoroutineTask&& task);  // appended to the run queue of the calling worker or to the injection queue
+    void post(std::coroutine_handle<> handle);  // resumption, LIFO slot of the calling worker (CoroutineExecutor)
+    void wait_idle();  // until all spawned tasks are finished, must not be called by a task
+
+    uint32_t size() const noexcept
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+    size_t live_tasks() const noexcept
+    {
+        return live.load<AtomicMemoryOrder::ACQUIRE>();
+    }
+
+    // index of the calling worker of this scheduler, -1 for other threads
+    int32_t worker_index() const noexcept;
+
+    // frame cache of the calling worker, nullptr bypasses to operator new/delete
+    static void* allocate_frame(size_t size);
+    static void deallocate_frame(void* frame, size_t size) noexcept;
+
+    static constexpr size_t MIN_FRAME_SIZE {64};
+    static constexpr size_t FRAME_SIZE_CLASSES {7};
+    static constexpr size_t MAX_FRAME_SIZE {MIN_FRAME_SIZE << (FRAME_SIZE_CLASSES - 1)};  // 4 KiB
+    static constexpr uint32_t MAX_CACHED_FRAMES {256};                                    // per size class
+
+private:
+    friend CoroutineTask::promise_type::FinalAwaiter;
+
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+    struct FrameCache
+    {
+        FrameCache() = default;
+        FrameCache(const FrameCache&) = delete;
+        FrameCache& operator=(const FrameCache&) = delete;
+        ~FrameCache();
+
+        UnsynchronizedStack frames[FRAME_SIZE_CLASSES];
+        uint32_t cached[FRAME_SIZE_CLASSES] {};
+    };
+
+    struct alignas(64) Worker  // align to cache line
+    {
+        Worker(CoroutineScheduler& owning_scheduler, uint32_t worker_index)
+        : scheduler(owning_scheduler)
+        , index(worker_index)
+        , random_state(0x9E3779B97F4A7C15ULL * (worker_index + 1))
+        {}
+
+        CoroutineScheduler& scheduler;
+        const uint32_t index;
+        uint64_t random_state;    // xorshift, victim selection
+        uint32_t ticks {0};       // tasks taken, injection queue interval
+        uint32_t lifo_runs {0};   // LIFO slot runs in a row
+        void* lifo {nullptr};     // coroutine address, owner only
+        WorkStealingDeque<void*> queue;
+        FrameCache frame_cache;
+        std::thread thread;
+    };
+
+    static constexpr size_t frame_size_class(size_t size) noexcept
+    {
+        size_t index = 0;
+        while ((MIN_FRAME_SIZE << index) < size)
+            index++;
+        return index;  // FRAME_SIZE_CLASSES or more: too big for cache
+    }
+
+    void worker_loop(Worker& worker);
+    bool find_task(Worker& worker, void*& task);
+    bool steal_task(Worker& worker, void*& task);
+    void finish_task() noexcept;
+
+    static inline constinit thread_local Worker* current_worker {nullptr};
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MsQueue<void*> injection;
+    EventCount idle_workers;
+    alignas(64) Atomic<size_t> live {0};  // align to cache line, spawned and not finished tasks
+    Atomic<bool> stopping {false};
+    EventCount idle_scheduler;
+};
+
+inline void co_spawn(CoroutineScheduler& scheduler, CoroutineTask&& task)
+{
+    scheduler.spawn(std::move(task));
+}
+
+// co_await schedule_on(executor): suspends and continues on the executor
+template<CoroutineExecutor EXECUTOR>
+auto schedule_on(EXECUTOR& executor) noexcept
+{
+    struct ScheduleAwaiter
+    {
+        EXECUTOR& target;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            target.post(handle);
+        }
+        void await_resume() const noexcept
+        {}
+    };
+    return ScheduleAwaiter {executor};
+}
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_COROUTINE_SCHEDULER_HPP
@@ -0,0 +1,167 @@
+/*
+ * concurrentfw/epoch_reclamation.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::EpochDomain
+// Purpose: safe memory reclamation for read-dominated lock-free data structures with epochs
+// see: Keir Fraser, "Practical lock-freedom", PhD thesis, University of Cambridge, 2004
+//
+// Readers enter a critical region (EpochDomain::Guard) by announcing the global epoch in the record of their thread.
+// This costs one fence per critical region instead of one fence per protected load (compare HazardDomain).
+// Retired objects are stamped with the global epoch. The global epoch can only be advanced, when all readers
+// inside a critical region have announced the current epoch. Therefore an object retired in epoch E cannot be
+// referenced anymore when the global epoch has reached E + 2, as all readers have passed two epochs since.
+// Stalled readers block reclamation, so the number of unreclaimed objects is not bounded (unlike hazard pointers).
+//
+// Retired objects are collected per thread and reclaimed in batches. Optionally, a background reclaimer thread
+// takes over the batches, it is parked on an EventCount while there is nothing to do.
+// Objects left by exited threads are adopted by the next batch of another thread (or by the reclaimer thread).
+
+#pragma once
+#ifndef CONCURRENTFW_EPOCH_RECLAMATION_HPP
+#define CONCURRENTFW_EPOCH_RECLAMATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/thread_records.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class EpochDomain
+{
+public:
+    static constexpr size_t RETIRE_THRESHOLD {64};  // batch size per thread
+
+    using Deleter = void (*)(void*);
+
+    struct Retired
+    {
+        void* object;
+        Deleter deleter;
+        uint64_t epoch;
+    };
+
+    struct alignas(64) Record  // align to cache line, announcements are read by all reclaiming threads
+    {
+        Atomic<uint64_t> announced {0};  // (epoch << 1) | 1 inside of critical region, 0 outside
+        Atomic<bool> active {false};
+        Record* next {nullptr};
+        uint32_t nesting {0};          // owner only
+        std::vector<Retired> retired;  // owner only
+    };
+
+    explicit EpochDomain(bool background_reclaimer = false);
+    ~EpochDomain();  // reclaims everything, no other thread may use the domain anymore
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain(EpochDomain&&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+    EpochDomain& operator=(EpochDomain&&) = delete;
+
+    // critical region of the calling thread, can be nested
+    class Guard
+    {
+    public:
+        explicit ALWAYS_INLINE Guard(EpochDomain& epoch_domain = EpochDomain::global())
+        : record(ThreadRecords<EpochDomain, Record>::get(epoch_domain))
+        {
+            if (record->nesting++ == 0)
+            {
+                const uint64_t current = epoch_domain.epoch.load<AtomicMemoryOrder::RELAXED>();
+                record->announced.store<AtomicMemoryOrder::RELAXED>((current << 1) | 1);
+                // the announcement must be visible before any shared pointer is loaded
+                atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+            }
+        }
+
+        ALWAYS_INLINE ~Guard()
+        {
+            if (--record->nesting == 0)
+                record->announced.store<AtomicMemoryOrder::RELEASE>(0);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard(Guard&&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+    private:
+        Record* record;
+    };
+
+    void retire(void* object, Deleter deleter);
+
+    template<typename T>
+    void retire(T* object)
+    {
+        retire(object, [](void* retired) { delete static_cast<T*>(retired); });
+    }
+
+    size_t reclaim();      // advances epoch if possible, reclaims objects of calling thread, returns reclaimed number
+    size_t unreclaimed();  // retired, but not yet reclaimed objects of calling thread
+
+    uint64_t current_epoch() const noexcept
+    {
+        return epoch.load<AtomicMemoryOrder::ACQUIRE>();
+    }
+
+    bool has_background_reclaimer() const noexcept
+    {
+        return reclaimer.joinable();
+    }
+
+    static EpochDomain& global();
+
+private:
+    friend class ThreadRecords<EpochDomain, Record>;
+
+    struct Batch  // retired objects handed over to other threads
+    {
+        std::vector<Retired> retired;
+        Batch* next;
+    };
+
+    Record* acquire_record();
+    void release_record(Record* record);
+
+    bool try_advance();
+    size_t collect(std::vector<Retired>& retired);
+    void hand_over(std::vector<Retired>& retired);
+    void adopt(std::vector<Retired>& retired);
+    void reclaimer_loop();
+
+    Atomic<uint64_t> epoch {0};
+    RecordList<Record> records;
+    Atomic<Batch*> pending {nullptr};
+
+    EventCount wakeup;
+    Atomic<bool> stopping {false};
+    std::vector<Retired> reclaimer_retired;  // reclaimer thread only
+    std::thread reclaimer;                   // started last
+};
+
+// reclamation policy of Concurrent_Ptr: replaced objects are retired to the global epoch domain,
+// readers must access the pointer within an EpochDomain::Guard
+struct EpochReclamation
+{
+    template<typename T>
+    static void retire(T* object)
+    {
+        EpochDomain::global().retire(object);
+    }
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_EPOCH_RECLAMATION_HPP
@@ -0,0 +1,263 @@
+/*
+ * concurrentfw/fiber.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::FiberScheduler, FiberMutex, FiberSemaphore, FiberConditionVariable
+// Purpose: stackful user-space fibers, scheduled M:N onto a pool of worker threads
+//
+// A context switch only saves the callee-saved registers on the stack and exchanges the stack pointer
+// (hand-written assembler for x86_64 and aarch64 in fiber.cpp), there is no syscall and no signal mask handling.
+// Stacks come from a FiberStackPool: mmap()ed with a PROT_NONE guard page below the stack and recycled through
+// a lock-free Stack. Pages are only backed by memory when touched, so an idle fiber costs little more than the
+// pages of its deepest call chain. The fiber control block lives at the top of its own stack.
+// Ready fibers are kept in an MsQueue, idle workers park on an EventCount.
+// The fiber-aware primitives suspend the calling fiber instead of the worker thread: a fiber puts itself on the
+// wait list of the primitive and switches to its worker, which releases the wait list lock after the switch,
+// so a waker can never resume a fiber, which is still running. They may only be used by fibers.
+// A fiber can migrate between workers at each suspension, so fibers must not cache thread local addresses.
+
+#pragma once
+#ifndef CONCURRENTFW_FIBER_HPP
+#define CONCURRENTFW_FIBER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/ms_queue.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class Fiber;
+
+// guard-paged stacks, recycled and only unmapped by the destructor
+class FiberStackPool
+{
+public:
+    explicit FiberStackPool(size_t stack_bytes);  // rounded up to pages, without guard page
+    ~FiberStackPool();                            // all stacks must have been released
+
+    FiberStackPool(const FiberStackPool&) = delete;
+    FiberStackPool(FiberStackPool&&) = delete;
+    FiberStackPool& operator=(const FiberStackPool&) = delete;
+    FiberStackPool& operator=(FiberStackPool&&) = delete;
+
+    void* acquire();  // lowest usable address, the stack grows down from acquire() + stack_size()
+    void release(void* stack) noexcept;
+
+    size_t stack_size() const noexcept
+    {
+        return stack_bytes;
+    }
+
+    size_t mapped_stacks() const noexcept
+    {
+        return mapped.load<AtomicMemoryOrder::RELAXED>();
+    }
+
+private:
+    const size_t guard_bytes;
+    const size_t stack_bytes;
+    Stack free_stacks;
+    Atomic<size_t> mapped {0};
+};
+
+// list of suspended fibers, protected by a spin lock, which is only held for a few instructions
+class FiberWaitList
+{
+public:
+    FiberWaitList() = default;
+    FiberWaitList(const FiberWaitList&) = delete;
+    FiberWaitList& operator=(const FiberWaitList&) = delete;
+
+    ALWAYS_INLINE void lock() noexcept
+    {
+        while (locked.exchange<AtomicMemoryOrder::ACQUIRE>(true))
+            while (locked.load<AtomicMemoryOrder::RELAXED>())
+                cpu_relax();
+    }
+
+    ALWAYS_INLINE void unlock() noexcept
+    {
+        locked.store<AtomicMemoryOrder::RELEASE>(false);
+    }
+
+    void push(Fiber* fiber) noexcept;  // with lock held
+    Fiber* pop() noexcept;             // with lock held, nullptr if empty
+
+    void suspend_and_unlock() noexcept;  // current fiber must have pushed itself, lock is released by its worker
+
+private:
+    Atomic<bool> locked {false};
+    Fiber* head {nullptr};
+    Fiber* tail {nullptr};
+};
+
+class FiberScheduler
+{
+public:
+    static constexpr size_t DEFAULT_STACK_SIZE {64 * 1024};
+
+    // workers == 0: one worker per hardware thread
+    explicit FiberScheduler(uint32_t workers = 0, size_t stack_size = DEFAULT_STACK_SIZE);
+    ~FiberScheduler();  // waits for all fibers
+
+    FiberScheduler(const FiberScheduler&) = delete;
+    FiberScheduler(FiberScheduler&&) = delete;
+    FiberScheduler& operator=(const FiberScheduler&) = delete;
+    FiberScheduler& operator=(FiberScheduler&&) = delete;
+
+    template<typename FUNC>
+    void spawn(FUNC&& func)
+    {
+        spawn_function(std::function<void()>(std::forward<FUNC>(func)));
+    }
+
+    void wait_idle();  // until all fibers have finished, must not be called by a fiber
+
+    size_t live_fibers() const noexcept
+    {
+        return live.load<AtomicMemoryOrder::ACQUIRE>();
+    }
+
+    const FiberStackPool& stacks() const noexcept
+    {
+        return stack_pool;
+    }
+
+    static void yield();      // reschedules the calling fiber
+    static bool in_fiber();   // calling code runs in a fiber
+    static Fiber* current();  // calling fiber
+
+    // resumes a suspended fiber on any worker of its scheduler
+    static void resume(Fiber* fiber);
+
+    // switches from the calling fiber to its worker, which calls after_switch(argument) before it continues
+    static void suspend(void (*after_switch)(void*), void* argument);
+
+private:
+    friend Fiber;
+    struct Worker;
+
+    void spawn_function(std::function<void()>&& func);
+    void worker_loop(Worker& worker);
+    void run(Worker& worker, Fiber* fiber);
+    void finish(Fiber* fiber) noexcept;
+    static Worker* this_worker() noexcept;
+
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+    static constinit thread_local Worker* current_worker;  // nullptr outside of worker threads
+
+    FiberStackPool stack_pool;
+    MsQueue<Fiber*> ready;
+    EventCount ready_event;
+    alignas(64) Atomic<size_t> live {0};  // align to cache line, spawned and not finished fibers
+    EventCount idle_event;
+    Atomic<bool> stopping {false};
+    std::vector<std::thread> threads;
+};
+
+// fiber-aware lock with the single-CAS fast path of Futex (0: unlocked, 1: locked, 2: locked with waiters)
+class FiberMutex
+{
+public:
+    FiberMutex() = default;
+    FiberMutex(const FiberMutex&) = delete;
+    FiberMutex& operator=(const FiberMutex&) = delete;
+
+    ALWAYS_INLINE void lock()
+    {
+        uint32_t expected = 0;
+        if (!state.compare_exchange_strong<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(expected, 1))
+            [[unlikely]]
+            lock_contended();
+    }
+
+    ALWAYS_INLINE bool trylock() noexcept
+    {
+        uint32_t expected = 0;
+        return state.compare_exchange_strong<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(expected, 1);
+    }
+
+    ALWAYS_INLINE void unlock()
+    {
+        if (state.fetch_sub<AtomicMemoryOrder::RELEASE>(1) != 1) [[unlikely]]  // waiters
+            unlock_contended();
+    }
+
+private:
+    void lock_contended();
+    void unlock_contended();
+
+    Atomic<uint32_t> state {0};
+    FiberWaitList waiters;
+};
+
+// counting semaphore, release() hands a permit directly to a suspended fiber
+class FiberSemaphore
+{
+public:
+    explicit FiberSemaphore(uint32_t initial = 0)
+    : permits(initial)
+    {}
+
+    FiberSemaphore(const FiberSemaphore&) = delete;
+    FiberSemaphore& operator=(const FiberSemaphore&) = delete;
+
+    ALWAYS_INLINE bool try_acquire() noexcept
+    {
+        uint32_t current = permits.load<AtomicMemoryOrder::RELAXED>();
+        while (current != 0)
+            if (permits.compare_exchange_weak<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(
+                    current, current - 1
+                ))
+                return true;
+        return false;
+    }
+
+    void acquire();
+    void release();  // may also be called by other threads
+
+private:
+    Atomic<uint32_t> permits;
+    FiberWaitList waiters;
+};
+
+class FiberConditionVariable
+{
+public:
+    FiberConditionVariable() = default;
+    FiberConditionVariable(const FiberConditionVariable&) = delete;
+    FiberConditionVariable& operator=(const FiberConditionVariable&) = delete;
+
+    void wait(FiberMutex& mutex);  // mutex must be locked, it is locked again on return
+
+    template<typename PREDICATE>
+    void wait(FiberMutex& mutex, PREDICATE&& predicate)
+    {
+        while (!predicate())
+            wait(mutex);
+    }
+
+    void notify_one();  // may also be called by other threads
+    void notify_all();
+
+private:
+    FiberWaitList waiters;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_FIBER_HPP
@@ -24,7 +24,9 @@
 #include <sys/syscall.h>  // SYS_futex
 #include <linux/futex.h>  // constants for futex syscall
 
+#include <cstddef>
 #include <cstdint>
+#include <climits>
 #include <bit>
 
 #include <concurrentfw/helper.hpp>
@@ -35,10 +37,14 @@ namespace ConcurrentFW
 {
 
 class Futex;
+class EventCount;
+class TurnSequencer;
 
 class FutexBase
 {
     friend Futex;
+    friend EventCount;
+    friend TurnSequencer;
 
 public:
     enum class Op : uint8_t
@@ -235,6 +241,86 @@ protected:
     void wake(void);
 };
 
+/*
+ * Event Count
+ *
+ * Lets threads wait for an arbitrary condition without lost wakeups,
+ * notifiers only do a syscall if there is at least one waiter.
+ * see: http://www.1024cores.net/home/lock-free-algorithms/eventcounts
+ *
+ * waiter:
+ *   while (!condition()) {
+ *       EventCount::Key key = event_count.prepare_wait();
+ *       if (condition()) { event_count.cancel_wait(); break; }
+ *       event_count.wait(key);
+ *   }
+ *
+ * notifier:
+ *   make condition() true, then call notify_one() or notify_all()
+ */
+
+class EventCount : public FutexBase
+{
+private:
+    static constexpr int WAITER {1};
+    static constexpr int EPOCH {1 << 16};  // lower 16 bits: number of waiters, upper 16 bits: notification epoch
+    static constexpr int WAITERS_MASK {EPOCH - 1};
+
+public:
+    using Key = int;
+
+    EventCount() noexcept
+    : FutexBase(0)
+    {}
+
+    EventCount(const EventCount&) = delete;
+    EventCount(EventCount&&) = delete;
+    ~EventCount() = default;
+    EventCount& operator=(const EventCount&) = delete;
+    EventCount& operator=(EventCount&&) = delete;
+
+    ALWAYS_INLINE Key prepare_wait() noexcept
+    {
+        // memory order: registration must be visible before the condition is checked again
+        return value.fetch_add<AtomicMemoryOrder::SEQ_CST>(WAITER) & ~WAITERS_MASK;
+    }
+
+    ALWAYS_INLINE void cancel_wait() noexcept
+    {
+        value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+    }
+
+    void wait(Key key);                                                 // consumes registration of prepare_wait()
+    bool wait_timeout(Key key, const struct timespec* timeout_relative);  // false in case of timeout
+    bool wait_deadline(Key key, const struct timespec* deadline);  // absolute CLOCK_MONOTONIC, false on timeout
+
+    // waits with futex_waitv() until one of the events is notified, consumes all registrations of prepare_wait()
+    static constexpr size_t WAIT_ANY_MAX {128};
+    static void wait_any(EventCount* const* events, const Key* keys, size_t count);
+    static bool wait_any_supported() noexcept;  // kernel 5.16 and later
+
+    ALWAYS_INLINE void notify_one() noexcept
+    {
+        notify(1);
+    }
+
+    ALWAYS_INLINE void notify_all() noexcept
+    {
+        notify(INT_MAX);
+    }
+
+private:
+    ALWAYS_INLINE void notify(int wakeups) noexcept
+    {
+        // memory order: modified condition must be visible before waiters are checked
+        atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+        if ((value.load<AtomicMemoryOrder::RELAXED>() & WAITERS_MASK) != 0) [[unlikely]]
+            wake(wakeups);
+    }
+
+    void wake(int wakeups) noexcept;
+};
+
 }  // namespace ConcurrentFW
 
 #endif  // CONCURRENTFW_FUTEX_HPP_
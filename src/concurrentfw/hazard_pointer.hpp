@@ -0,0 +1,183 @@
+/*
+ * concurrentfw/hazard_pointer.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::HazardDomain
+// Purpose: safe memory reclamation for lock-free data structures with hazard pointers
+// see: Maged M. Michael, "Hazard Pointers: Safe Memory Reclamation for Lock-Free Objects", IEEE TPDS 2004
+//
+// Readers publish the pointer they are going to dereference in one of the hazard slots of their thread
+// (HazardDomain::Guard), writers retire unlinked objects instead of deleting them.
+// Retired objects are collected per thread and scanned in batches: a scan is started,
+// when the retire list reaches the retire threshold R = max(MIN_RETIRE_THRESHOLD, 2 * H),
+// H being the number of all hazard slots. A scan can only keep objects, which are protected by a hazard slot,
+// so at most H objects survive it and each scan reclaims at least R - H objects (amortised O(1) per retire).
+// Therefore the number of unreclaimed objects per thread is bounded by R, see unreclaimed_bound().
+
+#pragma once
+#ifndef CONCURRENTFW_HAZARD_POINTER_HPP
+#define CONCURRENTFW_HAZARD_POINTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+#include <bit>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/aba_wrapper.hpp>
+#include <concurrentfw/concurrent_ptr.hpp>
+#include <concurrentfw/thread_records.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class HazardDomain
+{
+public:
+    static constexpr size_t SLOTS_PER_THREAD {4};
+    static constexpr size_t MIN_RETIRE_THRESHOLD {64};
+
+    using Deleter = void (*)(void*);
+
+    struct Retired
+    {
+        void* object;
+        Deleter deleter;
+    };
+
+    struct alignas(64) Record  // align to cache line, hazard slots are read by all scanning threads
+    {
+        Atomic<void*> hazards[SLOTS_PER_THREAD];
+        Atomic<bool> active {false};
+        Record* next {nullptr};
+        uint32_t used_slots {0};        // owner only
+        std::vector<Retired> retired;   // owner only
+        std::vector<void*> protected_;  // owner only, scratch buffer for scan
+
+        Record()
+        {
+            for (Atomic<void*>& hazard : hazards)
+                hazard.store<AtomicMemoryOrder::RELAXED>(nullptr);
+        }
+    };
+
+    HazardDomain() = default;
+    ~HazardDomain();  // reclaims everything, no other thread may use the domain anymore
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain(HazardDomain&&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+    HazardDomain& operator=(HazardDomain&&) = delete;
+
+    // owns one hazard slot of the calling thread
+    class Guard
+    {
+    public:
+        explicit Guard(HazardDomain& hazard_domain = HazardDomain::global())
+        : record(ThreadRecords<HazardDomain, Record>::get(hazard_domain))
+        {
+            const int free_slot = std::countr_one(record->used_slots);
+            if (static_cast<size_t>(free_slot) >= SLOTS_PER_THREAD) [[unlikely]]
+                throw std::length_error("no free hazard slot left");
+            record->used_slots |= 1U << free_slot;
+            slot = &record->hazards[free_slot];
+        }
+
+        ~Guard()
+        {
+            reset();
+            record->used_slots &= ~(1U << (slot - &record->hazards[0]));
+        }
+
+        Guard(const Guard&) = delete;
+        Guard(Guard&&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+        // LOADER returns the current value of the shared pointer, it is called until it is stable
+        template<typename LOADER>
+        ALWAYS_INLINE auto protect_with(LOADER&& load)
+        {
+            auto ptr = load();
+            while (true)
+            {
+                // seq_cst: the publication must be visible before the pointer is validated again
+                slot->store<AtomicMemoryOrder::SEQ_CST>(const_cast<void*>(static_cast<const void*>(ptr)));
+                auto validated = load();
+                if (LIKELY(validated == ptr))
+                    return ptr;
+                ptr = validated;
+            }
+        }
+
+        template<typename T>
+        ALWAYS_INLINE T* protect(const Atomic<T*>& source)
+        {
+            return protect_with([&source]() { return source.template load<AtomicMemoryOrder::ACQUIRE>(); });
+        }
+
+        template<typename T, typename RECLAIMER>
+        ALWAYS_INLINE T* protect(Concurrent_Ptr<T, RECLAIMER>& source)
+        {
+            return protect_with([&source]() { return source.get(); });
+        }
+
+        template<typename T>
+        ALWAYS_INLINE T* protect(ABA_Wrapper<T*>& source)
+        {
+            return protect_with([&source]() { return source.get(); });
+        }
+
+        ALWAYS_INLINE void reset() noexcept
+        {
+            slot->store<AtomicMemoryOrder::RELEASE>(nullptr);
+        }
+
+    private:
+        Record* record;
+        Atomic<void*>* slot;
+    };
+
+    void retire(void* object, Deleter deleter);
+
+    template<typename T>
+    void retire(T* object)
+    {
+        retire(object, [](void* retired) { delete static_cast<T*>(retired); });
+    }
+
+    size_t reclaim();                           // scans retired objects of calling thread, returns reclaimed number
+    size_t unreclaimed();                       // retired, but not yet reclaimed objects of calling thread
+    size_t unreclaimed_bound() const noexcept;  // upper limit of unreclaimed objects per thread
+
+    static HazardDomain& global();
+
+private:
+    friend class ThreadRecords<HazardDomain, Record>;
+
+    Record* acquire_record();
+    void release_record(Record* record);
+    size_t scan(Record& record);
+
+    RecordList<Record> records;
+};
+
+// reclamation policy of Concurrent_Ptr: replaced objects are retired to the global hazard domain
+struct HazardReclamation
+{
+    template<typename T>
+    static void retire(T* object)
+    {
+        HazardDomain::global().retire(object);
+    }
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_HAZARD_POINTER_HPP
@@ -29,6 +29,17 @@ static ALWAYS_INLINE void compiler_barrier()
                      : "memory");
 }
 
+// hint for busy waiting loops, reduces power consumption and pipeline flushes at loop exit
+static ALWAYS_INLINE void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i686__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::
+                     : "memory");
+#endif
+}
+
 enum class PlatformWidth : unsigned char
 {
     WIDTH_32 = 32,
@@ -0,0 +1,285 @@
+/*
+ * concurrentfw/mpmc_queue.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::MpmcQueue
+// Purpose: bounded lock-free FIFO queue for multiple producers and multiple consumers
+// see: Dmitry Vyukov, "Bounded MPMC queue", http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+//
+// Each slot carries a sequence number, which tells producers and consumers, whether the slot of a position
+// is free (sequence == position) or filled (sequence == position + 1). Producers and consumers claim positions
+// with a CAS on the enqueue and dequeue position, batches claim several consecutive positions with one CAS.
+// Slots are padded to cache_line(), so producers and consumers of neighboring positions do not share lines.
+//
+// Copies are constructed in claimed slots only for types with a nothrow copy constructor, other types are copied
+// before a slot is claimed and pushed one by one.
+//
+// The blocking push() and pop() spin briefly and then park on an EventCount (a FutexBase), only while the queue
+// is full or empty. Non-blocking and blocking calls may be mixed, every successful call notifies waiters
+// of the other side (no syscall without waiters).
+
+#pragma once
+#ifndef CONCURRENTFW_MPMC_QUEUE_HPP
+#define CONCURRENTFW_MPMC_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <bit>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/sysconf.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename T>
+class MpmcQueue
+{
+    static_assert(std::is_nothrow_move_constructible_v<T>, "T must be nothrow move constructible");
+    static_assert(std::is_nothrow_move_assignable_v<T>, "T must be nothrow move assignable");  // popped after claiming
+    static_assert(std::is_nothrow_destructible_v<T>, "T must be nothrow destructible");
+
+public:
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+    explicit MpmcQueue(size_t capacity)
+    : mask(capacity - 1)
+    , stride((sizeof(Slot) + cache_line() - 1) / cache_line() * cache_line())
+    {
+        if (capacity < 2 || !std::has_single_bit(capacity))
+            throw std::invalid_argument("capacity must be a power of two, at least 2");
+        buffer = static_cast<std::byte*>(std::aligned_alloc(cache_line(), capacity * stride));
+        if (buffer == nullptr)
+            throw std::bad_alloc();
+        for (size_t position = 0; position < capacity; position++)
+            new (&slot(position)) Slot(position);
+    }
+
+    ~MpmcQueue()  // destroys remaining elements, no other thread may use the queue anymore
+    {
+        T item;
+        while (try_pop(item))
+            ;
+        std::free(buffer);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue(MpmcQueue&&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(MpmcQueue&&) = delete;
+
+    bool try_push(const T& item)
+    {
+        return try_push_n(&item, 1) == 1;
+    }
+
+    bool try_push(T&& item)  // item is only moved from, if it was pushed
+    {
+        size_t first;
+        if (claim<true>(1, first) == 0)
+            return false;
+        Slot& claimed_slot = slot(first);
+        new (claimed_slot.storage) T(std::move(item));
+        claimed_slot.sequence.template store<AtomicMemoryOrder::RELEASE>(first + 1);
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& item)
+    {
+        return try_pop_n(&item, 1) == 1;
+    }
+
+    // pushes copies of a prefix of items, returns number of pushed items
+    size_t try_push_n(const T* items, size_t count)
+    {
+        if constexpr (!std::is_nothrow_copy_constructible_v<T>)
+        {
+            // a throwing copy must not leave a claimed slot unpublished, copy before claiming
+            size_t pushed = 0;
+            while (pushed < count)
+            {
+                T copy(items[pushed]);
+                if (!try_push(std::move(copy)))
+                    break;
+                pushed++;
+            }
+            return pushed;
+        }
+        size_t first;
+        const size_t claimed = claim<true>(count, first);
+        for (size_t index = 0; index < claimed; index++)
+        {
+            Slot& claimed_slot = slot(first + index);
+            new (claimed_slot.storage) T(items[index]);
+            claimed_slot.sequence.template store<AtomicMemoryOrder::RELEASE>(first + index + 1);
+        }
+        if (claimed != 0)
+            notify(not_empty, claimed);
+        return claimed;
+    }
+
+    // pops up to count items in FIFO order, returns number of popped items
+    size_t try_pop_n(T* items, size_t count)
+    {
+        size_t first;
+        const size_t claimed = claim<false>(count, first);
+        for (size_t index = 0; index < claimed; index++)
+        {
+            Slot& claimed_slot = slot(first + index);
+            T* stored = std::launder(reinterpret_cast<T*>(claimed_slot.storage));
+            items[index] = std::move(*stored);
+            stored->~T();
+            claimed_slot.sequence.template store<AtomicMemoryOrder::RELEASE>(first + index + mask + 1);
+        }
+        if (claimed != 0)
+            notify(not_full, claimed);
+        return claimed;
+    }
+
+    void push(const T& item)  // blocks while queue is full
+    {
+        wait_until(not_full, [&]() { return try_push(item); });
+    }
+
+    T pop()  // blocks while queue is empty
+    {
+        T item;
+        wait_until(not_empty, [&]() { return try_pop(item); });
+        return item;
+    }
+
+    size_t push_n(const T* items, size_t count)  // blocks until at least one item is pushed
+    {
+        size_t pushed;
+        wait_until(not_full, [&]() { return (pushed = try_push_n(items, count)) != 0; });
+        return pushed;
+    }
+
+    size_t pop_n(T* items, size_t count)  // blocks until at least one item is popped
+    {
+        size_t popped;
+        wait_until(not_empty, [&]() { return (popped = try_pop_n(items, count)) != 0; });
+        return popped;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return mask + 1;
+    }
+
+    size_t size_approx() const noexcept
+    {
+        const size_t dequeued = dequeue_position.template load<AtomicMemoryOrder::RELAXED>();
+        const size_t enqueued = enqueue_position.template load<AtomicMemoryOrder::RELAXED>();
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+private:
+    struct Slot
+    {
+        explicit Slot(size_t init)
+        : sequence(init)
+        {}
+
+        Atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    ALWAYS_INLINE Slot& slot(size_t position) const noexcept
+    {
+        return *std::launder(reinterpret_cast<Slot*>(buffer + (position & mask) * stride));
+    }
+
+    // claims up to count consecutive positions with one CAS, returns number of claimed positions
+    template<bool PRODUCER>
+    ALWAYS_INLINE size_t claim(size_t count, size_t& first)
+    {
+        Atomic<size_t>& position = PRODUCER ? enqueue_position : dequeue_position;
+        constexpr size_t ready_offset = PRODUCER ? 0 : 1;  // sequence of a slot ready for this side
+
+        size_t current = position.template load<AtomicMemoryOrder::RELAXED>();
+        while (true)
+        {
+            size_t ready = 0;
+            intptr_t difference = 0;
+            while (ready < count)
+            {
+                const size_t sequence = slot(current + ready).sequence.template load<AtomicMemoryOrder::ACQUIRE>();
+                difference = static_cast<intptr_t>(sequence - (current + ready + ready_offset));
+                if (difference != 0)
+                    break;
+                ready++;
+            }
+
+            if (ready == 0)
+            {
+                if (difference < 0)  // full (producer) or empty (consumer)
+                    return 0;
+                current = position.template load<AtomicMemoryOrder::RELAXED>();  // other thread was faster
+                continue;
+            }
+
+            if (position.template compare_exchange_weak<AtomicMemoryOrder::RELAXED, AtomicMemoryOrder::RELAXED>(
+                    current, current + ready
+                ))
+            {
+                first = current;
+                return ready;
+            }
+        }
+    }
+
+    ALWAYS_INLINE static void notify(EventCount& event_count, size_t items) noexcept
+    {
+        if (items == 1)
+            event_count.notify_one();
+        else
+            event_count.notify_all();
+    }
+
+    template<typename ATTEMPT>
+    ALWAYS_INLINE static void wait_until(EventCount& event_count, ATTEMPT&& attempt)
+    {
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING; spins++)
+        {
+            if (attempt())
+                return;
+            cpu_relax();
+        }
+        while (true)
+        {
+            EventCount::Key key = event_count.prepare_wait();
+            if (attempt())
+            {
+                event_count.cancel_wait();
+                return;
+            }
+            event_count.wait(key);
+        }
+    }
+
+    const size_t mask;
+    const size_t stride;
+    std::byte* buffer;
+
+    alignas(64) Atomic<size_t> enqueue_position {0};  // align to cache line, written by producers only
+    EventCount not_full;
+    alignas(64) Atomic<size_t> dequeue_position {0};  // align to cache line, written by consumers only
+    EventCount not_empty;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_MPMC_QUEUE_HPP
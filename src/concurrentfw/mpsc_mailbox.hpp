@@ -0,0 +1,172 @@
+/*
+ * concurrentfw/mpsc_mailbox.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::MpscMailbox
+// Purpose: intrusive unbounded FIFO queue for multiple producer threads and one owning consumer thread
+// see: Dmitry Vyukov, "Intrusive MPSC node-based queue",
+//      https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+//
+// Messages derive from MailboxLink, the mailbox never allocates memory. A push is a single exchange of
+// the head pointer followed by a store to the link of the previous message, no CAS loop is needed.
+// Between these two instructions the queue is temporarily disconnected: the consumer sees an empty mailbox
+// and will find the message with the next pop(), the producer notifies the parked owner only afterwards.
+// Only the owner may call pop(), drain() and the waiting variants, the owner parks on an EventCount.
+
+#pragma once
+#ifndef CONCURRENTFW_MPSC_MAILBOX_HPP
+#define CONCURRENTFW_MPSC_MAILBOX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+struct MailboxLink
+{
+    Atomic<MailboxLink*> next {nullptr};
+};
+
+template<typename T>
+class MpscMailbox
+{
+    static_assert(std::is_base_of_v<MailboxLink, T>, "T must derive from MailboxLink");
+
+public:
+    MpscMailbox() = default;
+    MpscMailbox(const MpscMailbox&) = delete;
+    MpscMailbox(MpscMailbox&&) = delete;
+    MpscMailbox& operator=(const MpscMailbox&) = delete;
+    MpscMailbox& operator=(MpscMailbox&&) = delete;
+
+    /////////////////////////////////////////
+    // producer side
+    /////////////////////////////////////////
+
+    ALWAYS_INLINE void push(T* message) noexcept
+    {
+        link(message);
+        owner_event.notify_one();
+    }
+
+    /////////////////////////////////////////
+    // owner side
+    /////////////////////////////////////////
+
+    // nullptr if the mailbox is empty (or a push is still in progress)
+    T* pop() noexcept
+    {
+        MailboxLink* tail_link = tail;
+        MailboxLink* next = tail_link->next.template load<AtomicMemoryOrder::ACQUIRE>();
+        if (tail_link == &stub)  // skip stub
+        {
+            if (next == nullptr)
+                return nullptr;
+            tail = next;
+            tail_link = next;
+            next = next->next.template load<AtomicMemoryOrder::ACQUIRE>();
+        }
+        if (next != nullptr)
+        {
+            tail = next;
+            return static_cast<T*>(tail_link);
+        }
+        if (tail_link != head.template load<AtomicMemoryOrder::ACQUIRE>())
+            return nullptr;  // push in progress, tail_link is not the last message
+        link(&stub);  // last message can only be removed with the stub behind it
+        next = tail_link->next.template load<AtomicMemoryOrder::ACQUIRE>();
+        if (next == nullptr)
+            return nullptr;  // another push came in between, its link is in progress
+        tail = next;
+        return static_cast<T*>(tail_link);
+    }
+
+    // calls func(T*) in FIFO order for all available messages, returns number of messages
+    template<typename FUNC>
+    size_t drain(FUNC&& func)
+    {
+        size_t drained = 0;
+        T* message;
+        while ((message = pop()) != nullptr)
+        {
+            func(message);
+            drained++;
+        }
+        return drained;
+    }
+
+    // parks the owner until a message is available
+    T* pop_wait()
+    {
+        T* message;
+        wait_until([&]() { return (message = pop()) != nullptr; });
+        return message;
+    }
+
+    // parks the owner until at least one message is available, then drains the mailbox
+    template<typename FUNC>
+    size_t drain_wait(FUNC&& func)
+    {
+        T* first = pop_wait();
+        func(first);
+        return 1 + drain(std::forward<FUNC>(func));
+    }
+
+    bool empty() const noexcept
+    {
+        // stub or a message without successor, which is also the last pushed one
+        const MailboxLink* tail_link = tail;
+        return tail_link->next.template load<AtomicMemoryOrder::ACQUIRE>() == nullptr
+               && (tail_link == &stub || tail_link != head.template load<AtomicMemoryOrder::ACQUIRE>());
+    }
+
+private:
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+    ALWAYS_INLINE void link(MailboxLink* message) noexcept
+    {
+        message->next.template store<AtomicMemoryOrder::RELAXED>(nullptr);
+        MailboxLink* previous = head.template exchange<AtomicMemoryOrder::ACQ_REL>(message);
+        previous->next.template store<AtomicMemoryOrder::RELEASE>(message);  // now visible for the owner
+    }
+
+    template<typename ATTEMPT>
+    void wait_until(ATTEMPT&& attempt)
+    {
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING; spins++)
+        {
+            if (attempt())
+                return;
+            cpu_relax();
+        }
+        while (true)
+        {
+            EventCount::Key key = owner_event.prepare_wait();
+            if (attempt())
+            {
+                owner_event.cancel_wait();
+                return;
+            }
+            owner_event.wait(key);
+        }
+    }
+
+    alignas(64) Atomic<MailboxLink*> head {&stub};  // align to cache line, exchanged by producers
+    EventCount owner_event;
+    alignas(64) MailboxLink* tail {&stub};  // align to cache line, owner only
+    MailboxLink stub;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_MPSC_MAILBOX_HPP
@@ -0,0 +1,223 @@
+/*
+ * concurrentfw/ms_queue.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::MsQueue
+// Purpose: unbounded lock-free FIFO queue for multiple producers and multiple consumers
+// see: Maged M. Michael, Michael L. Scott, "Simple, Fast, and Practical Non-Blocking and Blocking
+//      Concurrent Queue Algorithms", PODC 1996
+//
+// Head, tail and the next pointers of the nodes are ABA_Wrapper pointers, so the queue uses DWCAS
+// on x86_64 and LL/SC on aarch64. The queue always contains a dummy node, a dequeue moves head to the
+// successor of the dummy node, which becomes the new dummy node.
+// Nodes are never freed while the queue exists, they are recycled through a lock-free Stack, so memory of
+// a node can always be read (type-stable memory) and the queue does not call malloc() in steady state.
+// Each reuse of a node increments its incarnation, so an enqueue cannot link to or swing the tail to a
+// node, which has been dequeued and recycled meanwhile (the second part of the ABA protection of the paper).
+// T is read speculatively before the dequeue is validated, so it must be trivially copyable.
+// An empty queue is validated the same way: head is exchanged with itself, so dequeue() only fails, if the dummy
+// node had no successor while it was still the head (a consistent snapshot, as the re-check of head in the paper).
+
+#pragma once
+#ifndef CONCURRENTFW_MS_QUEUE_HPP
+#define CONCURRENTFW_MS_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/aba_wrapper.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename T>
+class MsQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+
+public:
+    explicit MsQueue(size_t reserved_nodes = 0)
+    {
+        for (size_t node = 0; node < reserved_nodes; node++)
+            free_nodes.push(new Node);
+        Node* dummy = allocate();
+        head.modify(
+            [dummy](Node* const& /* cached */, Node*& desired) -> bool
+            {
+                desired = dummy;
+                return true;
+            }
+        );
+        tail.modify(
+            [dummy](Node* const& /* cached */, Node*& desired) -> bool
+            {
+                desired = dummy;
+                return true;
+            }
+        );
+    }
+
+    ~MsQueue()  // no other thread may use the queue anymore
+    {
+        Node* node = head.get();
+        while (node != nullptr)
+        {
+            Node* next = node->next.get();
+            delete node;
+            node = next;
+        }
+        while ((node = static_cast<Node*>(free_nodes.pop())) != nullptr)
+            delete node;
+    }
+
+    MsQueue(const MsQueue&) = delete;
+    MsQueue(MsQueue&&) = delete;
+    MsQueue& operator=(const MsQueue&) = delete;
+    MsQueue& operator=(MsQueue&&) = delete;
+
+    void enqueue(const T& value)
+    {
+        Node* node = allocate();
+        node->value = value;
+
+        while (true)
+        {
+            Node* tail_node = tail.get();
+            const uint64_t incarnation = tail_node->incarnation.template load<AtomicMemoryOrder::ACQUIRE>();
+            if (tail.get() != tail_node)  // incarnation might belong to a recycled node
+                continue;
+
+            Node* next = nullptr;
+            const bool linked = tail_node->next.modify(
+                [&](Node* const& next_cached, Node*& next_desired) -> bool
+                {
+                    if (next_cached != nullptr)  // tail is lagging behind
+                    {
+                        next = next_cached;
+                        return false;
+                    }
+                    if (tail_node->incarnation.template load<AtomicMemoryOrder::ACQUIRE>() != incarnation)
+                        return false;  // recycled meanwhile, not linked into the queue yet
+                    next_desired = node;
+                    return true;
+                }
+            );
+
+            if (linked)
+            {
+                swing_tail(tail_node, incarnation, node);  // may fail, if another thread has helped
+                return;
+            }
+            if (next != nullptr)
+                swing_tail(tail_node, incarnation, next);
+        }
+    }
+
+    bool dequeue(T& value)
+    {
+        while (true)
+        {
+            bool empty = false;
+            Node* dummy;
+            const bool exchanged = head.modify(
+                [&](Node* const& head_cached, Node*& head_desired) -> bool
+                {
+                    dummy = head_cached;
+                    empty = false;
+                    Node* next = head_cached->next.get();
+                    if (next == nullptr)
+                    {
+                        // the node might have been dequeued and recycled as the tail meanwhile, so the queue is
+                        // only empty, if head is still unchanged: validated by exchanging head with itself
+                        empty = true;
+                        head_desired = head_cached;
+                        return true;
+                    }
+                    if (head_cached == tail.get())  // head must not overtake the tail, which is lagging behind
+                        return false;
+                    value = next->value;  // speculative read, validated by the exchange of head
+                    head_desired = next;
+                    return true;
+                }
+            );
+
+            if (exchanged)
+            {
+                if (empty)
+                    return false;
+                free_nodes.push(dummy);
+                return true;
+            }
+            help_tail();
+        }
+    }
+
+    bool empty()
+    {
+        return head.get()->next.get() == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        Stack::UnspecifiedBlock free_link {nullptr};  // used by free Stack, next must not be overwritten
+        Atomic<uint64_t> incarnation {0};
+        ABA_Wrapper<Node*> next {nullptr};
+        T value {};
+    };
+
+    Node* allocate()
+    {
+        Node* node = static_cast<Node*>(free_nodes.pop());
+        if (node == nullptr)
+            node = new Node;
+        node->incarnation.template add_fetch<AtomicMemoryOrder::RELEASE>(1);  // before next is reset
+        node->next.modify(
+            [](Node* const& /* cached */, Node*& desired) -> bool
+            {
+                desired = nullptr;
+                return true;
+            }
+        );
+        return node;
+    }
+
+    void swing_tail(Node* tail_node, uint64_t incarnation, Node* successor)
+    {
+        tail.modify(
+            [&](Node* const& tail_cached, Node*& tail_desired) -> bool
+            {
+                if (tail_cached != tail_node
+                    || tail_node->incarnation.template load<AtomicMemoryOrder::ACQUIRE>() != incarnation)
+                    return false;
+                tail_desired = successor;
+                return true;
+            }
+        );
+    }
+
+    void help_tail()
+    {
+        Node* tail_node = tail.get();
+        const uint64_t incarnation = tail_node->incarnation.template load<AtomicMemoryOrder::ACQUIRE>();
+        Node* next = tail_node->next.get();
+        if (next != nullptr && tail.get() == tail_node)
+            swing_tail(tail_node, incarnation, next);
+    }
+
+    alignas(64) ABA_Wrapper<Node*> head {nullptr};  // align to cache line, used by consumers
+    alignas(64) ABA_Wrapper<Node*> tail {nullptr};  // align to cache line, used by producers
+    Stack free_nodes;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_MS_QUEUE_HPP
@@ -0,0 +1,84 @@
+/*
+ * concurrentfw/numa_pool.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::NumaPool
+// Purpose: fixed-size block pool with one lock-free free list per NUMA node.
+// Every node owns its own contiguous region, which is bound to the node with a raw mbind() syscall,
+// so there is no dependency on libnuma. Blocks are allocated on the node of the calling thread
+// and always return to the free list of their home node, which is derived from the block address.
+// The memory regions are unmapped only in the destructor, so Stack::pop() may safely dereference
+// blocks which have already been popped by other threads.
+
+#pragma once
+#ifndef CONCURRENTFW_NUMA_POOL_HPP
+#define CONCURRENTFW_NUMA_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/stack.hpp>
+
+namespace ConcurrentFW
+{
+
+size_t numa_nodes();         // number of possible NUMA nodes (at least 1)
+size_t numa_current_node();  // NUMA node of the CPU the calling thread currently runs on
+
+class NumaPool
+{
+public:
+    static constexpr size_t BLOCK_ALIGNMENT {alignof(std::max_align_t)};
+
+    NumaPool(size_t block_size, size_t blocks_per_node);
+    ~NumaPool();
+
+    NumaPool(const NumaPool&) = delete;
+    NumaPool(NumaPool&&) = delete;
+    NumaPool& operator=(const NumaPool&) = delete;
+    NumaPool& operator=(NumaPool&&) = delete;
+
+    void* allocate();                     // node of calling thread first, then other nodes, nullptr if exhausted
+    void* allocate_on(size_t node);       // only the given node, nullptr if exhausted
+    void deallocate(void* block);         // returns block to its home node
+    size_t home_node(const void* block) const;
+    bool owns(const void* block) const;
+
+    size_t nodes() const noexcept
+    {
+        return node_count;
+    }
+
+    size_t block_size() const noexcept
+    {
+        return block_bytes;
+    }
+
+    size_t blocks_per_node() const noexcept
+    {
+        return node_blocks;
+    }
+
+private:
+    struct alignas(64) NodeList  // align to cache line, as each node list is modified independently
+    {
+        Stack free_list;
+        Atomic<size_t> carved {0};  // blocks carved from the node region so far
+    };
+
+    size_t node_count;
+    size_t block_bytes;
+    size_t node_blocks;
+    size_t region_bytes;  // page aligned size of one node region
+    std::byte* memory;
+    NodeList* node_lists;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_NUMA_POOL_HPP
@@ -0,0 +1,338 @@
+/*
+ * concurrentfw/parallel_algorithms.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::parallel_for(), parallel_reduce(), parallel_inclusive_scan(), parallel_sort()
+// Purpose: data-parallel building blocks on the work-stealing ThreadPool
+// see: Alexandros Tzannes et al., "Lazy Binary Splitting", PPoPP 2010
+//      Peter Sanders, Sebastian Winkel, "Super Scalar Sample Sort", ESA 2004
+//
+// parallel_for() uses lazy binary splitting: a range is processed in chunks of the grain size, the remaining
+// range is only split in halves (and the right half is offered to thieves), while the deque of the executing
+// worker is empty. So splitting adapts to the load: busy pools split rarely, stealing workers cause new splits.
+// The automatic grain size gives about 64 chunks per worker. All tasks of a call live in one array, which is
+// allocated once per call, there is no allocation per task. The calling thread takes part in the execution,
+// it can also be a worker of the pool (nested parallelism).
+// parallel_reduce() and parallel_inclusive_scan() work on fixed chunks and combine them in order, so the
+// operation only needs to be associative. parallel_sort() is a sample sort with one bucket pass.
+
+#pragma once
+#ifndef CONCURRENTFW_PARALLEL_ALGORITHMS_HPP
+#define CONCURRENTFW_PARALLEL_ALGORITHMS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+
+namespace ConcurrentFW
+{
+
+// grain size of 0 selects the automatic grain size
+inline size_t parallel_grain(const ThreadPool& pool, size_t size, size_t grain = 0) noexcept
+{
+    if (grain != 0)
+        return grain;
+    return std::max<size_t>(1, size / (64 * (static_cast<size_t>(pool.size()) + 1)));  // workers and caller
+}
+
+// executes leaf(begin, end) for disjoint sub-ranges of [0, size), which together cover the whole range
+template<typename LEAF>
+class ParallelRange
+{
+public:
+    ParallelRange(ThreadPool& thread_pool, size_t range_size, size_t grain_size, LEAF& leaf_function)
+    : pool(thread_pool)
+    , size(range_size)
+    , grain(parallel_grain(thread_pool, range_size, grain_size))
+    , leaf(leaf_function)
+    , tasks(std::make_unique<RangeTask[]>(2 * (size / grain) + 2))  // each split leaves two halves > grain / 2
+    {}
+
+    ParallelRange(const ParallelRange&) = delete;
+    ParallelRange& operator=(const ParallelRange&) = delete;
+
+    void run()
+    {
+        execute(0, size);
+        // all splits happen before the last element is done, the tasks array must survive all releases
+        pool.wait_until(
+            [this]()
+            {
+                return done.template load<AtomicMemoryOrder::ACQUIRE>() == size
+                       && released.template load<AtomicMemoryOrder::ACQUIRE>()
+                              == spawned.template load<AtomicMemoryOrder::ACQUIRE>();
+            }
+        );
+    }
+
+private:
+    struct RangeTask final : public PoolTask
+    {
+        void run() noexcept override
+        {
+            range->execute(begin, end);
+        }
+
+        void release() noexcept override
+        {
+            range->released.template add_fetch<AtomicMemoryOrder::RELEASE>(1);  // last access to this task
+        }
+
+        ParallelRange* range {nullptr};
+        size_t begin {0};
+        size_t end {0};
+    };
+
+    void execute(size_t begin, size_t end)
+    {
+        while (begin < end)
+        {
+            if (end - begin > grain && pool.local_backlog() == 0)  // nothing left to steal, split
+            {
+                const size_t middle = begin + (end - begin) / 2;
+                RangeTask& task = tasks[spawned.template fetch_add<AtomicMemoryOrder::RELAXED>(1)];
+                task.range = this;
+                task.begin = middle;
+                task.end = end;
+                pool.submit_task(&task);
+                end = middle;
+                continue;
+            }
+            const size_t chunk_end = std::min(end, begin + grain);
+            leaf(begin, chunk_end);
+            done.template add_fetch<AtomicMemoryOrder::RELEASE>(chunk_end - begin);
+            begin = chunk_end;
+        }
+    }
+
+    ThreadPool& pool;
+    const size_t size;
+    const size_t grain;
+    LEAF& leaf;
+    std::unique_ptr<RangeTask[]> tasks;
+    Atomic<size_t> spawned {0};
+    Atomic<size_t> released {0};
+    Atomic<size_t> done {0};  // elements
+};
+
+// calls func(first, last) for disjoint sub-ranges of [begin, end)
+template<typename FUNC>
+void parallel_for(ThreadPool& pool, size_t begin, size_t end, FUNC&& func, size_t grain = 0)
+{
+    if (end <= begin)
+        return;
+    auto leaf = [begin, &func](size_t first, size_t last) { func(begin + first, begin + last); };
+    ParallelRange<decltype(leaf)> range(pool, end - begin, grain, leaf);
+    range.run();
+}
+
+// func(first, last, identity) reduces a sub-range, combine(left, right) must be associative
+template<typename T, typename FUNC, typename COMBINE>
+T parallel_reduce(
+    ThreadPool& pool, size_t begin, size_t end, const T& identity, FUNC&& func, COMBINE&& combine, size_t grain = 0
+)
+{
+    if (end <= begin)
+        return identity;
+    const size_t size = end - begin;
+    const size_t chunk = parallel_grain(pool, size, grain);
+    const size_t chunks = (size + chunk - 1) / chunk;
+
+    std::vector<T> partials(chunks, identity);
+    parallel_for(
+        pool,
+        0,
+        chunks,
+        [&](size_t first_chunk, size_t last_chunk)
+        {
+            for (size_t index = first_chunk; index < last_chunk; index++)
+                partials[index] = func(begin + index * chunk, begin + std::min(size, (index + 1) * chunk), identity);
+        },
+        1
+    );
+
+    T result = identity;
+    for (const T& partial : partials)
+        result = combine(result, partial);
+    return result;
+}
+
+// two passes: sums of chunks, then scan of chunks with the prefix of the preceding chunks, out may be first
+template<std::random_access_iterator INPUT, std::random_access_iterator OUTPUT, typename OP = std::plus<>>
+OUTPUT parallel_inclusive_scan(ThreadPool& pool, INPUT first, INPUT last, OUTPUT out, OP op = {})
+{
+    using T = std::iter_value_t<INPUT>;
+    const size_t size = static_cast<size_t>(last - first);
+    if (size == 0)
+        return out;
+    const size_t chunk = parallel_grain(pool, size);
+    const size_t chunks = (size + chunk - 1) / chunk;
+    auto chunk_begin = [&](size_t index) { return static_cast<std::iter_difference_t<INPUT>>(index * chunk); };
+    auto chunk_end = [&](size_t index)
+    { return static_cast<std::iter_difference_t<INPUT>>(std::min(size, (index + 1) * chunk)); };
+
+    std::vector<T> sums(chunks);
+    parallel_for(
+        pool,
+        0,
+        chunks,
+        [&](size_t first_chunk, size_t last_chunk)
+        {
+            for (size_t index = first_chunk; index < last_chunk; index++)
+            {
+                INPUT element = first + chunk_begin(index);
+                T sum = *element;
+                while (++element != first + chunk_end(index))
+                    sum = op(sum, *element);
+                sums[index] = sum;
+            }
+        },
+        1
+    );
+    for (size_t index = 1; index < chunks; index++)
+        sums[index] = op(sums[index - 1], sums[index]);
+
+    parallel_for(
+        pool,
+        0,
+        chunks,
+        [&](size_t first_chunk, size_t last_chunk)
+        {
+            for (size_t index = first_chunk; index < last_chunk; index++)
+            {
+                INPUT chunk_first = first + chunk_begin(index);
+                INPUT chunk_last = first + chunk_end(index);
+                OUTPUT chunk_out = out + chunk_begin(index);
+                if (index == 0)
+                    std::inclusive_scan(chunk_first, chunk_last, chunk_out, op);
+                else
+                    std::inclusive_scan(chunk_first, chunk_last, chunk_out, op, sums[index - 1]);
+            }
+        },
+        1
+    );
+    return out + static_cast<std::iter_difference_t<OUTPUT>>(size);
+}
+
+// sample sort: splitters from a sorted sample, parallel classification and scatter, parallel sort of buckets
+template<std::random_access_iterator ITERATOR, typename COMPARE = std::less<>>
+void parallel_sort(ThreadPool& pool, ITERATOR first, ITERATOR last, COMPARE comp = {})
+{
+    using T = std::iter_value_t<ITERATOR>;
+    using Difference = std::iter_difference_t<ITERATOR>;
+    constexpr size_t SERIAL_THRESHOLD {1 << 16};
+    constexpr size_t OVERSAMPLING {32};
+    constexpr size_t MAX_BUCKETS {256};  // bucket index fits in uint8_t
+
+    const size_t size = static_cast<size_t>(last - first);
+    const size_t threads = static_cast<size_t>(pool.size()) + 1;
+    if (size < SERIAL_THRESHOLD || threads == 1)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    // splitters from an equidistant sample
+    const size_t buckets = std::min(MAX_BUCKETS, 8 * threads);
+    std::vector<T> sample;
+    sample.reserve(buckets * OVERSAMPLING);
+    for (size_t index = 0; index < buckets * OVERSAMPLING; index++)
+        sample.push_back(first[static_cast<Difference>(index * size / (buckets * OVERSAMPLING))]);
+    std::sort(sample.begin(), sample.end(), comp);
+    std::vector<T> splitters;
+    splitters.reserve(buckets - 1);
+    for (size_t bucket = 1; bucket < buckets; bucket++)
+        splitters.push_back(sample[bucket * OVERSAMPLING]);
+
+    // classification: bucket of each element and histogram per chunk
+    const size_t chunks = 4 * threads;
+    const size_t chunk = (size + chunks - 1) / chunks;
+    std::vector<uint8_t> bucket_of(size);
+    std::vector<size_t> offsets(chunks * buckets, 0);  // first counts, then scatter positions
+    parallel_for(
+        pool,
+        0,
+        chunks,
+        [&](size_t first_chunk, size_t last_chunk)
+        {
+            for (size_t index = first_chunk; index < last_chunk; index++)
+            {
+                size_t* counts = &offsets[index * buckets];
+                for (size_t element = index * chunk; element < std::min(size, (index + 1) * chunk); element++)
+                {
+                    const size_t bucket = static_cast<size_t>(
+                        std::upper_bound(splitters.begin(), splitters.end(), first[static_cast<Difference>(element)], comp)
+                        - splitters.begin()
+                    );
+                    bucket_of[element] = static_cast<uint8_t>(bucket);
+                    counts[bucket]++;
+                }
+            }
+        },
+        1
+    );
+
+    std::vector<size_t> bucket_begin(buckets + 1);
+    size_t position = 0;
+    for (size_t bucket = 0; bucket < buckets; bucket++)
+    {
+        bucket_begin[bucket] = position;
+        for (size_t index = 0; index < chunks; index++)
+        {
+            const size_t count = offsets[index * buckets + bucket];
+            offsets[index * buckets + bucket] = position;
+            position += count;
+        }
+    }
+    bucket_begin[buckets] = size;
+
+    // scatter into buckets, then sort buckets and move them back
+    std::vector<T> scattered(size);
+    parallel_for(
+        pool,
+        0,
+        chunks,
+        [&](size_t first_chunk, size_t last_chunk)
+        {
+            for (size_t index = first_chunk; index < last_chunk; index++)
+            {
+                size_t* positions = &offsets[index * buckets];
+                for (size_t element = index * chunk; element < std::min(size, (index + 1) * chunk); element++)
+                    scattered[positions[bucket_of[element]]++] = std::move(first[static_cast<Difference>(element)]);
+            }
+        },
+        1
+    );
+    parallel_for(
+        pool,
+        0,
+        buckets,
+        [&](size_t first_bucket, size_t last_bucket)
+        {
+            for (size_t bucket = first_bucket; bucket < last_bucket; bucket++)
+            {
+                auto bucket_first = scattered.begin() + static_cast<Difference>(bucket_begin[bucket]);
+                auto bucket_last = scattered.begin() + static_cast<Difference>(bucket_begin[bucket + 1]);
+                std::sort(bucket_first, bucket_last, comp);
+                std::move(bucket_first, bucket_last, first + static_cast<Difference>(bucket_begin[bucket]));
+            }
+        },
+        1
+    );
+}
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_PARALLEL_ALGORITHMS_HPP
@@ -0,0 +1,651 @@
+/*
+ * concurrentfw/pipeline.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::Pipeline
+// Purpose: multi-stage processing pipeline, each stage runs on its own (optionally pinned) thread
+//
+// A pipeline is built from a source, any number of stages and a sink, neighbouring stages are connected by
+// SpscRings. A stage function maps one input item to exactly one output item. A parallel stage runs N workers
+// with their own copy of the function: the upstream stage deals the items round-robin to the input rings of
+// the workers, the downstream stage collects them round-robin from their output rings, so the order of the
+// items is kept without sequence numbers. Parallel stages with the same number of workers are connected
+// worker to worker, otherwise a reassembly stage is inserted between them.
+// Batching: a stage takes all available items of its input (up to the batch size) with one index update,
+// processes them and publishes the results with one index update per output ring. Under load the batches
+// fill up, an idle pipeline passes single items with low latency.
+// Backpressure: a full ring blocks its producer (spin, then park on an EventCount), which stops reading its
+// own input in turn, up to the source. An empty ring parks its consumer the same way. The notifications only
+// issue a futex wake, if the other side is parked.
+// The counters of a stage (items, batches, processing time, input occupancy, waits) are written by its
+// thread only and can be read with stats() while the pipeline runs.
+// Items must be default constructible and move assignable, stage functions must not throw.
+
+#pragma once
+#ifndef CONCURRENTFW_PIPELINE_HPP
+#define CONCURRENTFW_PIPELINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/spsc_ring.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+struct PipelineStageStats
+{
+    std::string name;
+    uint32_t workers {0};
+    uint64_t items {0};
+    uint64_t batches {0};
+    uint64_t busy_ns {0};        // time spent in the stage function
+    uint64_t max_batch_ns {0};   // longest processing time of a single batch
+    uint64_t occupancy_sum {0};  // items waiting in the input rings, sampled before each batch
+    uint64_t max_occupancy {0};
+    uint64_t input_waits {0};   // input was empty
+    uint64_t output_waits {0};  // output was full (backpressure)
+
+    double latency_ns() const noexcept  // mean processing time per item
+    {
+        return items != 0 ? static_cast<double>(busy_ns) / static_cast<double>(items) : 0.0;
+    }
+
+    double occupancy() const noexcept  // mean number of waiting input items
+    {
+        return batches != 0 ? static_cast<double>(occupancy_sum) / static_cast<double>(batches) : 0.0;
+    }
+};
+
+template<typename T>
+class PipelineBuilder;
+
+class Pipeline
+{
+public:
+    static constexpr size_t RING_CAPACITY {1024};
+    static constexpr size_t DEFAULT_BATCH_SIZE {64};
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+    // batch_size: maximum number of items a stage processes at once, pinned stage threads are bound round-robin
+    // to the allowed CPUs of the thread calling start() (sched_getaffinity()) in the order of the stages
+    explicit Pipeline(size_t batch_size = DEFAULT_BATCH_SIZE, bool pin_to_cpus = false);
+    ~Pipeline();  // waits for the end of the stream, if started
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline(Pipeline&&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+    Pipeline& operator=(Pipeline&&) = delete;
+
+    // first stage: source_function(T& item) fills the item and returns true, false at the end of the stream
+    template<typename T, typename FUNC>
+    PipelineBuilder<T> source(std::string name, FUNC&& source_function);
+
+    void start();  // the pipeline must end with a sink
+    void wait();   // until the source ended and the last item passed the sink
+
+    std::vector<PipelineStageStats> stats() const;
+
+private:
+    template<typename T>
+    friend class PipelineBuilder;
+
+    enum Counter : uint32_t
+    {
+        ITEMS,
+        BATCHES,
+        BUSY_NS,
+        MAX_BATCH_NS,
+        OCCUPANCY_SUM,
+        MAX_OCCUPANCY,
+        INPUT_WAITS,
+        OUTPUT_WAITS,
+        COUNTERS
+    };
+
+    enum StartState : uint32_t
+    {
+        WAITING,
+        RUNNING,
+        ABORTED
+    };
+
+    template<typename READY>
+    static void await(EventCount& event, READY&& ready, uint64_t& waits)
+    {
+        if (ready())
+            return;
+        waits++;
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING; spins++)
+        {
+            cpu_relax();
+            if (ready())
+                return;
+        }
+        while (true)
+        {
+            EventCount::Key key = event.prepare_wait();
+            if (ready())
+            {
+                event.cancel_wait();
+                return;
+            }
+            event.wait(key);
+        }
+    }
+
+    class ChannelBase
+    {
+    public:
+        virtual ~ChannelBase() = default;
+    };
+
+    template<typename T>
+    class Channel final : public ChannelBase
+    {
+    public:
+        /////////////////////////////////////////
+        // producer side
+        /////////////////////////////////////////
+
+        // moves a prefix of the items into the ring, returns the number of moved items
+        size_t try_push(T* items, size_t count)
+        {
+            size_t pushed = 0;
+            while (pushed < count)
+            {
+                std::span<T> writable = ring.prepare_write(count - pushed);
+                if (writable.empty())
+                    break;
+                std::move(items + pushed, items + pushed + writable.size(), writable.begin());
+                ring.commit_write(writable.size());
+                pushed += writable.size();
+            }
+            return pushed;
+        }
+
+        void published() noexcept
+        {
+            not_empty.notify_one();
+        }
+
+        void wait_writable(uint64_t& waits)
+        {
+            await(not_full, [this]() { return ring.size_approx() < RING_CAPACITY; }, waits);
+        }
+
+        void close() noexcept
+        {
+            closed.store<AtomicMemoryOrder::RELEASE>(true);
+            not_empty.notify_one();
+        }
+
+        /////////////////////////////////////////
+        // consumer side
+        /////////////////////////////////////////
+
+        size_t try_pop(T* items, size_t max_items)
+        {
+            size_t popped = 0;
+            while (popped < max_items)
+            {
+                std::span<T> readable = ring.peek_read(max_items - popped);
+                if (readable.empty())
+                    break;
+                std::move(readable.begin(), readable.end(), items + popped);
+                ring.release_read(readable.size());
+                popped += readable.size();
+            }
+            return popped;
+        }
+
+        void consumed() noexcept
+        {
+            not_full.notify_one();
+        }
+
+        // false: closed and drained
+        bool wait_readable(uint64_t& waits)
+        {
+            await(
+                not_empty,
+                [this]() { return ring.size_approx() != 0 || closed.load<AtomicMemoryOrder::ACQUIRE>(); },
+                waits
+            );
+            return ring.size_approx() != 0;
+        }
+
+        size_t occupancy() const noexcept
+        {
+            return ring.size_approx();
+        }
+
+    private:
+        SpscRing<T, RING_CAPACITY> ring;
+        EventCount not_empty;  // consumer parks
+        EventCount not_full;   // producer parks
+        Atomic<bool> closed {false};
+    };
+
+    template<typename T>
+    class Input
+    {
+    public:
+        // moves 1..max_items items in stream order, blocks while the input is empty, 0: end of the stream
+        size_t pop(T* items, size_t max_items, uint64_t& waits)
+        {
+            if (channels.size() == 1)
+            {
+                Channel<T>& channel = *channels.front();
+                while (true)
+                {
+                    const size_t popped = channel.try_pop(items, max_items);
+                    if (popped != 0)
+                    {
+                        channel.consumed();
+                        return popped;
+                    }
+                    if (!channel.wait_readable(waits))
+                        return 0;
+                }
+            }
+
+            size_t popped = 0;  // reassembly: the workers of a parallel stage received the items round-robin
+            while (popped < max_items)
+            {
+                Channel<T>& channel = *channels[next];
+                if (channel.try_pop(items + popped, 1) == 0)
+                {
+                    if (popped != 0)
+                        break;
+                    if (!channel.wait_readable(waits))
+                        return 0;  // all items are dealt round-robin, so all other channels are drained too
+                    continue;
+                }
+                popped++;
+                next = next + 1 == channels.size() ? 0 : next + 1;
+            }
+            for (Channel<T>* channel : channels)
+                channel->consumed();
+            return popped;
+        }
+
+        size_t occupancy() const noexcept
+        {
+            size_t items = 0;
+            for (const Channel<T>* channel : channels)
+                items += channel->occupancy();
+            return items;
+        }
+
+        std::vector<Channel<T>*> channels;
+
+    private:
+        size_t next {0};
+    };
+
+    template<typename T>
+    class Output
+    {
+    public:
+        // blocks while an output ring is full
+        void push(T* items, size_t count, uint64_t& waits)
+        {
+            if (channels.size() == 1)
+            {
+                push_to(*channels.front(), items, count, waits);
+                return;
+            }
+
+            staging.resize(channels.size());  // deal round-robin to the workers of a parallel stage
+            for (size_t index = 0; index < count; index++)
+            {
+                staging[next].push_back(std::move(items[index]));
+                next = next + 1 == channels.size() ? 0 : next + 1;
+            }
+            for (size_t channel = 0; channel < channels.size(); channel++)
+            {
+                push_to(*channels[channel], staging[channel].data(), staging[channel].size(), waits);
+                staging[channel].clear();
+            }
+        }
+
+        void close() noexcept
+        {
+            for (Channel<T>* channel : channels)
+                channel->close();
+        }
+
+        std::vector<Channel<T>*> channels;
+
+    private:
+        static void push_to(Channel<T>& channel, T* items, size_t count, uint64_t& waits)
+        {
+            while (count != 0)
+            {
+                const size_t pushed = channel.try_push(items, count);
+                if (pushed != 0)
+                {
+                    channel.published();
+                    items += pushed;
+                    count -= pushed;
+                }
+                else
+                    channel.wait_writable(waits);
+            }
+        }
+
+        std::vector<std::vector<T>> staging;
+        size_t next {0};
+    };
+
+    class Stage  // one thread
+    {
+    public:
+        explicit Stage(size_t batch)
+        : batch_size(batch)
+        {}
+
+        virtual ~Stage() = default;
+        virtual void run() = 0;
+
+        uint64_t counter(Counter index) const noexcept
+        {
+            return published[index].load<AtomicMemoryOrder::RELAXED>();
+        }
+
+        std::thread thread;
+
+    protected:
+        void account(size_t items, uint64_t start_ns, size_t occupancy) noexcept
+        {
+            const uint64_t batch_ns = now_ns() - start_ns;
+            tally[ITEMS] += items;
+            tally[BATCHES]++;
+            tally[BUSY_NS] += batch_ns;
+            tally[MAX_BATCH_NS] = std::max(tally[MAX_BATCH_NS], batch_ns);
+            tally[OCCUPANCY_SUM] += occupancy;
+            tally[MAX_OCCUPANCY] = std::max<uint64_t>(tally[MAX_OCCUPANCY], occupancy);
+        }
+
+        void publish() noexcept
+        {
+            for (uint32_t index = 0; index < COUNTERS; index++)
+                published[index].store<AtomicMemoryOrder::RELAXED>(tally[index]);
+        }
+
+        const size_t batch_size;
+        uint64_t tally[COUNTERS] {};  // stage thread only
+
+    private:
+        Atomic<uint64_t> published[COUNTERS] {};
+    };
+
+    template<typename T, typename FUNC>
+    class SourceStage final : public Stage
+    {
+    public:
+        SourceStage(size_t batch, const FUNC& source_function)
+        : Stage(batch)
+        , function(source_function)
+        {}
+
+        void run() override
+        {
+            std::vector<T> items(batch_size);
+            bool more = true;
+            while (more)
+            {
+                const uint64_t start_ns = now_ns();
+                size_t count = 0;
+                while (count < batch_size && (more = std::invoke(function, items[count])))
+                    count++;
+                if (count == 0)
+                    break;
+                account(count, start_ns, 0);
+                output.push(items.data(), count, tally[OUTPUT_WAITS]);
+                publish();
+            }
+            output.close();
+            publish();
+        }
+
+        Output<T> output;
+
+    private:
+        FUNC function;
+    };
+
+    template<typename IN, typename OUT, typename FUNC>
+    class TransformStage final : public Stage
+    {
+    public:
+        TransformStage(size_t batch, const FUNC& stage_function)
+        : Stage(batch)
+        , function(stage_function)
+        {}
+
+        void run() override
+        {
+            std::vector<IN> inputs(batch_size);
+            std::vector<OUT> outputs(batch_size);
+            while (true)
+            {
+                const size_t occupancy = input.occupancy();
+                const size_t count = input.pop(inputs.data(), batch_size, tally[INPUT_WAITS]);
+                if (count == 0)
+                    break;
+                const uint64_t start_ns = now_ns();
+                for (size_t index = 0; index < count; index++)
+                    outputs[index] = std::invoke(function, std::move(inputs[index]));
+                account(count, start_ns, occupancy);
+                output.push(outputs.data(), count, tally[OUTPUT_WAITS]);
+                publish();
+            }
+            output.close();
+            publish();
+        }
+
+        Input<IN> input;
+        Output<OUT> output;
+
+    private:
+        FUNC function;
+    };
+
+    template<typename T, typename FUNC>
+    class SinkStage final : public Stage
+    {
+    public:
+        SinkStage(size_t batch, const FUNC& sink_function)
+        : Stage(batch)
+        , function(sink_function)
+        {}
+
+        void run() override
+        {
+            std::vector<T> items(batch_size);
+            while (true)
+            {
+                const size_t occupancy = input.occupancy();
+                const size_t count = input.pop(items.data(), batch_size, tally[INPUT_WAITS]);
+                if (count == 0)
+                    break;
+                const uint64_t start_ns = now_ns();
+                for (size_t index = 0; index < count; index++)
+                    std::invoke(function, std::move(items[index]));
+                account(count, start_ns, occupancy);
+                publish();
+            }
+            publish();
+        }
+
+        Input<T> input;
+
+    private:
+        FUNC function;
+    };
+
+    struct StageGroup  // one or several parallel workers
+    {
+        std::string name;
+        std::vector<std::unique_ptr<Stage>> workers;
+    };
+
+    StageGroup& add_group(std::string name);
+
+    template<typename T>
+    Channel<T>* add_channel()
+    {
+        auto channel = std::make_unique<Channel<T>>();
+        Channel<T>* raw = channel.get();
+        channels.push_back(std::move(channel));
+        return raw;
+    }
+
+    bool wait_for_start();  // false: start was aborted
+    void release_start(StartState state);
+    void join() noexcept;
+    static void pin(std::thread& thread, uint32_t cpu);
+    static uint64_t now_ns() noexcept;
+
+    const size_t batch_size;
+    const bool pin_threads;
+    std::vector<StageGroup> groups;
+    std::vector<std::unique_ptr<ChannelBase>> channels;
+    bool complete {false};  // ends with a sink
+    bool started {false};
+
+    Atomic<uint32_t> start_state {WAITING};
+    EventCount start_event;
+};
+
+template<typename T>
+class PipelineBuilder
+{
+public:
+    PipelineBuilder(PipelineBuilder&&) = default;
+    PipelineBuilder(const PipelineBuilder&) = delete;
+    PipelineBuilder& operator=(const PipelineBuilder&) = delete;
+    PipelineBuilder& operator=(PipelineBuilder&&) = delete;
+
+    template<typename FUNC>
+    using StageOutput = std::decay_t<std::invoke_result_t<std::decay_t<FUNC>&, T&&>>;
+
+    // stage_function(T&&) returns the output item, workers > 1: parallel stage, the items keep their order
+    template<typename FUNC>
+    PipelineBuilder<StageOutput<FUNC>> stage(std::string name, FUNC&& stage_function, uint32_t workers = 1) &&
+    {
+        using OUT = StageOutput<FUNC>;
+        using Stage = Pipeline::TransformStage<T, OUT, std::decay_t<FUNC>>;
+
+        if (workers == 0)
+            throw std::invalid_argument("Pipeline: a stage needs at least one worker");
+        if (outputs.size() > 1 && workers > 1 && workers != outputs.size())
+            return std::move(*this).reassemble().stage(std::move(name), std::forward<FUNC>(stage_function), workers);
+
+        Pipeline::StageGroup& group = pipeline.add_group(std::move(name));
+        std::vector<Pipeline::Input<T>*> inputs;
+        std::vector<Pipeline::Output<OUT>*> stage_outputs;
+        for (uint32_t worker = 0; worker < workers; worker++)
+        {
+            auto stage = std::make_unique<Stage>(pipeline.batch_size, stage_function);
+            inputs.push_back(&stage->input);
+            stage_outputs.push_back(&stage->output);
+            group.workers.push_back(std::move(stage));
+        }
+        connect(inputs);
+        return PipelineBuilder<OUT>(pipeline, std::move(stage_outputs));
+    }
+
+    // last stage: sink_function(T&&), the items of a parallel sink are not ordered across its workers
+    template<typename FUNC>
+    void sink(std::string name, FUNC&& sink_function, uint32_t workers = 1) &&
+    {
+        using Stage = Pipeline::SinkStage<T, std::decay_t<FUNC>>;
+
+        if (workers == 0)
+            throw std::invalid_argument("Pipeline: a stage needs at least one worker");
+        if (outputs.size() > 1 && workers > 1 && workers != outputs.size())
+        {
+            std::move(*this).reassemble().sink(std::move(name), std::forward<FUNC>(sink_function), workers);
+            return;
+        }
+
+        Pipeline::StageGroup& group = pipeline.add_group(std::move(name));
+        std::vector<Pipeline::Input<T>*> inputs;
+        for (uint32_t worker = 0; worker < workers; worker++)
+        {
+            auto stage = std::make_unique<Stage>(pipeline.batch_size, sink_function);
+            inputs.push_back(&stage->input);
+            group.workers.push_back(std::move(stage));
+        }
+        connect(inputs);
+        pipeline.complete = true;
+    }
+
+private:
+    friend class Pipeline;
+    template<typename U>
+    friend class PipelineBuilder;
+
+    PipelineBuilder(Pipeline& owner, std::vector<Pipeline::Output<T>*>&& stage_outputs)
+    : pipeline(owner)
+    , outputs(std::move(stage_outputs))
+    {}
+
+    PipelineBuilder reassemble() &&
+    {
+        return std::move(*this).stage("reassembly", [](T&& item) { return std::move(item); });
+    }
+
+    // 1:1, 1:N, N:1 or N:N rings between the workers of the last and the next stage
+    void connect(const std::vector<Pipeline::Input<T>*>& inputs)
+    {
+        const size_t count = std::max(outputs.size(), inputs.size());
+        for (size_t index = 0; index < count; index++)
+        {
+            Pipeline::Channel<T>* channel = pipeline.add_channel<T>();
+            outputs[index % outputs.size()]->channels.push_back(channel);
+            inputs[index % inputs.size()]->channels.push_back(channel);
+        }
+    }
+
+    Pipeline& pipeline;
+    std::vector<Pipeline::Output<T>*> outputs;  // of the workers of the last stage
+};
+
+template<typename T, typename FUNC>
+PipelineBuilder<T> Pipeline::source(std::string name, FUNC&& source_function)
+{
+    using Source = SourceStage<T, std::decay_t<FUNC>>;
+
+    if (!groups.empty())
+        throw std::logic_error("Pipeline: source must be the first stage");
+    StageGroup& group = add_group(std::move(name));
+    auto stage = std::make_unique<Source>(batch_size, source_function);
+    std::vector<Output<T>*> outputs {&stage->output};
+    group.workers.push_back(std::move(stage));
+    return PipelineBuilder<T>(*this, std::move(outputs));
+}
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_PIPELINE_HPP
@@ -0,0 +1,141 @@
+/*
+ * concurrentfw/pool_resource.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::PoolResource
+// Purpose: std::pmr::memory_resource with power-of-two size classes, each served by its own free list.
+// In SYNCHRONIZED mode the free lists are lock-free Stacks and the resource may be shared between threads,
+// in UNSYNCHRONIZED mode plain singly linked lists are used and the resource must only be used by one thread
+// (see thread_pool_resource()). Blocks bigger than MAX_BLOCK_SIZE are passed through to the upstream resource.
+// Chunks are only given back to the upstream resource in release() and in the destructor,
+// so popping from a free list never touches memory that has been returned to upstream.
+
+#pragma once
+#ifndef CONCURRENTFW_POOL_RESOURCE_HPP
+#define CONCURRENTFW_POOL_RESOURCE_HPP
+
+#include <memory_resource>
+#include <cstddef>
+#include <type_traits>
+
+#include <concurrentfw/stack.hpp>
+
+namespace ConcurrentFW
+{
+
+enum class PoolResourceMode : bool
+{
+    UNSYNCHRONIZED = false,
+    SYNCHRONIZED = true
+};
+
+// non thread-safe counterpart of Stack with identical interface, the link is stored in the first word of a block
+class UnsynchronizedStack
+{
+public:
+    using UnspecifiedBlock = void*;
+
+private:
+    UnspecifiedBlock stack {nullptr};
+
+public:
+    void push(UnspecifiedBlock block) noexcept
+    {
+        *static_cast<UnspecifiedBlock*>(block) = stack;
+        stack = block;
+    }
+
+    void push_list(UnspecifiedBlock first, UnspecifiedBlock last) noexcept
+    {
+        *static_cast<UnspecifiedBlock*>(last) = stack;
+        stack = first;
+    }
+
+    UnspecifiedBlock pop() noexcept
+    {
+        UnspecifiedBlock top = stack;
+        if (top != nullptr) [[likely]]
+            stack = *static_cast<UnspecifiedBlock*>(top);
+        return top;
+    }
+};
+
+template<PoolResourceMode MODE>
+class PoolResource : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t MIN_BLOCK_SIZE {16};
+    static constexpr size_t SIZE_CLASSES {9};
+    static constexpr size_t MAX_BLOCK_SIZE {MIN_BLOCK_SIZE << (SIZE_CLASSES - 1)};  // 4 KiB
+    static constexpr size_t DEFAULT_CHUNK_SIZE {64 * 1024};
+
+    explicit PoolResource(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource(), size_t chunk_size = DEFAULT_CHUNK_SIZE
+    );
+    ~PoolResource() override;
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource(PoolResource&&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+    PoolResource& operator=(PoolResource&&) = delete;
+
+    // returns all chunks to upstream, all blocks allocated so far become invalid, not thread-safe
+    void release();
+
+    std::pmr::memory_resource* upstream_resource() const noexcept
+    {
+        return upstream;
+    }
+
+    static constexpr size_t size_class(size_t bytes, size_t alignment) noexcept;
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* block, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    using FreeList = std::conditional_t<MODE == PoolResourceMode::SYNCHRONIZED, Stack, UnsynchronizedStack>;
+
+    struct ChunkHeader  // stored at the beginning of each chunk
+    {
+        void* link;  // used by chunk list
+        size_t bytes;
+        size_t alignment;
+    };
+
+    void* refill(size_t size_class_index);
+
+    std::pmr::memory_resource* upstream;
+    size_t chunk_bytes;
+    FreeList chunks;
+    FreeList free_lists[SIZE_CLASSES];
+};
+
+template<PoolResourceMode MODE>
+constexpr size_t PoolResource<MODE>::size_class(size_t bytes, size_t alignment) noexcept
+{
+    // blocks are aligned to their own size, so the alignment is just a lower limit of the size
+    size_t size = (bytes > alignment) ? bytes : alignment;
+    size_t index = 0;
+    while ((MIN_BLOCK_SIZE << index) < size)
+        index++;
+    return index;  // SIZE_CLASSES or more: too big for pool
+}
+
+using SynchronizedPoolResource = PoolResource<PoolResourceMode::SYNCHRONIZED>;
+using UnsynchronizedPoolResource = PoolResource<PoolResourceMode::UNSYNCHRONIZED>;
+
+// unsynchronized resource of the calling thread, blocks must be deallocated by the same thread
+UnsynchronizedPoolResource& thread_pool_resource();
+
+extern template class PoolResource<PoolResourceMode::SYNCHRONIZED>;
+extern template class PoolResource<PoolResourceMode::UNSYNCHRONIZED>;
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_POOL_RESOURCE_HPP
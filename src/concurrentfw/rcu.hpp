@@ -0,0 +1,193 @@
+/*
+ * concurrentfw/rcu.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::RcuDomain
+// Purpose: userspace read-copy-update with grace periods
+// see: Mathieu Desnoyers et al., "User-Level Implementations of Read-Copy Update", IEEE TPDS 2012
+//
+// Readers mark their critical regions with read_lock() / read_unlock() (or rcu_read_lock() / rcu_read_unlock()
+// for the global domain). The outermost read_lock() stores a snapshot of the global grace period counter
+// in the record of its thread, read_unlock() clears it. Both are plain stores, readers execute no atomic RMW
+// operations and no fences. Writers publish a new version with Concurrent_Ptr::set() or replace() and wait
+// for a grace period with synchronize(), or defer the reclamation with call_rcu().
+//
+// synchronize() increments the grace period counter and waits, until every reader has either left its
+// critical region or has taken a snapshot of the new grace period. The missing reader-side fences are
+// replaced by membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED), which executes a memory barrier on all
+// running threads of the process. Without membarrier support (kernel < 4.14), readers fall back to a fence.
+//
+// Deferred callbacks are collected lock-free and executed in batches after one grace period each,
+// by the callback thread (parked on an EventCount) or by process_callbacks().
+
+#pragma once
+#ifndef CONCURRENTFW_RCU_HPP
+#define CONCURRENTFW_RCU_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/thread_records.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class RcuDomain
+{
+public:
+    using Callback = void (*)(void*);
+
+    struct alignas(64) Record  // align to cache line, snapshots are read by all synchronizing threads
+    {
+        Atomic<uint64_t> snapshot {0};  // grace period counter at outermost read_lock(), 0 outside
+        Atomic<bool> active {false};
+        Record* next {nullptr};
+        uint32_t nesting {0};  // owner only
+    };
+
+    explicit RcuDomain(bool callback_thread = true);
+    ~RcuDomain();  // executes pending callbacks, no other thread may use the domain anymore
+
+    RcuDomain(const RcuDomain&) = delete;
+    RcuDomain(RcuDomain&&) = delete;
+    RcuDomain& operator=(const RcuDomain&) = delete;
+    RcuDomain& operator=(RcuDomain&&) = delete;
+
+    ALWAYS_INLINE void read_lock()
+    {
+        Record* record = ThreadRecords<RcuDomain, Record>::get(*this);
+        if (record->nesting++ == 0)
+        {
+            // memory order: publications before the grace period counter increment are visible afterwards
+            record->snapshot.store<AtomicMemoryOrder::RELAXED>(grace_period.load<AtomicMemoryOrder::ACQUIRE>());
+            if (UNLIKELY(!expedited))
+                atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+            else
+                compiler_barrier();  // the fence is executed by membarrier in synchronize()
+        }
+    }
+
+    ALWAYS_INLINE void read_unlock()
+    {
+        Record* record = ThreadRecords<RcuDomain, Record>::get(*this);
+        if (--record->nesting == 0)
+            record->snapshot.store<AtomicMemoryOrder::RELEASE>(0);  // all reads of the region are done
+    }
+
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(RcuDomain& rcu_domain = RcuDomain::global())
+        : domain(rcu_domain)
+        {
+            domain.read_lock();
+        }
+
+        ~ReadGuard()
+        {
+            domain.read_unlock();
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard(ReadGuard&&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+
+    private:
+        RcuDomain& domain;
+    };
+
+    void synchronize();  // waits for a grace period, must not be called inside of a read-side critical region
+
+    void call_rcu(void* object, Callback callback);
+
+    template<typename T>
+    void call_rcu(T* object)
+    {
+        call_rcu(object, [](void* reclaimed) { delete static_cast<T*>(reclaimed); });
+    }
+
+    size_t process_callbacks();  // one grace period for all pending callbacks, returns number of executed callbacks
+
+    bool has_callback_thread() const noexcept
+    {
+        return callback_thread.joinable();
+    }
+
+    bool is_expedited() const noexcept  // membarrier available, readers need no fences
+    {
+        return expedited;
+    }
+
+    static RcuDomain& global();
+
+private:
+    friend class ThreadRecords<RcuDomain, Record>;
+
+    struct Deferred
+    {
+        void* object;
+        Callback callback;
+        Deferred* next;
+    };
+
+    Record* acquire_record();
+    void release_record(Record* record);
+
+    void memory_barrier_all_threads();
+    void callback_loop();
+
+    Atomic<uint64_t> grace_period {1};
+    bool expedited;
+    RecordList<Record> records;
+    Atomic<Deferred*> deferred {nullptr};
+
+    EventCount wakeup;
+    Atomic<bool> stopping {false};
+    std::thread callback_thread;  // started last
+};
+
+// global domain
+ALWAYS_INLINE void rcu_read_lock()
+{
+    RcuDomain::global().read_lock();
+}
+
+ALWAYS_INLINE void rcu_read_unlock()
+{
+    RcuDomain::global().read_unlock();
+}
+
+inline void synchronize_rcu()
+{
+    RcuDomain::global().synchronize();
+}
+
+template<typename T>
+void call_rcu(T* object)
+{
+    RcuDomain::global().call_rcu(object);
+}
+
+// reclamation policy of Concurrent_Ptr: replaced objects are deleted after a grace period of the global domain,
+// readers must access the pointer within rcu_read_lock() / rcu_read_unlock()
+struct RcuReclamation
+{
+    template<typename T>
+    static void retire(T* object)
+    {
+        RcuDomain::global().call_rcu(object);
+    }
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_RCU_HPP
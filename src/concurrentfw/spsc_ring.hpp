@@ -0,0 +1,204 @@
+/*
+ * concurrentfw/spsc_ring.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::SpscRing
+// Purpose: wait-free bounded FIFO ring buffer for exactly one producer thread and one consumer thread
+// see: Erik Rigtorp, "Optimizing a ring buffer for throughput", https://rigtorp.se/ringbuffer/
+//
+// The producer owns the head index, the consumer owns the tail index, both are placed on separate cache lines.
+// Each side keeps a cached copy of the index of the other side and only reloads it, when the cached copy
+// indicates a full (producer) or empty (consumer) ring, so in the common case no cache line is shared.
+// No read-modify-write operations are needed: an index is published by a single release store,
+// also for a whole batch written with prepare_write()/commit_write() or read with peek_read()/release_read().
+// The zero-copy functions expose contiguous spans of the ring, which end at the wrap-around of the ring.
+// Spans are based on the cached index and may be shorter than possible, the batch functions call them again.
+
+#pragma once
+#ifndef CONCURRENTFW_SPSC_RING_HPP
+#define CONCURRENTFW_SPSC_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <bit>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename T, size_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && std::has_single_bit(N), "N must be a power of two, at least 2");
+    static_assert(std::is_default_constructible_v<T>, "T must be default constructible");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing(SpscRing&&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    SpscRing& operator=(SpscRing&&) = delete;
+
+    static constexpr size_t capacity() noexcept
+    {
+        return N;
+    }
+
+    /////////////////////////////////////////
+    // producer side
+    /////////////////////////////////////////
+
+    template<typename U>
+    ALWAYS_INLINE bool try_push(U&& item)
+    {
+        const size_t head = head_index.template load<AtomicMemoryOrder::RELAXED>();
+        if (UNLIKELY(head - tail_cached == N))
+        {
+            tail_cached = tail_index.template load<AtomicMemoryOrder::ACQUIRE>();
+            if (head - tail_cached == N)
+                return false;
+        }
+        buffer[head & MASK] = std::forward<U>(item);
+        head_index.template store<AtomicMemoryOrder::RELEASE>(head + 1);
+        return true;
+    }
+
+    // contiguous writable span of up to max_items slots, may be empty if the ring is full
+    ALWAYS_INLINE std::span<T> prepare_write(size_t max_items = N)
+    {
+        return prepare_write_at(head_index.template load<AtomicMemoryOrder::RELAXED>(), max_items);
+    }
+
+    // publishes count items written into the span of prepare_write()
+    ALWAYS_INLINE void commit_write(size_t count)
+    {
+        const size_t head = head_index.template load<AtomicMemoryOrder::RELAXED>();
+        head_index.template store<AtomicMemoryOrder::RELEASE>(head + count);
+    }
+
+    // copies a prefix of items, also across the wrap-around, returns number of pushed items
+    size_t try_push_n(const T* items, size_t count)
+    {
+        size_t pushed = 0;
+        const size_t head = head_index.template load<AtomicMemoryOrder::RELAXED>();
+        while (pushed < count)
+        {
+            std::span<T> writable = prepare_write_at(head + pushed, count - pushed);
+            if (writable.empty())
+                break;
+            std::copy_n(items + pushed, writable.size(), writable.begin());
+            pushed += writable.size();
+        }
+        if (pushed != 0)
+            head_index.template store<AtomicMemoryOrder::RELEASE>(head + pushed);
+        return pushed;
+    }
+
+    /////////////////////////////////////////
+    // consumer side
+    /////////////////////////////////////////
+
+    ALWAYS_INLINE bool try_pop(T& item)
+    {
+        const size_t tail = tail_index.template load<AtomicMemoryOrder::RELAXED>();
+        if (UNLIKELY(tail == head_cached))
+        {
+            head_cached = head_index.template load<AtomicMemoryOrder::ACQUIRE>();
+            if (tail == head_cached)
+                return false;
+        }
+        item = std::move(buffer[tail & MASK]);
+        tail_index.template store<AtomicMemoryOrder::RELEASE>(tail + 1);
+        return true;
+    }
+
+    // contiguous readable span of up to max_items items, may be empty if the ring is empty
+    ALWAYS_INLINE std::span<T> peek_read(size_t max_items = N)
+    {
+        return peek_read_at(tail_index.template load<AtomicMemoryOrder::RELAXED>(), max_items);
+    }
+
+    // frees count items of the span of peek_read()
+    ALWAYS_INLINE void release_read(size_t count)
+    {
+        const size_t tail = tail_index.template load<AtomicMemoryOrder::RELAXED>();
+        tail_index.template store<AtomicMemoryOrder::RELEASE>(tail + count);
+    }
+
+    // moves up to count items, also across the wrap-around, returns number of popped items
+    size_t try_pop_n(T* items, size_t count)
+    {
+        size_t popped = 0;
+        const size_t tail = tail_index.template load<AtomicMemoryOrder::RELAXED>();
+        while (popped < count)
+        {
+            std::span<T> readable = peek_read_at(tail + popped, count - popped);
+            if (readable.empty())
+                break;
+            std::move(readable.begin(), readable.end(), items + popped);
+            popped += readable.size();
+        }
+        if (popped != 0)
+            tail_index.template store<AtomicMemoryOrder::RELEASE>(tail + popped);
+        return popped;
+    }
+
+    /////////////////////////////////////////
+    // both sides
+    /////////////////////////////////////////
+
+    size_t size_approx() const noexcept
+    {
+        const size_t tail = tail_index.template load<AtomicMemoryOrder::ACQUIRE>();
+        const size_t head = head_index.template load<AtomicMemoryOrder::ACQUIRE>();
+        return head > tail ? head - tail : 0;
+    }
+
+private:
+    static constexpr size_t MASK {N - 1};
+
+    ALWAYS_INLINE std::span<T> prepare_write_at(size_t head, size_t max_items)
+    {
+        size_t available = N - (head - tail_cached);
+        if (available == 0)  // reload only when the cached tail is exhausted
+        {
+            tail_cached = tail_index.template load<AtomicMemoryOrder::ACQUIRE>();
+            available = N - (head - tail_cached);
+        }
+        const size_t offset = head & MASK;
+        return {&buffer[offset], std::min({available, max_items, N - offset})};
+    }
+
+    ALWAYS_INLINE std::span<T> peek_read_at(size_t tail, size_t max_items)
+    {
+        size_t available = head_cached - tail;
+        if (available == 0)  // reload only when the cached head is exhausted
+        {
+            head_cached = head_index.template load<AtomicMemoryOrder::ACQUIRE>();
+            available = head_cached - tail;
+        }
+        const size_t offset = tail & MASK;
+        return {&buffer[offset], std::min({available, max_items, N - offset})};
+    }
+
+    // align to cache line: producer line, consumer line and buffer do not share cache lines
+    alignas(64) Atomic<size_t> head_index {0};  // written by producer
+    size_t tail_cached {0};                     // producer only
+    alignas(64) Atomic<size_t> tail_index {0};  // written by consumer
+    size_t head_cached {0};                     // consumer only
+    alignas(64) T buffer[N] {};
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_SPSC_RING_HPP
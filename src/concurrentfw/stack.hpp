@@ -31,6 +31,7 @@ private:
 
 public:
     void push [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (UnspecifiedBlock block);
+    void push_list [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] (UnspecifiedBlock first, UnspecifiedBlock last);  // pre-linked list
     UnspecifiedBlock pop [[ATTRIBUTE_ABA_LOOP_OPTIMIZE]] ();
 };
 
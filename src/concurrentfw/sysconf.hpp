@@ -11,6 +11,8 @@
 #define CONCURRENTFW_SYSCONF_HPP
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <system_error>
 
 #include <unistd.h>
@@ -30,6 +32,7 @@ T sysconf(int sysconf_name)
 
 size_t cache_line();
 size_t page_size();
+std::vector<uint32_t> allowed_cpus();  // CPUs of the affinity mask of the calling thread, ascending
 
 }  // namespace ConcurrentFW
 
@@ -0,0 +1,91 @@
+/*
+ * concurrentfw/task_graph.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::TaskGraph
+// Purpose: directed acyclic graph of dependent tasks, executed on the work-stealing ThreadPool
+//
+// Each node counts its unfinished predecessors in an atomic counter. A finishing node decrements the counters
+// of its successors and submits each successor, whose counter has reached zero, so a node starts the moment
+// its last dependency completes, there are no barriers between levels.
+// The nodes are the pool tasks themselves, a built graph can be run again and again without any allocation:
+// run() only resets the counters. The graph is checked for cycles once after modifications (std::logic_error).
+
+#pragma once
+#ifndef CONCURRENTFW_TASK_GRAPH_HPP
+#define CONCURRENTFW_TASK_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+
+namespace ConcurrentFW
+{
+
+class TaskGraph
+{
+public:
+    using NodeId = uint32_t;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph(TaskGraph&&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+    TaskGraph& operator=(TaskGraph&&) = delete;
+
+    template<typename FUNC>
+    NodeId add(FUNC&& func)
+    {
+        return add_node(std::function<void()>(std::forward<FUNC>(func)));
+    }
+
+    void precede(NodeId before, NodeId after);  // after starts, when before (and all other predecessors) are done
+    void run(ThreadPool& pool);                 // blocks until all nodes are done, the calling thread helps
+
+    size_t size() const noexcept
+    {
+        return nodes.size();
+    }
+
+private:
+    class Node final : public PoolTask
+    {
+    public:
+        Node(TaskGraph& owning_graph, std::function<void()>&& function)
+        : graph(owning_graph)
+        , work(std::move(function))
+        {}
+
+        void run() noexcept override;
+        void release() noexcept override;
+
+        TaskGraph& graph;
+        std::function<void()> work;
+        std::vector<NodeId> successors;
+        uint32_t predecessors {0};
+        Atomic<uint32_t> unfinished {0};  // predecessors during a run
+    };
+
+    NodeId add_node(std::function<void()>&& func);
+    void validate();
+
+    std::vector<std::unique_ptr<Node>> nodes;  // stable addresses, nodes are submitted as tasks
+    std::vector<NodeId> roots;
+    bool validated {false};
+    ThreadPool* running_pool {nullptr};
+    Atomic<size_t> finished {0};
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_TASK_GRAPH_HPP
@@ -0,0 +1,171 @@
+/*
+ * concurrentfw/thread_pool.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::ThreadPool
+// Purpose: work-stealing thread pool for fine-grained tasks
+//
+// Each worker owns a WorkStealingDeque, tasks submitted by a worker are pushed to its own deque and executed
+// in LIFO order, tasks submitted by other threads go to a global injection queue (MsQueue).
+// An idle worker looks at its own deque, then the injection queue, then steals from randomly selected victims.
+// If it still finds nothing, it spins briefly and then parks on an EventCount, submit() only issues a
+// futex wake, if at least one worker is parked.
+// Tasks must not throw, wait_idle() must not be called by a task, but a task can wait for other tasks with
+// wait_until(), which executes tasks meanwhile.
+
+#pragma once
+#ifndef CONCURRENTFW_THREAD_POOL_HPP
+#define CONCURRENTFW_THREAD_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <coroutine>
+#include <type_traits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/ms_queue.hpp>
+#include <concurrentfw/work_stealing_deque.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class PoolTask
+{
+public:
+    PoolTask() = default;
+    virtual ~PoolTask() = default;
+    PoolTask(const PoolTask&) = delete;
+    PoolTask& operator=(const PoolTask&) = delete;
+
+    virtual void run() noexcept = 0;
+
+    // last access of the pool to the task after run(), tasks with other storage signal their completion here
+    virtual void release() noexcept
+    {
+        delete this;
+    }
+};
+
+class ThreadPool
+{
+public:
+    // workers == 0: one worker per hardware thread, pinned workers are bound round-robin to the allowed CPUs
+    // of the creating thread (sched_getaffinity())
+    explicit ThreadPool(uint32_t workers = 0, bool pin_to_cpus = false);
+    ~ThreadPool();  // waits for all submitted tasks
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    template<typename FUNC>
+    void submit(FUNC&& func)
+    {
+        submit_task(new FunctionTask<std::decay_t<FUNC>>(std::forward<FUNC>(func)));
+    }
+
+    void submit_task(PoolTask* task);  // task is released after it has been run
+    void wait_idle();                  // until all submitted tasks (also the ones they submit) are done
+
+    // resumes a suspended coroutine as a task (CoroutineExecutor)
+    void post(std::coroutine_handle<> handle)
+    {
+        submit([handle]() { handle.resume(); });
+    }
+
+    // runs tasks of the pool until done() is true, usable by workers and by other threads (fork/join)
+    template<typename PREDICATE>
+    void wait_until(PREDICATE&& done)
+    {
+        PoolTask* task;
+        while (!done())
+        {
+            if (help(task))
+                run_task(task);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    uint32_t size() const noexcept
+    {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+    // index of the calling worker of this pool, -1 for other threads
+    int32_t worker_index() const noexcept;
+
+    // tasks in the deque of the calling worker, 0 for other threads (lazy splitting of ranges)
+    size_t local_backlog() const noexcept;
+
+private:
+    static constexpr uint32_t SPINS_BEFORE_PARKING {64};
+
+    template<typename FUNC>
+    class FunctionTask final : public PoolTask
+    {
+    public:
+        explicit FunctionTask(FUNC&& function)
+        : func(std::move(function))
+        {}
+
+        explicit FunctionTask(const FUNC& function)
+        : func(function)
+        {}
+
+        void run() noexcept override
+        {
+            func();
+        }
+
+    private:
+        FUNC func;
+    };
+
+    struct alignas(64) Worker  // align to cache line
+    {
+        Worker(ThreadPool& owning_pool, uint32_t worker_index)
+        : pool(owning_pool)
+        , index(worker_index)
+        , random_state(0x9E3779B97F4A7C15ULL * (worker_index + 1))
+        {}
+
+        ThreadPool& pool;
+        const uint32_t index;
+        uint64_t random_state;  // xorshift, victim selection
+        WorkStealingDeque<PoolTask*> deque;
+        std::thread thread;
+    };
+
+    void worker_loop(Worker& worker);
+    bool find_task(Worker& worker, PoolTask*& task);
+    bool steal_task(uint64_t& random_state, uint32_t thief, PoolTask*& task);
+    bool help(PoolTask*& task);
+    void run_task(PoolTask* task) noexcept;
+    void shutdown() noexcept;
+    static void pin(std::thread& thread, uint32_t cpu);
+
+    static inline constinit thread_local Worker* current_worker {nullptr};
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MsQueue<PoolTask*> injection;
+    EventCount idle_workers;
+    alignas(64) Atomic<size_t> pending {0};  // align to cache line, submitted and not finished tasks
+    Atomic<bool> stopping {false};
+    EventCount idle_pool;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_THREAD_POOL_HPP
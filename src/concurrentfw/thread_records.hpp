@@ -0,0 +1,169 @@
+/*
+ * concurrentfw/thread_records.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::RecordList, ConcurrentFW::ThreadRecords
+// Purpose: helpers for domains with one record per participating thread (e.g. memory reclamation domains).
+// RecordList is a lock-free, grow-only list of records, which are acquired and released by threads.
+// Records are never freed while the list exists, so other threads may always scan them.
+// ThreadRecords caches the record of the calling thread per domain and releases it at thread exit.
+// A domain must outlive all threads which used it, except the thread destroying it (see forget()).
+//
+// RECORD must provide the members 'Atomic<bool> active' and 'RECORD* next'.
+
+#pragma once
+#ifndef CONCURRENTFW_THREAD_RECORDS_HPP
+#define CONCURRENTFW_THREAD_RECORDS_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<typename RECORD>
+class RecordList
+{
+public:
+    RecordList() = default;
+    RecordList(const RecordList&) = delete;
+    RecordList(RecordList&&) = delete;
+    RecordList& operator=(const RecordList&) = delete;
+    RecordList& operator=(RecordList&&) = delete;
+
+    ~RecordList()
+    {
+        RECORD* record = head.template load<AtomicMemoryOrder::ACQUIRE>();
+        while (record != nullptr)
+        {
+            RECORD* next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    // reuses an inactive record or appends a new one
+    RECORD* acquire()
+    {
+        for (RECORD* record = head.template load<AtomicMemoryOrder::ACQUIRE>(); record != nullptr; record = record->next)
+        {
+            Atomic<bool>& active = record->active;
+            bool expected = false;
+            if (!active.load<AtomicMemoryOrder::RELAXED>()
+                && active.compare_exchange_strong<AtomicMemoryOrder::ACQUIRE, AtomicMemoryOrder::RELAXED>(expected, true))
+                return record;
+        }
+
+        RECORD* record = new RECORD;
+        Atomic<bool>& active = record->active;
+        active.store<AtomicMemoryOrder::RELAXED>(true);  // published by release below
+        RECORD* expected = head.template load<AtomicMemoryOrder::RELAXED>();
+        do
+        {
+            record->next = expected;
+        }
+        while (!head.template compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(expected, record));
+        count.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+        return record;
+    }
+
+    void release(RECORD* record) noexcept
+    {
+        Atomic<bool>& active = record->active;
+        active.store<AtomicMemoryOrder::RELEASE>(false);
+    }
+
+    // visits all records, active or not
+    template<typename FUNC>
+    void for_each(FUNC&& func) const
+    {
+        for (RECORD* record = head.template load<AtomicMemoryOrder::ACQUIRE>(); record != nullptr; record = record->next)
+            func(*record);
+    }
+
+    size_t size() const noexcept
+    {
+        return count.load<AtomicMemoryOrder::RELAXED>();
+    }
+
+private:
+    Atomic<RECORD*> head {nullptr};
+    Atomic<size_t> count {0};
+};
+
+// DOMAIN must provide 'RECORD* acquire_record()' and 'void release_record(RECORD*)'
+template<typename DOMAIN, typename RECORD>
+class ThreadRecords
+{
+public:
+    static ALWAYS_INLINE RECORD* get(DOMAIN& domain)
+    {
+        Cache& local = cache;
+        if (LIKELY(local.last_domain == &domain))
+            return local.last_record;
+        return local.lookup(domain);
+    }
+
+    // to be called by domain destructor, as records of the calling thread would be released too late
+    static void forget(DOMAIN& domain)
+    {
+        Cache& local = cache;
+        std::erase_if(local.entries, [&domain](const Entry& entry) { return entry.first == &domain; });
+        if (local.last_domain == &domain)
+        {
+            local.last_domain = nullptr;
+            local.last_record = nullptr;
+        }
+    }
+
+private:
+    using Entry = std::pair<DOMAIN*, RECORD*>;
+
+    struct Cache
+    {
+        DOMAIN* last_domain {nullptr};
+        RECORD* last_record {nullptr};
+        std::vector<Entry> entries;
+
+        ~Cache()
+        {
+            for (Entry& entry : entries)
+                entry.first->release_record(entry.second);
+        }
+
+        RECORD* lookup(DOMAIN& domain)
+        {
+            auto found = std::find_if(
+                entries.begin(), entries.end(), [&domain](const Entry& entry) { return entry.first == &domain; }
+            );
+            RECORD* record;
+            if (found != entries.end())
+                record = found->second;
+            else
+            {
+                record = domain.acquire_record();
+                entries.emplace_back(&domain, record);
+            }
+            last_domain = &domain;
+            last_record = record;
+            return record;
+        }
+    };
+
+    static thread_local Cache cache;
+};
+
+template<typename DOMAIN, typename RECORD>
+thread_local typename ThreadRecords<DOMAIN, RECORD>::Cache ThreadRecords<DOMAIN, RECORD>::cache;
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_THREAD_RECORDS_HPP
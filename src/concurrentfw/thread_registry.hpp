@@ -0,0 +1,92 @@
+/*
+ * concurrentfw/thread_registry.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::ThreadRegistry
+// Purpose: dense thread indices for per-thread sharding (slots, striped counters, caches) without hashing thread ids
+//
+// Each thread gets an index on first use of index(): the most recently freed index of an exited thread (taken
+// from a lock-free LIFO Stack of free slots) or, if none is free, the next unused index, raising high_water().
+// So all indices are below high_water() <= MAX_THREADS and per-thread arrays can be sized and scanned densely.
+// index() is a single load of a trivial thread local variable, only the first call of a thread registers it.
+// A thread local destructor releases the index at thread exit. A thread, which calls index() again in a later
+// thread local destructor, gets another index, which a pthread key destructor releases after all thread local
+// destructors (not at exit of the main thread, the process ends anyway).
+
+#pragma once
+#ifndef CONCURRENTFW_THREAD_REGISTRY_HPP
+#define CONCURRENTFW_THREAD_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class ThreadRegistry
+{
+public:
+    static constexpr uint32_t MAX_THREADS {4096};
+
+    ThreadRegistry() = delete;
+
+    // dense index of calling thread, registers thread on first call
+    static ALWAYS_INLINE uint32_t index()
+    {
+        const uint32_t current = current_index;  // index + 1, 0 if not registered
+        if (LIKELY(current != 0))
+            return current - 1;
+        return register_thread();
+    }
+
+    static uint32_t high_water() noexcept  // upper limit of all indices handed out so far
+    {
+        return used_indices.load<AtomicMemoryOrder::ACQUIRE>();
+    }
+
+    static uint32_t live_threads() noexcept
+    {
+        return live_count.load<AtomicMemoryOrder::RELAXED>();
+    }
+
+    // calls func(index) for each live registered thread
+    template<typename FUNC>
+    static void for_each(FUNC&& func)
+    {
+        const uint32_t limit = high_water();
+        for (uint32_t slot_index = 0; slot_index < limit; slot_index++)
+            if (slots[slot_index].live.load<AtomicMemoryOrder::ACQUIRE>())
+                func(slot_index);
+    }
+
+private:
+    struct Slot
+    {
+        Stack::UnspecifiedBlock link;  // used by free Stack
+        Atomic<bool> live;
+    };
+
+    friend struct ThreadRegistryReleaser;
+
+    static uint32_t register_thread();
+    static void unregister_thread() noexcept;
+
+    static inline constinit thread_local uint32_t current_index {0};
+
+    static Slot slots[MAX_THREADS];
+    static Stack free_slots;
+    static Atomic<uint32_t> used_indices;
+    static Atomic<uint32_t> live_count;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_THREAD_REGISTRY_HPP
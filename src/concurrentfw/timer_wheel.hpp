@@ -0,0 +1,186 @@
+/*
+ * concurrentfw/timer_wheel.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::TimerWheel
+// Purpose: hierarchical timing wheel for large numbers of timeouts, which are mostly cancelled
+// see: G. Varghese, T. Lauck, "Hashed and Hierarchical Timing Wheels", SOSP 1987
+//
+// LEVELS wheels of 64 slots each, a slot of level L covers 64^L ticks, so 6 levels cover 2^36 ticks
+// (about 2 years with 1 ms ticks, later deadlines are clamped and cascaded again). Each level keeps an
+// occupancy bitmap, the next expiry is found with a rotate and a count of trailing zeros.
+// The wheel itself is only accessed by its driver thread. schedule_at() and cancel() may be called by any
+// thread without a lock: timer nodes come from a lock-free Stack (allocated in chunks, recycled, only freed
+// by the destructor), insertions and cancellations are passed to the driver through intrusive MpscMailboxes.
+// cancel() is a single CAS on the state word of the node (generation and status), the driver unlinks the
+// node in O(1) from its doubly linked slot list. The generation makes stale TimerIds harmless.
+// The driver sleeps on an EventCount with an absolute FUTEX_WAIT_BITSET deadline until the next expiry
+// (at most one level-0 rotation, so cancelled nodes are recycled in time). An insertion only wakes the
+// driver, if its deadline is earlier than the one the driver sleeps for.
+// Callbacks run in the driver thread and must not throw, timers still pending at destruction are dropped.
+
+#pragma once
+#ifndef CONCURRENTFW_TIMER_WHEEL_HPP
+#define CONCURRENTFW_TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/mpsc_mailbox.hpp>
+
+namespace ConcurrentFW
+{
+
+class TimerWheel
+{
+private:
+    struct Node;
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t LEVELS {6};
+    static constexpr uint32_t SLOT_BITS {6};
+    static constexpr uint32_t SLOTS {1U << SLOT_BITS};
+    static constexpr size_t NODES_PER_CHUNK {4096};
+
+    class TimerId
+    {
+    public:
+        TimerId() = default;
+
+    private:
+        friend TimerWheel;
+
+        TimerId(Node* timer_node, uint64_t node_generation) noexcept
+        : node(timer_node)
+        , generation(node_generation)
+        {}
+
+        Node* node {nullptr};
+        uint64_t generation {0};
+    };
+
+    explicit TimerWheel(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1));
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    // callback runs in the driver thread, not before the deadline
+    template<typename FUNC>
+    TimerId schedule_at(Clock::time_point deadline, FUNC&& callback)
+    {
+        return schedule_function(deadline, std::function<void()>(std::forward<FUNC>(callback)));
+    }
+
+    template<typename FUNC>
+    TimerId schedule_after(Clock::duration timeout, FUNC&& callback)
+    {
+        return schedule_at(Clock::now() + timeout, std::forward<FUNC>(callback));
+    }
+
+    // true: the callback will not be called, false: already called (or running) or cancelled before
+    bool cancel(TimerId timer) noexcept;
+
+    std::chrono::nanoseconds resolution() const noexcept
+    {
+        return tick;
+    }
+
+    size_t allocated_nodes() const noexcept
+    {
+        return chunk_count.load<AtomicMemoryOrder::RELAXED>() * NODES_PER_CHUNK;
+    }
+
+private:
+    enum Status : uint64_t
+    {
+        FREE = 0,
+        PENDING = 1,
+        CANCELLED = 2,
+        FIRED = 3
+    };
+    static constexpr uint32_t STATUS_BITS {2};
+    static constexpr uint64_t STATUS_MASK {(1ULL << STATUS_BITS) - 1};
+    static constexpr uint64_t NO_EXPIRY {UINT64_MAX};
+
+    struct CancelLink : MailboxLink
+    {
+        Node* node {nullptr};
+    };
+
+    struct Node : MailboxLink  // insertion mailbox, first word is also the link in the free Stack
+    {
+        CancelLink cancel_link;
+        Atomic<uint64_t> state {FREE};  // generation << STATUS_BITS | status
+        uint64_t deadline {0};          // in ticks, the following members are only used by the driver
+        Node* previous {nullptr};
+        Node* next_in_slot {nullptr};
+        uint32_t slot {0};  // level * SLOTS + index, while linked
+        bool linked {false};
+        bool inserted {false};
+        bool cancel_seen {false};
+        std::function<void()> callback;
+    };
+
+    struct Chunk
+    {
+        Chunk* next {nullptr};
+        Node nodes[NODES_PER_CHUNK];
+    };
+
+    TimerId schedule_function(Clock::time_point deadline, std::function<void()>&& callback);
+    Node* allocate_node();
+    uint64_t deadline_tick(Clock::time_point deadline) const noexcept;
+    uint64_t current_tick() const noexcept;
+
+    // driver
+    void driver_loop();
+    void drain();
+    void advance(uint64_t target_tick);
+    void link(Node* node, uint64_t earliest_tick) noexcept;
+    void unlink(Node* node) noexcept;
+    Node* take_slot(uint32_t level, uint32_t index) noexcept;
+    void cascade(uint32_t level, uint32_t index) noexcept;
+    void expire(uint32_t index);
+    void dropped(Node* node) noexcept;  // cancelled node was unlinked
+    void recycle(Node* node) noexcept;
+    uint64_t next_expiry() const noexcept;
+
+    const std::chrono::nanoseconds tick;
+    const Clock::time_point start;
+
+    Stack free_nodes;
+    Atomic<Chunk*> chunks {nullptr};
+    Atomic<size_t> chunk_count {0};
+
+    MpscMailbox<Node> insertions;
+    MpscMailbox<CancelLink> cancellations;
+    alignas(64) Atomic<uint64_t> sleep_until {0};  // align to cache line, tick the driver sleeps for, 0: awake
+    EventCount driver_event;
+    Atomic<bool> stopping {false};
+
+    alignas(64) uint64_t now_tick {0};  // align to cache line, wheel state only used by the driver
+    uint64_t occupied[LEVELS] {};
+    Node* slots[LEVELS][SLOTS] {};
+
+    std::thread driver;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_TIMER_WHEEL_HPP
@@ -0,0 +1,126 @@
+/*
+ * concurrentfw/token_bucket.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::TokenBucket
+// Purpose: lock-free token-bucket rate limiter
+//
+// Tokens (lower TOKEN_BITS) and the time of the last refill (upper TIME_BITS, in units of 256 ns since the
+// creation of the bucket) share one 64-bit word, refill and consumption are a single CAS loop on this word.
+// Only the time of the whole tokens added is accounted, the fraction of a token stays in the timestamp, so
+// frequent refills do not lose tokens. A full bucket moves the timestamp to the present.
+// The timestamp wraps after about 13 days. A timestamp up to CLOCK_SKEW ahead of now belongs to another thread,
+// which read the clock after us, every other difference is elapsed time (modulo the wrap): a bucket not used at all
+// for more than 13 days may get too few tokens once, but it is never stalled.
+// acquire() sleeps for the time the missing tokens need, then competes again (no FIFO order of waiters).
+// No memory is protected by the bucket, so all atomic operations are relaxed.
+
+#pragma once
+#ifndef CONCURRENTFW_TOKEN_BUCKET_HPP
+#define CONCURRENTFW_TOKEN_BUCKET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class TokenBucket
+{
+public:
+    static constexpr uint32_t TOKEN_BITS {22};
+    static constexpr uint32_t TIME_BITS {64 - TOKEN_BITS};
+    static constexpr uint32_t MAX_BURST {(1U << TOKEN_BITS) - 1};
+    static constexpr uint32_t TIME_UNIT_SHIFT {8};  // 256 ns
+
+    using Clock = std::chrono::steady_clock;
+
+    // burst: capacity of the bucket, the bucket starts full
+    TokenBucket(double tokens_per_second, uint32_t burst);
+
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+
+    // takes all tokens or none
+    ALWAYS_INLINE bool try_consume(uint32_t tokens = 1) noexcept
+    {
+        const uint64_t now = now_units();
+        uint64_t current = state.load<AtomicMemoryOrder::RELAXED>();
+        while (true)
+        {
+            uint64_t stamp;
+            const uint64_t available = refill(current, now, stamp);
+            if (available < tokens)
+                return false;  // nothing written, the next call refills again
+            if (state.compare_exchange_weak<AtomicMemoryOrder::RELAXED, AtomicMemoryOrder::RELAXED>(
+                    current, (stamp << TOKEN_BITS) | (available - tokens)
+                ))
+                return true;
+        }
+    }
+
+    void acquire(uint32_t tokens = 1);  // blocks until the tokens are taken, tokens must not exceed the burst
+
+    uint32_t available() const noexcept
+    {
+        uint64_t stamp;
+        return static_cast<uint32_t>(refill(state.load<AtomicMemoryOrder::RELAXED>(), now_units(), stamp));
+    }
+
+    uint32_t burst() const noexcept
+    {
+        return capacity;
+    }
+
+private:
+    static constexpr uint64_t TOKEN_MASK {(1ULL << TOKEN_BITS) - 1};
+    static constexpr uint64_t TIME_MASK {(1ULL << TIME_BITS) - 1};
+    static constexpr uint32_t FRACTION_BITS {16};  // fixed point time per token
+    static constexpr uint64_t CLOCK_SKEW {10000000 >> TIME_UNIT_SHIFT};  // 10 ms between clock reads of threads
+
+    static uint64_t units_per_token_of(double tokens_per_second);  // validates the rate
+
+    ALWAYS_INLINE uint64_t now_units() const noexcept
+    {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+        return (static_cast<uint64_t>(elapsed.count()) >> TIME_UNIT_SHIFT) & TIME_MASK;
+    }
+
+    // tokens after refill up to now, stamp: new timestamp
+    ALWAYS_INLINE uint64_t refill(uint64_t current, uint64_t now, uint64_t& stamp) const noexcept
+    {
+        const uint64_t tokens = current & TOKEN_MASK;
+        stamp = current >> TOKEN_BITS;
+        uint64_t elapsed = (now - stamp) & TIME_MASK;
+        if (elapsed > TIME_MASK - CLOCK_SKEW)  // timestamp of another thread, which read the clock after us
+            elapsed = 0;
+        const uint64_t scaled = elapsed << FRACTION_BITS;
+        const uint64_t added = scaled / units_per_token;
+        if (tokens + added >= capacity)
+        {
+            if (elapsed != 0)
+                stamp = now;
+            return capacity;
+        }
+        stamp = (stamp + elapsed - ((scaled % units_per_token) >> FRACTION_BITS)) & TIME_MASK;  // keep fraction
+        return tokens + added;
+    }
+
+    const Clock::time_point start;
+    const uint64_t units_per_token;  // fixed point with FRACTION_BITS
+    const uint32_t capacity;
+    const double nanoseconds_per_token;
+    Atomic<uint64_t> state;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_TOKEN_BUCKET_HPP
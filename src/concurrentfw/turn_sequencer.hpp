@@ -0,0 +1,108 @@
+/*
+ * concurrentfw/turn_sequencer.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::TurnSequencer
+// Purpose: strictly ordered hand-off between threads, the thread with turn k waits until turn k has come
+// see: folly::detail::TurnSequencer
+//
+// One futex word holds the current turn (upper TURN_BITS) and the distance of the farthest sleeping waiter
+// (lower DELTA_BITS, saturating). A waiter sleeps with FUTEX_WAIT_BITSET on channel (1 << turn % 32),
+// complete_turn() wakes only the channel of the next turn and only if a sleeping waiter is recorded, otherwise
+// it is a single CAS. Waiters of turns 32 apart share a channel: they wake up, find that it is not their turn
+// and sleep again, recording their distance again. This also keeps a saturated distance correct: it shrinks
+// by one per turn, but the channel of every waiter is woken at least once every 32 turns.
+// Waiters at most SPIN_DISTANCE turns away spin briefly before they sleep, waiters farther away sleep at once.
+// Turns are counted modulo 2^TURN_BITS, a waiter must be less than 2^(TURN_BITS - 1) turns ahead.
+
+#pragma once
+#ifndef CONCURRENTFW_TURN_SEQUENCER_HPP
+#define CONCURRENTFW_TURN_SEQUENCER_HPP
+
+#include <cstdint>
+#include <climits>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+class TurnSequencer : public FutexBase
+{
+public:
+    static constexpr uint32_t DELTA_BITS {6};
+    static constexpr uint32_t TURN_BITS {32 - DELTA_BITS};
+    static constexpr uint32_t SPIN_DISTANCE {2};
+    static constexpr uint32_t SPINS_BEFORE_PARKING {1024};
+
+    explicit TurnSequencer(uint32_t first_turn = 0) noexcept
+    : FutexBase(static_cast<int>(first_turn << DELTA_BITS))
+    {}
+
+    TurnSequencer(const TurnSequencer&) = delete;
+    TurnSequencer(TurnSequencer&&) = delete;
+    ~TurnSequencer() = default;
+    TurnSequencer& operator=(const TurnSequencer&) = delete;
+    TurnSequencer& operator=(TurnSequencer&&) = delete;
+
+    // blocks until turn has come, false: turn is already completed
+    ALWAYS_INLINE bool wait_for_turn(uint32_t turn)
+    {
+        // memory order: the work of the previous turns must be visible
+        if ((static_cast<uint32_t>(value.load<AtomicMemoryOrder::ACQUIRE>()) & ~DELTA_MASK) == turn << DELTA_BITS)
+            [[likely]]
+            return true;
+        return wait_slow(turn);
+    }
+
+    // only the owner of the current turn may complete it
+    ALWAYS_INLINE void complete_turn(uint32_t turn) noexcept
+    {
+        const uint32_t next = (turn + 1) << DELTA_BITS;
+        int state = value.load<AtomicMemoryOrder::RELAXED>();
+        while (true)  // waiters only raise the recorded distance
+        {
+            const uint32_t delta = static_cast<uint32_t>(state) & DELTA_MASK;
+            const uint32_t desired = next | (delta != 0 ? delta - 1 : 0);
+            // memory order: the work of this turn must be visible to the next one
+            if (value.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(
+                    state, static_cast<int>(desired)
+                ))
+            {
+                if (delta != 0) [[unlikely]]
+                    futex_wake_bitset(channel(turn + 1), INT_MAX);
+                return;
+            }
+        }
+    }
+
+    bool is_turn(uint32_t turn) const noexcept
+    {
+        return (static_cast<uint32_t>(value.load<AtomicMemoryOrder::ACQUIRE>()) & ~DELTA_MASK) == turn << DELTA_BITS;
+    }
+
+    uint32_t current_turn() const noexcept  // modulo 2^TURN_BITS
+    {
+        return static_cast<uint32_t>(value.load<AtomicMemoryOrder::RELAXED>()) >> DELTA_BITS;
+    }
+
+private:
+    static constexpr uint32_t DELTA_MASK {(1U << DELTA_BITS) - 1};
+
+    static ALWAYS_INLINE uint32_t channel(uint32_t turn) noexcept
+    {
+        return 1U << (turn & 31);
+    }
+
+    bool wait_slow(uint32_t turn);
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_TURN_SEQUENCER_HPP
@@ -0,0 +1,191 @@
+/*
+ * concurrentfw/work_stealing_deque.hpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+// ConcurrentFW::WorkStealingDeque
+// Purpose: dynamically growing work-stealing deque, one owner thread and any number of thief threads
+// see: David Chase, Yossi Lev, "Dynamic Circular Work-Stealing Deque", SPAA 2005
+//      Nhat Minh Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013
+//
+// The owner pushes and pops at the bottom, a CAS is only needed for the last element, when the owner might
+// race with a thief. Thieves steal from the top with one CAS. The fences follow the C11 version of Lê et al.:
+// on x86 only the seq_cst fences of pop() and steal() are real instructions, on aarch64 also the
+// release fence of push() and the acquire loads are. Elements are read before the CAS of a thief validates
+// them, so T is restricted to atomic base types (pointers to tasks, indices).
+// When the deque grows, the old buffer may still be read by a thief, so it is not freed but kept in a list
+// until the destruction of the deque. The capacity only doubles, so all old buffers together are smaller
+// than the current one.
+
+#pragma once
+#ifndef CONCURRENTFW_WORK_STEALING_DEQUE_HPP
+#define CONCURRENTFW_WORK_STEALING_DEQUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/helper.hpp>
+
+namespace ConcurrentFW
+{
+
+template<AtomicBaseType T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(size_t initial_capacity = 1024)
+    {
+        if (initial_capacity < 2 || !std::has_single_bit(initial_capacity))
+            throw std::invalid_argument("WorkStealingDeque: capacity must be a power of two, at least 2");
+        buffer.template store<AtomicMemoryOrder::RELAXED>(new Buffer(initial_capacity, nullptr));
+    }
+
+    ~WorkStealingDeque()  // no other thread may use the deque anymore
+    {
+        Buffer* current = buffer.template load<AtomicMemoryOrder::RELAXED>();
+        while (current != nullptr)
+        {
+            Buffer* previous = current->previous;
+            delete current;
+            current = previous;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque(WorkStealingDeque&&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+
+    /////////////////////////////////////////
+    // owner side
+    /////////////////////////////////////////
+
+    void push(T item)
+    {
+        const int64_t b = bottom.template load<AtomicMemoryOrder::RELAXED>();
+        const int64_t t = top.template load<AtomicMemoryOrder::ACQUIRE>();
+        Buffer* current = buffer.template load<AtomicMemoryOrder::RELAXED>();
+        if (UNLIKELY(b - t > current->mask))  // full
+            current = grow(current, b, t);
+        current->put(b, item);
+        atomic_thread_fence<AtomicMemoryOrder::RELEASE>();  // item before new bottom
+        bottom.template store<AtomicMemoryOrder::RELAXED>(b + 1);
+    }
+
+    bool pop(T& item) noexcept
+    {
+        const int64_t b = bottom.template load<AtomicMemoryOrder::RELAXED>() - 1;
+        Buffer* current = buffer.template load<AtomicMemoryOrder::RELAXED>();
+        bottom.template store<AtomicMemoryOrder::RELAXED>(b);
+        atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();  // reservation of bottom before top is read
+        const int64_t t = top.template load<AtomicMemoryOrder::RELAXED>();
+
+        if (t > b)  // empty
+        {
+            bottom.template store<AtomicMemoryOrder::RELAXED>(b + 1);
+            return false;
+        }
+        item = current->get(b);
+        if (t == b)  // last element, race with thieves
+        {
+            const bool won = claim_top(t);
+            bottom.template store<AtomicMemoryOrder::RELAXED>(b + 1);
+            return won;
+        }
+        return true;
+    }
+
+    /////////////////////////////////////////
+    // thief side
+    /////////////////////////////////////////
+
+    // false if the deque is empty or another thread was faster
+    bool steal(T& item) noexcept
+    {
+        const int64_t t = top.template load<AtomicMemoryOrder::ACQUIRE>();
+        atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();  // top before bottom
+        const int64_t b = bottom.template load<AtomicMemoryOrder::ACQUIRE>();
+        if (t >= b)
+            return false;
+
+        Buffer* current = buffer.template load<AtomicMemoryOrder::ACQUIRE>();
+        item = current->get(t);  // speculative, validated by CAS
+        return claim_top(t);
+    }
+
+    /////////////////////////////////////////
+    // both sides
+    /////////////////////////////////////////
+
+    size_t size_approx() const noexcept
+    {
+        const int64_t b = bottom.template load<AtomicMemoryOrder::ACQUIRE>();
+        const int64_t t = top.template load<AtomicMemoryOrder::ACQUIRE>();
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return static_cast<size_t>(buffer.template load<AtomicMemoryOrder::ACQUIRE>()->mask) + 1;
+    }
+
+private:
+    struct Buffer
+    {
+        Buffer(size_t capacity, Buffer* previous_buffer)
+        : mask(static_cast<int64_t>(capacity) - 1)
+        , previous(previous_buffer)
+        , slots(new Atomic<T>[capacity])
+        {}
+
+        ~Buffer()
+        {
+            delete[] slots;
+        }
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        ALWAYS_INLINE T get(int64_t index) const noexcept
+        {
+            return slots[index & mask].template load<AtomicMemoryOrder::RELAXED>();
+        }
+
+        ALWAYS_INLINE void put(int64_t index, T item) noexcept
+        {
+            slots[index & mask].template store<AtomicMemoryOrder::RELAXED>(item);
+        }
+
+        const int64_t mask;
+        Buffer* const previous;  // retired buffer, may still be read by thieves
+        Atomic<T>* const slots;
+    };
+
+    ALWAYS_INLINE bool claim_top(int64_t t) noexcept
+    {
+        return top.template compare_exchange_strong<AtomicMemoryOrder::SEQ_CST, AtomicMemoryOrder::RELAXED>(t, t + 1);
+    }
+
+    Buffer* grow(Buffer* current, int64_t b, int64_t t)
+    {
+        Buffer* grown = new Buffer(2 * (static_cast<size_t>(current->mask) + 1), current);
+        for (int64_t index = t; index < b; index++)
+            grown->put(index, current->get(index));
+        buffer.template store<AtomicMemoryOrder::RELEASE>(grown);
+        return grown;
+    }
+
+    alignas(64) Atomic<int64_t> top {0};     // align to cache line, modified by thieves
+    alignas(64) Atomic<int64_t> bottom {0};  // align to cache line, modified by owner
+    Atomic<Buffer*> buffer;
+};
+
+}  // namespace ConcurrentFW
+
+#endif  // CONCURRENTFW_WORK_STEALING_DEQUE_HPP
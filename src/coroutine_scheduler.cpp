@@ -0,0 +1,243 @@
+/*
+ * coroutine_scheduler.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <new>
+#include <algorithm>
+
+#include <concurrentfw/coroutine_scheduler.hpp>
+
+namespace ConcurrentFW
+{
+
+//////////////////////////////////////////////////////////////////////////
+// task
+//////////////////////////////////////////////////////////////////////////
+
+void* CoroutineTask::promise_type::operator new(size_t size)
+{
+    return CoroutineScheduler::allocate_frame(size);
+}
+
+void CoroutineTask::promise_type::operator delete(void* frame, size_t size) noexcept
+{
+    CoroutineScheduler::deallocate_frame(frame, size);
+}
+
+void CoroutineTask::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    CoroutineScheduler* scheduler = handle.promise().scheduler;
+    handle.destroy();
+    scheduler->finish_task();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// frame cache
+//////////////////////////////////////////////////////////////////////////
+
+void* CoroutineScheduler::allocate_frame(size_t size)
+{
+    const size_t size_class = frame_size_class(size);
+    if (size_class >= FRAME_SIZE_CLASSES) [[unlikely]]
+        return ::operator new(size);
+
+    Worker* worker = current_worker;
+    if (worker != nullptr) [[likely]]
+    {
+        void* frame = worker->frame_cache.frames[size_class].pop();
+        if (frame != nullptr) [[likely]]
+        {
+            worker->frame_cache.cached[size_class]--;
+            return frame;
+        }
+    }
+    return ::operator new(MIN_FRAME_SIZE << size_class);  // full class size, may be cached by any worker later
+}
+
+void CoroutineScheduler::deallocate_frame(void* frame, size_t size) noexcept
+{
+    const size_t size_class = frame_size_class(size);
+    Worker* worker = current_worker;
+    if (size_class < FRAME_SIZE_CLASSES && worker != nullptr
+        && worker->frame_cache.cached[size_class] < MAX_CACHED_FRAMES) [[likely]]
+    {
+        worker->frame_cache.frames[size_class].push(frame);
+        worker->frame_cache.cached[size_class]++;
+        return;
+    }
+    ::operator delete(frame);
+}
+
+CoroutineScheduler::FrameCache::~FrameCache()
+{
+    for (auto& list : frames)
+    {
+        void* frame;
+        while ((frame = list.pop()) != nullptr)
+            ::operator delete(frame);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// scheduler
+//////////////////////////////////////////////////////////////////////////
+
+CoroutineScheduler::CoroutineScheduler(uint32_t worker_count)
+{
+    if (worker_count == 0)
+        worker_count = std::max(1U, std::thread::hardware_concurrency());
+
+    workers.reserve(worker_count);
+    for (uint32_t index = 0; index < worker_count; index++)
+        workers.push_back(std::make_unique<Worker>(*this, index));
+    for (auto& worker : workers)  // all run queues exist before the first worker steals
+        worker->thread = std::thread(&CoroutineScheduler::worker_loop, this, std::ref(*worker));
+}
+
+CoroutineScheduler::~CoroutineScheduler()
+{
+    wait_idle();
+    stopping.store<AtomicMemoryOrder::RELEASE>(true);
+    idle_workers.notify_all();
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+void CoroutineScheduler::spawn(CoroutineTask&& task)
+{
+    auto handle = std::exchange(task.handle, nullptr);
+    handle.promise().scheduler = this;
+    live.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    Worker* worker = current_worker;
+    if (worker != nullptr && &worker->scheduler == this)
+        worker->queue.push(handle.address());
+    else
+        injection.enqueue(handle.address());
+    idle_workers.notify_one();  // only a syscall, if a worker is parked
+}
+
+void CoroutineScheduler::post(std::coroutine_handle<> handle)
+{
+    Worker* worker = current_worker;
+    if (worker != nullptr && &worker->scheduler == this)
+    {
+        void* displaced = std::exchange(worker->lifo, handle.address());
+        if (displaced == nullptr)
+            return;  // runs next on this worker
+        worker->queue.push(displaced);
+    }
+    else
+        injection.enqueue(handle.address());
+    idle_workers.notify_one();
+}
+
+void CoroutineScheduler::wait_idle()
+{
+    while (true)
+    {
+        EventCount::Key key = idle_scheduler.prepare_wait();
+        if (live.load<AtomicMemoryOrder::ACQUIRE>() == 0)
+        {
+            idle_scheduler.cancel_wait();
+            return;
+        }
+        idle_scheduler.wait(key);
+    }
+}
+
+int32_t CoroutineScheduler::worker_index() const noexcept
+{
+    Worker* worker = current_worker;
+    return (worker != nullptr && &worker->scheduler == this) ? static_cast<int32_t>(worker->index) : -1;
+}
+
+void CoroutineScheduler::worker_loop(Worker& worker)
+{
+    current_worker = &worker;
+    void* task;
+    while (true)
+    {
+        if (find_task(worker, task))
+        {
+            std::coroutine_handle<>::from_address(task).resume();
+            continue;
+        }
+
+        bool found = false;
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING && !found; spins++)
+        {
+            cpu_relax();
+            found = find_task(worker, task);
+        }
+        if (found)
+        {
+            std::coroutine_handle<>::from_address(task).resume();
+            continue;
+        }
+
+        EventCount::Key key = idle_workers.prepare_wait();
+        if (find_task(worker, task))
+        {
+            idle_workers.cancel_wait();
+            std::coroutine_handle<>::from_address(task).resume();
+            continue;
+        }
+        if (stopping.load<AtomicMemoryOrder::ACQUIRE>())
+        {
+            idle_workers.cancel_wait();
+            break;
+        }
+        idle_workers.wait(key);
+    }
+    current_worker = nullptr;  // frame cache is freed with the worker
+}
+
+bool CoroutineScheduler::find_task(Worker& worker, void*& task)
+{
+    if (++worker.ticks % GLOBAL_QUEUE_INTERVAL == 0 && injection.dequeue(task))
+        return true;
+    if (worker.lifo != nullptr)
+    {
+        if (worker.lifo_runs < LIFO_BUDGET)
+        {
+            worker.lifo_runs++;
+            task = std::exchange(worker.lifo, nullptr);
+            return true;
+        }
+        worker.queue.push(std::exchange(worker.lifo, nullptr));  // budget exhausted, to the end of the queue
+    }
+    worker.lifo_runs = 0;
+    if (worker.queue.steal(task))  // own queue in FIFO order
+        return true;
+    if (injection.dequeue(task))
+        return true;
+    return steal_task(worker, task);
+}
+
+bool CoroutineScheduler::steal_task(Worker& worker, void*& task)
+{
+    const uint32_t worker_count = size();
+    for (uint32_t attempt = 0; attempt < worker_count; attempt++)
+    {
+        // xorshift64
+        worker.random_state ^= worker.random_state << 13;
+        worker.random_state ^= worker.random_state >> 7;
+        worker.random_state ^= worker.random_state << 17;
+        const uint32_t victim = static_cast<uint32_t>(worker.random_state % worker_count);
+        if (victim != worker.index && workers[victim]->queue.steal(task))
+            return true;
+    }
+    return false;
+}
+
+void CoroutineScheduler::finish_task() noexcept
+{
+    if (live.sub_fetch<AtomicMemoryOrder::ACQ_REL>(1) == 0)
+        idle_scheduler.notify_all();
+}
+
+}  // namespace ConcurrentFW
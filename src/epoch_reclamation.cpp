@@ -0,0 +1,181 @@
+/*
+ * epoch_reclamation.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <algorithm>
+#include <ctime>
+
+#include <concurrentfw/epoch_reclamation.hpp>
+
+namespace ConcurrentFW
+{
+
+static constexpr struct timespec reclaimer_retry {0, 1000000};  // 1ms, if readers block the epoch
+
+EpochDomain::EpochDomain(bool background_reclaimer)
+{
+    if (background_reclaimer)
+        reclaimer = std::thread([this]() { reclaimer_loop(); });
+}
+
+EpochDomain::~EpochDomain()
+{
+    if (reclaimer.joinable())
+    {
+        stopping.store<AtomicMemoryOrder::RELAXED>(true);
+        wakeup.notify_all();
+        reclaimer.join();
+    }
+
+    ThreadRecords<EpochDomain, Record>::forget(*this);
+    std::vector<Retired> reclaimable;
+    reclaimable.swap(reclaimer_retired);
+    adopt(reclaimable);
+    records.for_each([&reclaimable](Record& record)
+                     { reclaimable.insert(reclaimable.end(), record.retired.begin(), record.retired.end()); });
+    for (const Retired& retired : reclaimable)
+        retired.deleter(retired.object);
+}
+
+EpochDomain::Record* EpochDomain::acquire_record()
+{
+    return records.acquire();
+}
+
+void EpochDomain::release_record(Record* record)
+{
+    hand_over(record->retired);  // remaining objects are reclaimed by other threads
+    records.release(record);
+}
+
+EpochDomain& EpochDomain::global()
+{
+    static EpochDomain domain;
+    return domain;
+}
+
+void EpochDomain::retire(void* object, Deleter deleter)
+{
+    Record& record = *ThreadRecords<EpochDomain, Record>::get(*this);
+    // object has been unlinked before, so only readers of the current or older epochs can reference it
+    record.retired.push_back({object, deleter, epoch.load<AtomicMemoryOrder::SEQ_CST>()});
+    if (record.retired.size() >= RETIRE_THRESHOLD) [[unlikely]]
+    {
+        if (has_background_reclaimer())
+            hand_over(record.retired);
+        else if (record.nesting == 0)  // inside a critical region, the epoch cannot advance past our own announcement
+        {
+            adopt(record.retired);  // objects of exited threads, nobody else would reclaim them before destruction
+            collect(record.retired);
+        }
+    }
+}
+
+size_t EpochDomain::reclaim()
+{
+    Record& record = *ThreadRecords<EpochDomain, Record>::get(*this);
+    adopt(record.retired);
+    return collect(record.retired);
+}
+
+size_t EpochDomain::unreclaimed()
+{
+    return ThreadRecords<EpochDomain, Record>::get(*this)->retired.size();
+}
+
+bool EpochDomain::try_advance()
+{
+    const uint64_t current = epoch.load<AtomicMemoryOrder::SEQ_CST>();
+    const uint64_t announced_current = (current << 1) | 1;
+
+    // pairs with the fence after the announcement of a reader
+    atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+    bool blocked = false;
+    records.for_each(
+        [&blocked, announced_current](Record& record)
+        {
+            const uint64_t announced = record.announced.load<AtomicMemoryOrder::ACQUIRE>();
+            if ((announced & 1) != 0 && announced != announced_current)
+                blocked = true;
+        }
+    );
+    if (blocked)
+        return false;
+
+    uint64_t expected = current;
+    epoch.compare_exchange_strong<AtomicMemoryOrder::SEQ_CST, AtomicMemoryOrder::RELAXED>(expected, current + 1);
+    return true;  // failed exchange: other thread has advanced the epoch
+}
+
+size_t EpochDomain::collect(std::vector<Retired>& retired)
+{
+    if (retired.empty())
+        return 0;
+
+    try_advance();
+    const uint64_t current = epoch.load<AtomicMemoryOrder::ACQUIRE>();
+    auto kept = std::partition(
+        retired.begin(), retired.end(), [current](const Retired& object) { return object.epoch + 2 > current; }
+    );
+    size_t reclaimed = static_cast<size_t>(retired.end() - kept);
+    std::vector<Retired> reclaimable(kept, retired.end());
+    retired.erase(kept, retired.end());
+
+    // deleters are called last, as they might retire further objects
+    for (const Retired& object : reclaimable)
+        object.deleter(object.object);
+    return reclaimed;
+}
+
+void EpochDomain::hand_over(std::vector<Retired>& retired)
+{
+    if (retired.empty())
+        return;
+
+    Batch* batch = new Batch {{}, pending.load<AtomicMemoryOrder::RELAXED>()};
+    batch->retired.swap(retired);
+    while (!pending.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(batch->next, batch))
+        ;
+    if (has_background_reclaimer())
+        wakeup.notify_one();
+}
+
+void EpochDomain::adopt(std::vector<Retired>& retired)
+{
+    if (pending.load<AtomicMemoryOrder::RELAXED>() == nullptr)
+        return;
+
+    Batch* batch = pending.exchange<AtomicMemoryOrder::ACQUIRE>(nullptr);
+    while (batch != nullptr)
+    {
+        retired.insert(retired.end(), batch->retired.begin(), batch->retired.end());
+        Batch* next = batch->next;
+        delete batch;
+        batch = next;
+    }
+}
+
+void EpochDomain::reclaimer_loop()
+{
+    while (true)
+    {
+        EventCount::Key key = wakeup.prepare_wait();
+        if (stopping.load<AtomicMemoryOrder::RELAXED>() || pending.load<AtomicMemoryOrder::ACQUIRE>() != nullptr)
+            wakeup.cancel_wait();
+        else if (reclaimer_retired.empty())
+            wakeup.wait(key);
+        else
+            wakeup.wait_timeout(key, &reclaimer_retry);  // retry, when readers have passed their epoch
+
+        if (stopping.load<AtomicMemoryOrder::RELAXED>())
+            break;
+        adopt(reclaimer_retired);
+        collect(reclaimer_retired);
+    }
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,510 @@
+/*
+ * fiber.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <new>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <errno.h>
+#include <sys/mman.h>  // mmap(), mprotect(), munmap()
+
+#include <concurrentfw/fiber.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+//////////////////////////////////////////////////////////////////////////
+// context switch
+//////////////////////////////////////////////////////////////////////////
+
+// saves the callee-saved registers on the current stack, stores the stack pointer in *save_sp,
+// continues with the stack of load_sp and returns to the context saved there
+extern "C" __attribute__((visibility("hidden"))) void concurrentfw_fiber_switch(void** save_sp, void* load_sp);
+
+// first return address of a new fiber: calls entry(fiber), entry and fiber are in callee-saved registers
+extern "C" __attribute__((visibility("hidden"))) void concurrentfw_fiber_trampoline();
+
+#if defined(__x86_64__)
+
+// System V ABI: rbx, rbp, r12-r15, MXCSR control bits and x87 control word are callee-saved
+asm(R"(
+    .text
+    .globl  concurrentfw_fiber_switch
+    .hidden concurrentfw_fiber_switch
+    .type   concurrentfw_fiber_switch, @function
+    .p2align 4
+concurrentfw_fiber_switch:
+    pushq   %rbp
+    pushq   %rbx
+    pushq   %r12
+    pushq   %r13
+    pushq   %r14
+    pushq   %r15
+    subq    $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw  4(%rsp)
+    movq    %rsp, (%rdi)
+    movq    %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw   4(%rsp)
+    addq    $8, %rsp
+    popq    %r15
+    popq    %r14
+    popq    %r13
+    popq    %r12
+    popq    %rbx
+    popq    %rbp
+    ret
+    .size   concurrentfw_fiber_switch, .-concurrentfw_fiber_switch
+
+    .globl  concurrentfw_fiber_trampoline
+    .hidden concurrentfw_fiber_trampoline
+    .type   concurrentfw_fiber_trampoline, @function
+    .p2align 4
+concurrentfw_fiber_trampoline:
+    movq    %r12, %rdi
+    callq   *%r13
+    ud2
+    .size   concurrentfw_fiber_trampoline, .-concurrentfw_fiber_trampoline
+)");
+
+#elif defined(__aarch64__)
+
+// AAPCS64: x19-x28, x29 (frame pointer), x30 (link register) and d8-d15 are callee-saved
+asm(R"(
+    .text
+    .globl  concurrentfw_fiber_switch
+    .hidden concurrentfw_fiber_switch
+    .type   concurrentfw_fiber_switch, %function
+    .p2align 4
+concurrentfw_fiber_switch:
+    sub     sp, sp, #160
+    stp     x19, x20, [sp, #0]
+    stp     x21, x22, [sp, #16]
+    stp     x23, x24, [sp, #32]
+    stp     x25, x26, [sp, #48]
+    stp     x27, x28, [sp, #64]
+    stp     x29, x30, [sp, #80]
+    stp     d8, d9, [sp, #96]
+    stp     d10, d11, [sp, #112]
+    stp     d12, d13, [sp, #128]
+    stp     d14, d15, [sp, #144]
+    mov     x2, sp
+    str     x2, [x0]
+    mov     sp, x1
+    ldp     x19, x20, [sp, #0]
+    ldp     x21, x22, [sp, #16]
+    ldp     x23, x24, [sp, #32]
+    ldp     x25, x26, [sp, #48]
+    ldp     x27, x28, [sp, #64]
+    ldp     x29, x30, [sp, #80]
+    ldp     d8, d9, [sp, #96]
+    ldp     d10, d11, [sp, #112]
+    ldp     d12, d13, [sp, #128]
+    ldp     d14, d15, [sp, #144]
+    add     sp, sp, #160
+    ret
+    .size   concurrentfw_fiber_switch, .-concurrentfw_fiber_switch
+
+    .globl  concurrentfw_fiber_trampoline
+    .hidden concurrentfw_fiber_trampoline
+    .type   concurrentfw_fiber_trampoline, %function
+    .p2align 4
+concurrentfw_fiber_trampoline:
+    mov     x0, x19
+    blr     x20
+    brk     #0
+    .size   concurrentfw_fiber_trampoline, .-concurrentfw_fiber_trampoline
+)");
+
+#else
+#error "fibers: unsupported architecture"
+#endif
+
+namespace ConcurrentFW
+{
+
+//////////////////////////////////////////////////////////////////////////
+// fiber control block, at the top of the fiber stack
+//////////////////////////////////////////////////////////////////////////
+
+class Fiber
+{
+public:
+    Fiber(FiberScheduler& owning_scheduler, void* fiber_stack, std::function<void()>&& func)
+    : scheduler(owning_scheduler)
+    , stack(fiber_stack)
+    , entry(std::move(func))
+    {
+        // initial frame below the control block, as concurrentfw_fiber_switch() would have saved it
+        uintptr_t top = reinterpret_cast<uintptr_t>(this) & ~static_cast<uintptr_t>(15);
+        uint64_t* frame = reinterpret_cast<uint64_t*>(top);
+#if defined(__x86_64__)
+        frame -= 10;
+        frame[0] = 0x1F80ULL | (0x037FULL << 32);  // default MXCSR and x87 control word
+        frame[1] = 0;                              // r15
+        frame[2] = 0;                              // r14
+        frame[3] = reinterpret_cast<uint64_t>(&Fiber::main);  // r13
+        frame[4] = reinterpret_cast<uint64_t>(this);          // r12
+        frame[5] = 0;                                         // rbx
+        frame[6] = 0;                                         // rbp
+        frame[7] = reinterpret_cast<uint64_t>(&concurrentfw_fiber_trampoline);  // return address
+        frame[8] = 0;  // after return: 16 byte aligned for the call in the trampoline
+        frame[9] = 0;
+#elif defined(__aarch64__)
+        frame -= 20;
+        std::fill_n(frame, 20, 0);
+        frame[0] = reinterpret_cast<uint64_t>(this);                            // x19
+        frame[1] = reinterpret_cast<uint64_t>(&Fiber::main);                    // x20
+        frame[11] = reinterpret_cast<uint64_t>(&concurrentfw_fiber_trampoline);  // x30
+#endif
+        sp = frame;
+    }
+
+    static void main(Fiber* fiber) noexcept
+    {
+        fiber->entry();
+        FiberScheduler::suspend(
+            [](void* finished) { static_cast<Fiber*>(finished)->scheduler.finish(static_cast<Fiber*>(finished)); },
+            fiber
+        );
+        __builtin_unreachable();
+    }
+
+    FiberScheduler& scheduler;
+    void* const stack;
+    void* sp;
+    std::function<void()> entry;
+    Fiber* next_waiter {nullptr};
+};
+
+//////////////////////////////////////////////////////////////////////////
+// stack pool
+//////////////////////////////////////////////////////////////////////////
+
+FiberStackPool::FiberStackPool(size_t stack_size)
+: guard_bytes(page_size())
+, stack_bytes((stack_size + page_size() - 1) / page_size() * page_size())
+{
+    if (stack_bytes < 2 * page_size())
+        throw std::invalid_argument("fiber stack needs at least two pages");
+}
+
+FiberStackPool::~FiberStackPool()
+{
+    void* stack;
+    while ((stack = free_stacks.pop()) != nullptr)
+        munmap(static_cast<std::byte*>(stack) - guard_bytes, guard_bytes + stack_bytes);
+}
+
+void* FiberStackPool::acquire()
+{
+    void* stack = free_stacks.pop();
+    if (stack != nullptr)
+        return stack;
+
+    void* mapped_memory = mmap(
+        nullptr,
+        guard_bytes + stack_bytes,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+        -1,
+        0
+    );
+    if (mapped_memory == MAP_FAILED) [[unlikely]]
+        throw std::system_error(errno, std::system_category(), "error in mmap()");
+    if (mprotect(mapped_memory, guard_bytes, PROT_NONE) != 0) [[unlikely]]
+    {
+        const int error = errno;
+        munmap(mapped_memory, guard_bytes + stack_bytes);
+        throw std::system_error(error, std::system_category(), "error in mprotect()");
+    }
+    mapped.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    return static_cast<std::byte*>(mapped_memory) + guard_bytes;
+}
+
+void FiberStackPool::release(void* stack) noexcept
+{
+    free_stacks.push(stack);  // link in lowest word, not used by a released stack
+}
+
+//////////////////////////////////////////////////////////////////////////
+// scheduler
+//////////////////////////////////////////////////////////////////////////
+
+struct FiberScheduler::Worker
+{
+    void* sp {nullptr};  // scheduler context, while a fiber runs
+    Fiber* running {nullptr};
+    void (*after_switch)(void*) {nullptr};
+    void* after_switch_argument {nullptr};
+};
+
+constinit thread_local FiberScheduler::Worker* FiberScheduler::current_worker {nullptr};
+
+// not inlined: a fiber may continue on another worker, the thread local address must not be cached
+__attribute__((noinline)) FiberScheduler::Worker* FiberScheduler::this_worker() noexcept
+{
+    return current_worker;
+}
+
+FiberScheduler::FiberScheduler(uint32_t workers, size_t stack_size)
+: stack_pool(stack_size)
+{
+    if (workers == 0)
+        workers = std::max(1U, std::thread::hardware_concurrency());
+    threads.reserve(workers);
+    for (uint32_t index = 0; index < workers; index++)
+        threads.emplace_back(
+            [this]()
+            {
+                Worker worker;
+                worker_loop(worker);
+            }
+        );
+}
+
+FiberScheduler::~FiberScheduler()
+{
+    wait_idle();
+    stopping.store<AtomicMemoryOrder::RELEASE>(true);
+    ready_event.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void FiberScheduler::spawn_function(std::function<void()>&& func)
+{
+    void* stack = stack_pool.acquire();
+    uintptr_t top = reinterpret_cast<uintptr_t>(stack) + stack_pool.stack_size();
+    uintptr_t control_block = (top - sizeof(Fiber)) & ~static_cast<uintptr_t>(63);
+    Fiber* fiber = new (reinterpret_cast<void*>(control_block)) Fiber(*this, stack, std::move(func));
+    live.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    resume(fiber);
+}
+
+void FiberScheduler::wait_idle()
+{
+    while (true)
+    {
+        EventCount::Key key = idle_event.prepare_wait();
+        if (live.load<AtomicMemoryOrder::ACQUIRE>() == 0)
+        {
+            idle_event.cancel_wait();
+            return;
+        }
+        idle_event.wait(key);
+    }
+}
+
+void FiberScheduler::yield()
+{
+    suspend([](void* fiber) { resume(static_cast<Fiber*>(fiber)); }, current());
+}
+
+bool FiberScheduler::in_fiber()
+{
+    return current() != nullptr;
+}
+
+Fiber* FiberScheduler::current()
+{
+    Worker* worker = this_worker();
+    return worker != nullptr ? worker->running : nullptr;
+}
+
+void FiberScheduler::resume(Fiber* fiber)
+{
+    fiber->scheduler.ready.enqueue(fiber);
+    fiber->scheduler.ready_event.notify_one();  // only a syscall, if a worker is parked
+}
+
+void FiberScheduler::suspend(void (*after_switch)(void*), void* argument)
+{
+    Worker* worker = this_worker();
+    Fiber* fiber = worker->running;
+    worker->after_switch = after_switch;
+    worker->after_switch_argument = argument;
+    concurrentfw_fiber_switch(&fiber->sp, worker->sp);
+    // continues here after resume(), probably on another worker
+}
+
+void FiberScheduler::worker_loop(Worker& worker)
+{
+    current_worker = &worker;
+    Fiber* fiber;
+    while (true)
+    {
+        if (ready.dequeue(fiber))
+        {
+            run(worker, fiber);
+            continue;
+        }
+
+        bool found = false;
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING && !found; spins++)
+        {
+            cpu_relax();
+            found = ready.dequeue(fiber);
+        }
+        if (found)
+        {
+            run(worker, fiber);
+            continue;
+        }
+
+        EventCount::Key key = ready_event.prepare_wait();
+        if (ready.dequeue(fiber))
+        {
+            ready_event.cancel_wait();
+            run(worker, fiber);
+            continue;
+        }
+        if (stopping.load<AtomicMemoryOrder::ACQUIRE>())
+        {
+            ready_event.cancel_wait();
+            break;
+        }
+        ready_event.wait(key);
+    }
+    current_worker = nullptr;
+}
+
+void FiberScheduler::run(Worker& worker, Fiber* fiber)
+{
+    worker.running = fiber;
+    concurrentfw_fiber_switch(&worker.sp, fiber->sp);
+    worker.running = nullptr;
+    if (worker.after_switch != nullptr)  // fiber is suspended now, it may be resumed from now on
+    {
+        auto after_switch = std::exchange(worker.after_switch, nullptr);
+        after_switch(worker.after_switch_argument);
+    }
+}
+
+void FiberScheduler::finish(Fiber* fiber) noexcept
+{
+    void* stack = fiber->stack;
+    fiber->~Fiber();
+    stack_pool.release(stack);
+    if (live.sub_fetch<AtomicMemoryOrder::ACQ_REL>(1) == 0)
+        idle_event.notify_all();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// fiber-aware synchronization
+//////////////////////////////////////////////////////////////////////////
+
+void FiberWaitList::push(Fiber* fiber) noexcept
+{
+    fiber->next_waiter = nullptr;
+    if (tail == nullptr)
+        head = fiber;
+    else
+        tail->next_waiter = fiber;
+    tail = fiber;
+}
+
+Fiber* FiberWaitList::pop() noexcept
+{
+    Fiber* fiber = head;
+    if (fiber != nullptr)
+    {
+        head = fiber->next_waiter;
+        if (head == nullptr)
+            tail = nullptr;
+    }
+    return fiber;
+}
+
+void FiberWaitList::suspend_and_unlock() noexcept
+{
+    FiberScheduler::suspend([](void* list) { static_cast<FiberWaitList*>(list)->unlock(); }, this);
+}
+
+void FiberMutex::lock_contended()
+{
+    while (true)
+    {
+        waiters.lock();
+        if (state.exchange<AtomicMemoryOrder::ACQUIRE>(2) == 0)  // acquired, conservatively marked with waiters
+        {
+            waiters.unlock();
+            return;
+        }
+        waiters.push(FiberScheduler::current());
+        waiters.suspend_and_unlock();
+    }
+}
+
+void FiberMutex::unlock_contended()
+{
+    waiters.lock();
+    state.store<AtomicMemoryOrder::RELEASE>(0);
+    Fiber* fiber = waiters.pop();
+    waiters.unlock();
+    if (fiber != nullptr)
+        FiberScheduler::resume(fiber);  // woken fiber competes again for the lock
+}
+
+void FiberSemaphore::acquire()
+{
+    if (try_acquire())
+        return;
+    waiters.lock();
+    if (try_acquire())
+    {
+        waiters.unlock();
+        return;
+    }
+    waiters.push(FiberScheduler::current());
+    waiters.suspend_and_unlock();  // permit is handed over by release()
+}
+
+void FiberSemaphore::release()
+{
+    waiters.lock();
+    Fiber* fiber = waiters.pop();
+    if (fiber == nullptr)
+        permits.add_fetch<AtomicMemoryOrder::RELEASE>(1);
+    waiters.unlock();
+    if (fiber != nullptr)
+        FiberScheduler::resume(fiber);
+}
+
+void FiberConditionVariable::wait(FiberMutex& mutex)
+{
+    waiters.lock();
+    waiters.push(FiberScheduler::current());
+    mutex.unlock();  // a notifier needs the wait list lock, so no notification is lost
+    waiters.suspend_and_unlock();
+    mutex.lock();
+}
+
+void FiberConditionVariable::notify_one()
+{
+    waiters.lock();
+    Fiber* fiber = waiters.pop();
+    waiters.unlock();
+    if (fiber != nullptr)
+        FiberScheduler::resume(fiber);
+}
+
+void FiberConditionVariable::notify_all()
+{
+    waiters.lock();
+    Fiber* fiber = waiters.pop();
+    while (fiber != nullptr)
+    {
+        Fiber* next = waiters.pop();
+        FiberScheduler::resume(fiber);  // list is still locked, fiber cannot be pushed again meanwhile
+        fiber = next;
+    }
+    waiters.unlock();
+}
+
+}  // namespace ConcurrentFW
@@ -19,6 +19,9 @@
  * see: http://en.cppreference.com/w/cpp/atomic/memory_order
  */
 
+#include <ctime>
+#include <cstdint>
+#include <stdexcept>
 #include <system_error>
 
 #include <errno.h>
@@ -91,4 +94,135 @@ void Futex::wake(void)
     }
 }
 
+void EventCount::wait(Key key)
+{
+    while (true)
+    {
+        int current = value.load<AtomicMemoryOrder::ACQUIRE>();
+        if ((current & ~WAITERS_MASK) != key)  // notified since prepare_wait()
+            break;
+        // EAGAIN is also returned if only the number of waiters has changed
+        if ((futex_wait(current) != 0) && (errno != EAGAIN) && (errno != EINTR)) [[unlikely]]
+        {
+            value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+            throw std::system_error(errno, std::system_category(), "FutexBase::futex_wait()");
+        }
+    }
+    value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+}
+
+bool EventCount::wait_timeout(Key key, const struct timespec* timeout_relative)
+{
+    bool notified = true;
+    while (true)
+    {
+        int current = value.load<AtomicMemoryOrder::ACQUIRE>();
+        if ((current & ~WAITERS_MASK) != key)  // notified since prepare_wait()
+            break;
+        if ((futex_wait(current, timeout_relative) != 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            if (errno == ETIMEDOUT) [[likely]]
+            {
+                notified = false;
+                break;
+            }
+            value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+            throw std::system_error(errno, std::system_category(), "FutexBase::futex_wait()");
+        }
+    }
+    value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+    return notified;
+}
+
+bool EventCount::wait_deadline(Key key, const struct timespec* deadline)
+{
+    bool notified = true;
+    while (true)
+    {
+        int current = value.load<AtomicMemoryOrder::ACQUIRE>();
+        if ((current & ~WAITERS_MASK) != key)  // notified since prepare_wait()
+            break;
+        // FUTEX_WAIT_BITSET takes an absolute timeout, it is not extended by EINTR and spurious wakeups
+        if ((futex_wait_bitset(FUTEX_BITSET_MATCH_ANY, current, deadline) != 0) && (errno != EAGAIN)
+            && (errno != EINTR))
+        {
+            if (errno == ETIMEDOUT) [[likely]]
+            {
+                notified = false;
+                break;
+            }
+            value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+            throw std::system_error(errno, std::system_category(), "FutexBase::futex_wait_bitset()");
+        }
+    }
+    value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+    return notified;
+}
+
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+static_assert(EventCount::WAIT_ANY_MAX == FUTEX_WAITV_MAX, "futex_waitv() takes at most FUTEX_WAITV_MAX futexes");
+#endif
+
+void EventCount::wait_any(EventCount* const* events, const Key* keys, size_t count)
+{
+    auto consume_registrations = [&]()
+    {
+        for (size_t index = 0; index < count; index++)
+            events[index]->value.fetch_sub<AtomicMemoryOrder::RELAXED>(WAITER);
+    };
+
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+    if (count == 0 || count > WAIT_ANY_MAX)
+    {
+        consume_registrations();
+        throw std::invalid_argument("EventCount::wait_any(): 1 to WAIT_ANY_MAX events");
+    }
+    struct futex_waitv waiters[FUTEX_WAITV_MAX];
+    while (true)
+    {
+        for (size_t index = 0; index < count; index++)
+        {
+            int current = events[index]->value.load<AtomicMemoryOrder::ACQUIRE>();
+            if ((current & ~WAITERS_MASK) != keys[index])  // notified since prepare_wait()
+            {
+                consume_registrations();
+                return;
+            }
+            waiters[index].val = static_cast<uint32_t>(current);
+            waiters[index].uaddr = reinterpret_cast<uintptr_t>(&events[index]->value.atomic);
+            waiters[index].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+            waiters[index].__reserved = 0;
+        }
+        // EAGAIN: one of the values has changed, maybe only the number of waiters
+        if ((syscall(SYS_futex_waitv, waiters, count, 0, nullptr, CLOCK_MONOTONIC) < 0) && (errno != EAGAIN)
+            && (errno != EINTR)) [[unlikely]]
+        {
+            consume_registrations();
+            throw std::system_error(errno, std::system_category(), "EventCount::wait_any()");
+        }
+    }
+#else
+    consume_registrations();
+    throw std::system_error(ENOSYS, std::system_category(), "EventCount::wait_any()");
+#endif
+}
+
+bool EventCount::wait_any_supported() noexcept
+{
+#if defined(SYS_futex_waitv) && defined(FUTEX_WAITV_MAX)
+    // an empty vector is rejected with EINVAL by kernels which know futex_waitv(), others return ENOSYS
+    static const bool supported = (syscall(SYS_futex_waitv, nullptr, 0, 0, nullptr, CLOCK_MONOTONIC) < 0)
+                                  && (errno == EINVAL);
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void EventCount::wake(int wakeups) noexcept
+{
+    value.fetch_add<AtomicMemoryOrder::RELEASE>(EPOCH);  // new epoch, waiters will not sleep anymore
+    futex_wake(wakeups);  // can only fail with invalid arguments
+}
+
 }  // namespace ConcurrentFW
@@ -0,0 +1,109 @@
+/*
+ * hazard_pointer.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <algorithm>
+
+#include <concurrentfw/hazard_pointer.hpp>
+
+namespace ConcurrentFW
+{
+
+HazardDomain::~HazardDomain()
+{
+    ThreadRecords<HazardDomain, Record>::forget(*this);
+    records.for_each(
+        [](Record& record)
+        {
+            std::vector<Retired> reclaimable;
+            reclaimable.swap(record.retired);
+            for (const Retired& retired : reclaimable)
+                retired.deleter(retired.object);
+        }
+    );
+}
+
+HazardDomain::Record* HazardDomain::acquire_record()
+{
+    return records.acquire();  // may adopt retired objects of an exited thread
+}
+
+void HazardDomain::release_record(Record* record)
+{
+    scan(*record);  // remaining objects are adopted by the next owner of the record
+    records.release(record);
+}
+
+HazardDomain& HazardDomain::global()
+{
+    static HazardDomain domain;
+    return domain;
+}
+
+size_t HazardDomain::unreclaimed_bound() const noexcept
+{
+    return std::max(MIN_RETIRE_THRESHOLD, 2 * SLOTS_PER_THREAD * records.size());
+}
+
+void HazardDomain::retire(void* object, Deleter deleter)
+{
+    Record& record = *ThreadRecords<HazardDomain, Record>::get(*this);
+    record.retired.push_back({object, deleter});
+    if (record.retired.size() >= unreclaimed_bound()) [[unlikely]]
+        scan(record);
+}
+
+size_t HazardDomain::reclaim()
+{
+    return scan(*ThreadRecords<HazardDomain, Record>::get(*this));
+}
+
+size_t HazardDomain::unreclaimed()
+{
+    return ThreadRecords<HazardDomain, Record>::get(*this)->retired.size();
+}
+
+size_t HazardDomain::scan(Record& record)
+{
+    if (record.retired.empty())
+        return 0;
+
+    // retired objects have been unlinked before, so no new hazard can be set to them after this fence
+    atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+
+    std::vector<void*>& hazards = record.protected_;
+    hazards.clear();
+    records.for_each(
+        [&hazards](Record& other)
+        {
+            for (const Atomic<void*>& hazard : other.hazards)
+            {
+                void* protected_object = hazard.load<AtomicMemoryOrder::ACQUIRE>();
+                if (protected_object != nullptr)
+                    hazards.push_back(protected_object);
+            }
+        }
+    );
+    std::sort(hazards.begin(), hazards.end());
+
+    // keep protected objects in place, reclaim all others
+    auto kept = std::partition(
+        record.retired.begin(),
+        record.retired.end(),
+        [&hazards](const Retired& retired) { return std::binary_search(hazards.begin(), hazards.end(), retired.object); }
+    );
+    size_t reclaimed = static_cast<size_t>(record.retired.end() - kept);
+    std::vector<Retired> reclaimable(kept, record.retired.end());
+    record.retired.erase(kept, record.retired.end());
+
+    // deleters are called last, as they might retire further objects
+    for (const Retired& retired : reclaimable)
+        retired.deleter(retired.object);
+    return reclaimed;
+}
+
+}  // namespace ConcurrentFW
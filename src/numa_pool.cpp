@@ -0,0 +1,164 @@
+/*
+ * numa_pool.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <stdexcept>
+#include <system_error>
+#include <fstream>
+#include <string>
+#include <climits>
+#include <algorithm>
+
+#include <errno.h>
+#include <sched.h>              // getcpu()
+#include <unistd.h>             // syscall()
+#include <sys/syscall.h>        // SYS_mbind
+#include <sys/mman.h>           // mmap(), munmap()
+#include <linux/mempolicy.h>    // MPOL_BIND
+
+#include <concurrentfw/numa_pool.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+namespace ConcurrentFW
+{
+
+static size_t read_possible_nodes()
+{
+    // format is a list of ranges like "0" or "0-3" or "0,2-3", we need the highest node number
+    std::ifstream possible("/sys/devices/system/node/possible");
+    std::string ranges;
+    if (!(possible >> ranges))
+        return 1;  // no NUMA support in kernel
+
+    size_t last_separator = ranges.find_last_of(",-");
+    size_t highest = std::stoul(last_separator == std::string::npos ? ranges : ranges.substr(last_separator + 1));
+    return highest + 1;
+}
+
+size_t numa_nodes()
+{
+    static const size_t value = read_possible_nodes();
+    return value;
+}
+
+size_t numa_current_node()
+{
+    unsigned int cpu;
+    unsigned int node;
+    if (::getcpu(&cpu, &node) != 0) [[unlikely]]  // uses vDSO, if available
+        throw std::system_error(errno, std::system_category(), "error in getcpu()");
+    return node;
+}
+
+static void bind_to_node(void* region, size_t bytes, size_t node)
+{
+    constexpr size_t max_nodes {512};
+    constexpr size_t mask_bits {sizeof(unsigned long) * CHAR_BIT};
+    unsigned long nodemask[max_nodes / mask_bits] {};
+    if (node >= max_nodes)
+        return;  // cannot be expressed, keep default policy
+    nodemask[node / mask_bits] = 1UL << (node % mask_bits);
+
+    // raw syscall, as glibc does not provide mbind() without libnuma
+    if (syscall(SYS_mbind, region, bytes, MPOL_BIND, nodemask, max_nodes, 0) != 0)
+    {
+        // EINVAL: node is offline or has no memory, ENOSYS: no NUMA kernel, EPERM: not allowed in container
+        // in all these cases the region is simply used with the default memory policy
+        if ((errno != EINVAL) && (errno != ENOSYS) && (errno != EPERM))
+            throw std::system_error(errno, std::system_category(), "error in mbind()");
+    }
+}
+
+NumaPool::NumaPool(size_t block_size, size_t blocks_per_node)
+: node_count(numa_nodes()),
+  block_bytes((std::max(block_size, sizeof(void*)) + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1)),
+  node_blocks(blocks_per_node)
+{
+    if (blocks_per_node == 0)
+        throw std::invalid_argument("at least one block per node needed");
+
+    const size_t page = page_size();
+    region_bytes = (block_bytes * node_blocks + page - 1) & ~(page - 1);
+
+    // MAP_NORESERVE: pages are faulted in lazily by the first (node-local) thread touching them
+    void* mapped = mmap(
+        nullptr, region_bytes * node_count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0
+    );
+    if (mapped == MAP_FAILED)
+        throw std::system_error(errno, std::system_category(), "error in mmap()");
+    memory = static_cast<std::byte*>(mapped);
+
+    try
+    {
+        for (size_t node = 0; node < node_count; node++)
+            bind_to_node(memory + node * region_bytes, region_bytes, node);
+        node_lists = new NodeList[node_count];
+    }
+    catch (...)
+    {
+        munmap(memory, region_bytes * node_count);
+        throw;
+    }
+}
+
+NumaPool::~NumaPool()
+{
+    delete[] node_lists;
+    munmap(memory, region_bytes * node_count);
+}
+
+void* NumaPool::allocate_on(size_t node)
+{
+    if (node >= node_count) [[unlikely]]
+        throw std::out_of_range("NUMA node out of range");
+
+    NodeList& list = node_lists[node];
+    void* block = list.free_list.pop();
+    if (block == nullptr)
+    {
+        // free list is empty, so carve a fresh block from the node region
+        if (list.carved.load<AtomicMemoryOrder::RELAXED>() >= node_blocks)
+            return nullptr;  // prevents overflow of carved counter with exhausted pools
+        size_t index = list.carved.fetch_add<AtomicMemoryOrder::RELAXED>(1);
+        if (index >= node_blocks)
+            return nullptr;
+        block = memory + node * region_bytes + index * block_bytes;
+    }
+    return block;
+}
+
+void* NumaPool::allocate()
+{
+    const size_t local = numa_current_node() % node_count;
+    for (size_t offset = 0; offset < node_count; offset++)
+    {
+        void* block = allocate_on((local + offset) % node_count);  // remote memory is better than no memory
+        if (block != nullptr) [[likely]]
+            return block;
+    }
+    return nullptr;
+}
+
+void NumaPool::deallocate(void* block)
+{
+    if (!owns(block)) [[unlikely]]
+        throw std::invalid_argument("block does not belong to pool");
+    node_lists[home_node(block)].free_list.push(block);
+}
+
+size_t NumaPool::home_node(const void* block) const
+{
+    return static_cast<size_t>(static_cast<const std::byte*>(block) - memory) / region_bytes;
+}
+
+bool NumaPool::owns(const void* block) const
+{
+    const auto* address = static_cast<const std::byte*>(block);
+    return (address >= memory) && (address < memory + region_bytes * node_count);
+}
+
+}  // namespace ConcurrentFW
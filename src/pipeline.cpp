@@ -0,0 +1,155 @@
+/*
+ * pipeline.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <pthread.h>  // pthread_setaffinity_np()
+#include <sched.h>    // cpu_set_t
+
+#include <chrono>
+#include <vector>
+#include <system_error>
+
+#include <concurrentfw/pipeline.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+namespace ConcurrentFW
+{
+
+Pipeline::Pipeline(size_t batch, bool pin_to_cpus)
+: batch_size(batch)
+, pin_threads(pin_to_cpus)
+{
+    if (batch_size == 0 || batch_size > RING_CAPACITY)
+        throw std::invalid_argument("Pipeline: batch size must be 1 to RING_CAPACITY");
+}
+
+Pipeline::~Pipeline()
+{
+    wait();
+}
+
+void Pipeline::start()
+{
+    if (!complete)
+        throw std::logic_error("Pipeline: pipeline has no sink");
+    if (started)
+        throw std::logic_error("Pipeline: pipeline already started");
+    started = true;
+
+    // threads wait for the start, so a failure to pin them leaves the rings untouched
+    const std::vector<uint32_t> cpus = pin_threads ? allowed_cpus() : std::vector<uint32_t> {};  // cpuset aware
+    try
+    {
+        uint32_t cpu = 0;
+        for (StageGroup& group : groups)
+            for (auto& worker : group.workers)
+            {
+                Stage* stage = worker.get();
+                stage->thread = std::thread(
+                    [this, stage]()
+                    {
+                        if (wait_for_start())
+                            stage->run();
+                    }
+                );
+                if (pin_threads)
+                    pin(stage->thread, cpus[cpu++ % cpus.size()]);
+            }
+    }
+    catch (...)
+    {
+        release_start(ABORTED);
+        join();
+        throw;
+    }
+    release_start(RUNNING);
+}
+
+void Pipeline::wait()
+{
+    join();
+}
+
+std::vector<PipelineStageStats> Pipeline::stats() const
+{
+    std::vector<PipelineStageStats> all;
+    all.reserve(groups.size());
+    for (const StageGroup& group : groups)
+    {
+        PipelineStageStats stats;
+        stats.name = group.name;
+        stats.workers = static_cast<uint32_t>(group.workers.size());
+        for (const auto& worker : group.workers)
+        {
+            stats.items += worker->counter(ITEMS);
+            stats.batches += worker->counter(BATCHES);
+            stats.busy_ns += worker->counter(BUSY_NS);
+            stats.max_batch_ns = std::max(stats.max_batch_ns, worker->counter(MAX_BATCH_NS));
+            stats.occupancy_sum += worker->counter(OCCUPANCY_SUM);
+            stats.max_occupancy = std::max(stats.max_occupancy, worker->counter(MAX_OCCUPANCY));
+            stats.input_waits += worker->counter(INPUT_WAITS);
+            stats.output_waits += worker->counter(OUTPUT_WAITS);
+        }
+        all.push_back(std::move(stats));
+    }
+    return all;
+}
+
+Pipeline::StageGroup& Pipeline::add_group(std::string name)
+{
+    if (complete)
+        throw std::logic_error("Pipeline: sink must be the last stage");
+    groups.push_back(StageGroup {std::move(name), {}});
+    return groups.back();
+}
+
+bool Pipeline::wait_for_start()
+{
+    while (true)
+    {
+        EventCount::Key key = start_event.prepare_wait();
+        const uint32_t state = start_state.load<AtomicMemoryOrder::ACQUIRE>();
+        if (state != WAITING)
+        {
+            start_event.cancel_wait();
+            return state == RUNNING;
+        }
+        start_event.wait(key);
+    }
+}
+
+void Pipeline::release_start(StartState state)
+{
+    start_state.store<AtomicMemoryOrder::RELEASE>(state);
+    start_event.notify_all();
+}
+
+void Pipeline::join() noexcept
+{
+    for (StageGroup& group : groups)
+        for (auto& worker : group.workers)
+            if (worker->thread.joinable())
+                worker->thread.join();
+}
+
+void Pipeline::pin(std::thread& thread, uint32_t cpu)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    const int error = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    if (error != 0)
+        throw std::system_error(error, std::system_category(), "error in pthread_setaffinity_np()");
+}
+
+uint64_t Pipeline::now_ns() noexcept
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,114 @@
+/*
+ * pool_resource.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <stdexcept>
+#include <memory>
+#include <new>
+
+#include <concurrentfw/pool_resource.hpp>
+
+namespace ConcurrentFW
+{
+
+template<PoolResourceMode MODE>
+PoolResource<MODE>::PoolResource(std::pmr::memory_resource* upstream_resource, size_t chunk_size)
+: upstream(upstream_resource),
+  chunk_bytes(chunk_size)
+{
+    if (upstream == nullptr)
+        throw std::invalid_argument("nullptr not allowed as upstream resource");
+    if (chunk_size < 2 * MAX_BLOCK_SIZE)  // chunk header needs one block
+        throw std::invalid_argument("chunk size must be at least twice MAX_BLOCK_SIZE");
+}
+
+template<PoolResourceMode MODE>
+PoolResource<MODE>::~PoolResource()
+{
+    release();
+}
+
+template<PoolResourceMode MODE>
+void PoolResource<MODE>::release()
+{
+    for (FreeList& free_list : free_lists)  // forget all blocks without touching them
+    {
+        std::destroy_at(&free_list);
+        std::construct_at(&free_list);
+    }
+
+    void* chunk;
+    while ((chunk = chunks.pop()) != nullptr)
+    {
+        const ChunkHeader* header = static_cast<const ChunkHeader*>(chunk);
+        upstream->deallocate(chunk, header->bytes, header->alignment);
+    }
+}
+
+template<PoolResourceMode MODE>
+void* PoolResource<MODE>::refill(size_t size_class_index)
+{
+    const size_t block_size = MIN_BLOCK_SIZE << size_class_index;
+    const size_t header_blocks = (sizeof(ChunkHeader) + block_size - 1) / block_size;
+    const size_t blocks = chunk_bytes / block_size;
+
+    // chunk is aligned to block size, so every block in it is aligned to its own size
+    std::byte* chunk = static_cast<std::byte*>(upstream->allocate(blocks * block_size, block_size));
+    new (chunk) ChunkHeader {nullptr, blocks * block_size, block_size};
+    chunks.push(chunk);
+
+    // first block is returned, all others are linked locally and pushed with a single atomic operation
+    std::byte* first = chunk + header_blocks * block_size;
+    std::byte* last = chunk + (blocks - 1) * block_size;
+    if (first != last)
+    {
+        for (std::byte* block = first + block_size; block < last; block += block_size)
+            *reinterpret_cast<void**>(block) = block + block_size;
+        free_lists[size_class_index].push_list(first + block_size, last);
+    }
+    return first;
+}
+
+template<PoolResourceMode MODE>
+void* PoolResource<MODE>::do_allocate(size_t bytes, size_t alignment)
+{
+    const size_t index = size_class(bytes, alignment);
+    if (index >= SIZE_CLASSES) [[unlikely]]
+        return upstream->allocate(bytes, alignment);
+
+    void* block = free_lists[index].pop();
+    if (block == nullptr) [[unlikely]]
+        block = refill(index);
+    return block;
+}
+
+template<PoolResourceMode MODE>
+void PoolResource<MODE>::do_deallocate(void* block, size_t bytes, size_t alignment)
+{
+    const size_t index = size_class(bytes, alignment);
+    if (index >= SIZE_CLASSES) [[unlikely]]
+        upstream->deallocate(block, bytes, alignment);
+    else
+        free_lists[index].push(block);
+}
+
+template<PoolResourceMode MODE>
+bool PoolResource<MODE>::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+UnsynchronizedPoolResource& thread_pool_resource()
+{
+    static thread_local UnsynchronizedPoolResource resource;
+    return resource;
+}
+
+template class PoolResource<PoolResourceMode::SYNCHRONIZED>;
+template class PoolResource<PoolResourceMode::UNSYNCHRONIZED>;
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,153 @@
+/*
+ * rcu.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <unistd.h>           // syscall()
+#include <sys/syscall.h>      // SYS_membarrier
+#include <linux/membarrier.h>  // constants for membarrier syscall
+
+#include <cerrno>
+#include <system_error>
+
+#include <concurrentfw/rcu.hpp>
+
+namespace ConcurrentFW
+{
+
+static constexpr uint32_t synchronize_spins {1000};  // before waiting readers are yielded to
+
+static bool register_membarrier() noexcept
+{
+    const long commands = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if (commands < 0 || (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) == 0)
+        return false;
+    return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+}
+
+RcuDomain::RcuDomain(bool callback_thread_enabled)
+: expedited(register_membarrier())
+{
+    if (callback_thread_enabled)
+        callback_thread = std::thread([this]() { callback_loop(); });
+}
+
+RcuDomain::~RcuDomain()
+{
+    if (callback_thread.joinable())
+    {
+        stopping.store<AtomicMemoryOrder::RELAXED>(true);
+        wakeup.notify_all();
+        callback_thread.join();
+    }
+    ThreadRecords<RcuDomain, Record>::forget(*this);
+    process_callbacks();
+}
+
+RcuDomain::Record* RcuDomain::acquire_record()
+{
+    return records.acquire();
+}
+
+void RcuDomain::release_record(Record* record)
+{
+    records.release(record);
+}
+
+RcuDomain& RcuDomain::global()
+{
+    static RcuDomain domain;
+    return domain;
+}
+
+void RcuDomain::memory_barrier_all_threads()
+{
+    if (expedited)
+    {
+        if (syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) != 0) [[unlikely]]
+            throw std::system_error(errno, std::system_category(), "membarrier()");
+    }
+    else
+        atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();  // readers execute the fence themselves
+}
+
+void RcuDomain::synchronize()
+{
+    // publications of the caller are ordered before the new grace period
+    const uint64_t target = grace_period.add_fetch<AtomicMemoryOrder::SEQ_CST>(1);
+
+    // snapshots of all readers, which may have read old versions, are visible after this barrier
+    memory_barrier_all_threads();
+
+    records.for_each(
+        [target](Record& record)
+        {
+            uint32_t spins = 0;
+            while (true)
+            {
+                const uint64_t snapshot = record.snapshot.load<AtomicMemoryOrder::ACQUIRE>();
+                if (snapshot == 0 || snapshot >= target)  // quiescent or reader of new grace period
+                    break;
+                if (++spins < synchronize_spins)
+                    cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+        }
+    );
+
+    // reads of old versions are finished before the caller frees them
+    atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+}
+
+void RcuDomain::call_rcu(void* object, Callback callback)
+{
+    Deferred* head = deferred.load<AtomicMemoryOrder::RELAXED>();
+    Deferred* entry = new Deferred {object, callback, head};
+    while (!deferred.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(head, entry))
+        entry->next = head;
+    // entry may already be processed and deleted by the callback thread, only the local head is valid here
+    if (has_callback_thread() && head == nullptr)  // first callback of a new batch
+        wakeup.notify_one();
+}
+
+size_t RcuDomain::process_callbacks()
+{
+    if (deferred.load<AtomicMemoryOrder::RELAXED>() == nullptr)
+        return 0;
+
+    Deferred* entry = deferred.exchange<AtomicMemoryOrder::ACQUIRE>(nullptr);
+    synchronize();  // one grace period for the whole batch
+
+    size_t executed = 0;
+    while (entry != nullptr)
+    {
+        Deferred* next = entry->next;
+        entry->callback(entry->object);
+        delete entry;
+        entry = next;
+        executed++;
+    }
+    return executed;
+}
+
+void RcuDomain::callback_loop()
+{
+    while (true)
+    {
+        EventCount::Key key = wakeup.prepare_wait();
+        if (stopping.load<AtomicMemoryOrder::RELAXED>() || deferred.load<AtomicMemoryOrder::ACQUIRE>() != nullptr)
+            wakeup.cancel_wait();
+        else
+            wakeup.wait(key);
+
+        if (stopping.load<AtomicMemoryOrder::RELAXED>())
+            break;
+        process_callbacks();
+    }
+}
+
+}  // namespace ConcurrentFW
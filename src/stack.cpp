@@ -37,6 +37,23 @@ L0:	ldaxr	x2, [x0]
 */
 }
 
+// pushes a list of blocks with a single atomic operation,
+// the blocks from first to last must already be linked in their first word, as done by push()
+void Stack::push_list(UnspecifiedBlock first, UnspecifiedBlock last)
+{
+    if (!first || !last)
+        throw std::invalid_argument("nullptr not allowed as block");
+
+    stack.modify(
+        [first, last](const UnspecifiedBlock& stack_cached, UnspecifiedBlock& stack_modify)
+        {
+            *std::bit_cast<UnspecifiedBlock*>(last) = stack_cached;
+            stack_modify = first;
+            return true;
+        }
+    );
+}
+
 Stack::UnspecifiedBlock Stack::pop()
 {
     UnspecifiedBlock top;  // will always be initialized in lambda
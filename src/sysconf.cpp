@@ -6,8 +6,10 @@
  * This file is distributed under the MIT license, see file LICENSE.
  */
 
+#include <cerrno>
 #include <climits>
 
+#include <sched.h>  // sched_getaffinity()
 
 #include <concurrentfw/sysconf.hpp>
 
@@ -26,4 +28,17 @@ size_t page_size()
     return value;
 }
 
+std::vector<uint32_t> allowed_cpus()
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+        throw std::system_error(errno, std::system_category(), "error in sched_getaffinity()");
+    std::vector<uint32_t> allowed;
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &cpus))
+            allowed.push_back(cpu);
+    return allowed;
+}
+
 }  // namespace ConcurrentFW
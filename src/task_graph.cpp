@@ -0,0 +1,96 @@
+/*
+ * task_graph.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <stdexcept>
+
+#include <concurrentfw/task_graph.hpp>
+
+namespace ConcurrentFW
+{
+
+TaskGraph::NodeId TaskGraph::add_node(std::function<void()>&& func)
+{
+    nodes.push_back(std::make_unique<Node>(*this, std::move(func)));
+    validated = false;
+    return static_cast<NodeId>(nodes.size() - 1);
+}
+
+void TaskGraph::precede(NodeId before, NodeId after)
+{
+    if (before >= nodes.size() || after >= nodes.size())
+        throw std::out_of_range("TaskGraph: unknown node");
+    if (before == after)
+        throw std::logic_error("TaskGraph: node cannot precede itself");
+    nodes[before]->successors.push_back(after);
+    nodes[after]->predecessors++;
+    validated = false;
+}
+
+void TaskGraph::run(ThreadPool& pool)
+{
+    if (!validated)
+        validate();
+    if (nodes.empty())
+        return;
+
+    for (auto& node : nodes)
+        node->unfinished.store<AtomicMemoryOrder::RELAXED>(node->predecessors);
+    finished.store<AtomicMemoryOrder::RELAXED>(0);
+    running_pool = &pool;
+
+    for (NodeId root : roots)  // pool publishes the reset counters with the submission
+        pool.submit_task(nodes[root].get());
+    pool.wait_until([this]() { return finished.load<AtomicMemoryOrder::ACQUIRE>() == nodes.size(); });
+    running_pool = nullptr;
+}
+
+void TaskGraph::validate()  // Kahn's algorithm, also collects the roots
+{
+    roots.clear();
+    std::vector<uint32_t> unfinished(nodes.size());
+    std::vector<NodeId> ready;
+    for (NodeId id = 0; id < nodes.size(); id++)
+    {
+        unfinished[id] = nodes[id]->predecessors;
+        if (unfinished[id] == 0)
+            ready.push_back(id);
+    }
+    roots = ready;
+
+    size_t visited = 0;
+    while (!ready.empty())
+    {
+        NodeId id = ready.back();
+        ready.pop_back();
+        visited++;
+        for (NodeId successor : nodes[id]->successors)
+            if (--unfinished[successor] == 0)
+                ready.push_back(successor);
+    }
+    if (visited != nodes.size())
+        throw std::logic_error("TaskGraph: graph contains a cycle");
+    validated = true;
+}
+
+void TaskGraph::Node::run() noexcept
+{
+    work();
+    for (NodeId successor : successors)
+    {
+        Node* node = graph.nodes[successor].get();
+        if (node->unfinished.sub_fetch<AtomicMemoryOrder::ACQ_REL>(1) == 0)  // last dependency
+            graph.running_pool->submit_task(node);
+    }
+}
+
+void TaskGraph::Node::release() noexcept
+{
+    graph.finished.add_fetch<AtomicMemoryOrder::RELEASE>(1);  // last access to the node during this run
+}
+
+}  // namespace ConcurrentFW
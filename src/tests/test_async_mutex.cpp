@@ -0,0 +1,238 @@
+/*
+ * test_async_mutex.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <coroutine>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/async_mutex.hpp>
+
+// fire-and-forget coroutine, starts immediately and destroys its frame at the end
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {}
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+// co_await Reschedule {pool}: continues as a task of the pool
+struct Reschedule
+{
+    ConcurrentFW::ThreadPool& pool;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        pool.post(handle);
+    }
+    void await_resume() const noexcept
+    {}
+};
+
+TEST_CASE("check of async mutex", "[async_mutex]")
+{
+    // inline hand-over without any threads
+    ConcurrentFW::AsyncMutex mutex;
+    uint32_t steps = 0;
+    auto holder = [&]() -> Detached
+    {
+        co_await mutex.lock();
+        steps++;
+    };
+    auto waiter = [&]() -> Detached
+    {
+        co_await mutex.lock();
+        steps += 10;
+        mutex.unlock();
+    };
+    holder();
+    CHECK(steps == 1);
+    CHECK_FALSE(mutex.try_lock());
+    waiter();
+    CHECK(steps == 1);  // suspended
+    mutex.unlock();     // resumes waiter inline, which unlocks
+    CHECK(steps == 11);
+    CHECK(mutex.try_lock());
+    mutex.unlock();
+
+    // contention on a pool, inline and executor resumption
+    ConcurrentFW::ThreadPool pool(4);
+    uint64_t counter = 0;
+    ConcurrentFW::Atomic<uint32_t> finished {0};
+    auto worker = [&](uint32_t index) -> Detached
+    {
+        co_await Reschedule {pool};
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            if ((index + i) % 2 == 0)
+                co_await mutex.lock();
+            else
+                co_await mutex.lock_on(pool);
+            uint64_t value = counter;
+            if (i % 10 == 0)
+                co_await Reschedule {pool};  // suspended while holding the lock
+            counter = value + 1;
+            mutex.unlock();
+        }
+        finished.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+    };
+    for (uint32_t index = 0; index < 1000; index++)
+        worker(index);
+    pool.wait_idle();
+    CHECK(finished.load() == 1000);
+    CHECK(counter == 1000 * 100);
+    CHECK(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST_CASE("check of async semaphore", "[async_mutex]")
+{
+    ConcurrentFW::AsyncSemaphore semaphore(3);
+    CHECK(semaphore.available() == 3);
+
+    ConcurrentFW::ThreadPool pool(4);
+    ConcurrentFW::Atomic<int32_t> inside {0};
+    ConcurrentFW::Atomic<int32_t> max_inside {0};
+    ConcurrentFW::Atomic<uint32_t> finished {0};
+    auto worker = [&](uint32_t index) -> Detached
+    {
+        co_await Reschedule {pool};
+        for (uint32_t i = 0; i < 50; i++)
+        {
+            if ((index + i) % 2 == 0)
+                co_await semaphore.acquire();
+            else
+                co_await semaphore.acquire_on(pool);
+            int32_t now = inside.add_fetch<ConcurrentFW::AtomicMemoryOrder::ACQ_REL>(1);
+            int32_t seen = max_inside.load();
+            while (now > seen && !max_inside.compare_exchange_weak(seen, now))
+                ;
+            co_await Reschedule {pool};
+            inside.sub_fetch<ConcurrentFW::AtomicMemoryOrder::ACQ_REL>(1);
+            semaphore.release();
+        }
+        finished.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+    };
+    for (uint32_t index = 0; index < 500; index++)
+        worker(index);
+    pool.wait_idle();
+    CHECK(finished.load() == 500);
+    CHECK(max_inside.load() <= 3);
+    CHECK(semaphore.available() == 3);
+
+    // permits released by a thread, which is no coroutine
+    ConcurrentFW::AsyncSemaphore gate(0);
+    uint32_t passed = 0;
+    auto blocked = [&]() -> Detached
+    {
+        co_await gate.acquire();
+        passed++;
+    };
+    blocked();
+    blocked();
+    CHECK(gate.available() == -2);
+    CHECK_FALSE(gate.try_acquire());
+    gate.release();
+    gate.release();
+    CHECK(passed == 2);
+    gate.release();
+    CHECK(gate.try_acquire());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: 10k contending coroutines on 8 threads, AsyncMutex against thread-blocking Futex
+///////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("check async mutex against futex", "[async_mutex]")
+{
+    constexpr uint32_t coroutines {10000};
+    constexpr uint32_t iterations {20};
+    constexpr uint32_t threads {8};
+    constexpr uint64_t operations {static_cast<uint64_t>(coroutines) * iterations};
+
+    ConcurrentFW::ThreadPool pool(threads);
+    uint64_t counter_async = 0;
+    uint64_t counter_futex = 0;
+    ConcurrentFW::AsyncMutex async_mutex;
+    ConcurrentFW::Futex futex;
+
+    auto critical_section = [](uint64_t& counter)
+    {
+        for (uint32_t work = 0; work < 16; work++)
+            counter = counter * 3 % 1000003 + 1;
+    };
+
+    auto async_worker = [&]() -> Detached
+    {
+        co_await Reschedule {pool};
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            co_await async_mutex.lock_on(pool);
+            critical_section(counter_async);
+            async_mutex.unlock();
+            co_await Reschedule {pool};
+        }
+    };
+
+    auto futex_worker = [&]() -> Detached
+    {
+        co_await Reschedule {pool};
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            futex.lock();  // blocks the executor thread
+            critical_section(counter_futex);
+            futex.unlock();
+            co_await Reschedule {pool};
+        }
+    };
+
+    auto start_async = std::chrono::steady_clock::now();
+    for (uint32_t coroutine = 0; coroutine < coroutines; coroutine++)
+        async_worker();
+    pool.wait_idle();
+    std::chrono::duration<double> time_async = std::chrono::steady_clock::now() - start_async;
+
+    auto start_futex = std::chrono::steady_clock::now();
+    for (uint32_t coroutine = 0; coroutine < coroutines; coroutine++)
+        futex_worker();
+    pool.wait_idle();
+    std::chrono::duration<double> time_futex = std::chrono::steady_clock::now() - start_futex;
+
+    INFO("coroutines: " << coroutines << ", threads: " << threads << ", lock operations: " << operations);
+    INFO("Benchmark: AsyncMutex: " << operations / time_async.count() / 1e6 << " M locks/s");
+    INFO("Benchmark: Futex: " << operations / time_futex.count() / 1e6 << " M locks/s");
+    CHECK(counter_async == counter_futex);  // same sequence of critical sections
+    CHECK(async_mutex.try_lock());
+}
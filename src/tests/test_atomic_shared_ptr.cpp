@@ -0,0 +1,206 @@
+/*
+ * test_atomic_shared_ptr.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/atomic_shared_ptr.hpp>
+
+namespace
+{
+
+ConcurrentFW::Atomic<int64_t> live_snapshots {0};
+
+struct Snapshot  // e.g. routing table
+{
+    static constexpr uint64_t ALIVE {0x5A95407A5A95407A};
+
+    explicit Snapshot(uint64_t init)
+    : version(init)
+    {
+        live_snapshots.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    ~Snapshot()
+    {
+        magic = 0;
+        live_snapshots.sub_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    volatile uint64_t magic {ALIVE};
+    uint64_t version;
+};
+
+}  // namespace
+
+TEST_CASE("check of atomic shared pointer", "[atomic_shared_ptr]")
+{
+    static_assert(!ConcurrentFW::AtomicSharedPtr<Snapshot>::is_always_lock_free);  // nodes are allocated
+    {
+        ConcurrentFW::AtomicSharedPtr<Snapshot> empty;
+        CHECK(empty.load() == nullptr);
+
+        ConcurrentFW::AtomicSharedPtr<Snapshot> published(std::make_shared<Snapshot>(1));
+        std::shared_ptr<Snapshot> first = published.load();
+        CHECK(first->version == 1);
+        CHECK(first.use_count() == 2);  // published node and local copy
+
+        published.store(std::make_shared<Snapshot>(2));
+        CHECK(first.use_count() == 1);  // replaced snapshot is still owned locally
+        CHECK(first->magic == Snapshot::ALIVE);
+        CHECK(published.load()->version == 2);
+
+        std::shared_ptr<Snapshot> replaced = published.exchange(std::make_shared<Snapshot>(3));
+        CHECK(replaced->version == 2);
+        CHECK(live_snapshots.load() == 3);
+
+        std::shared_ptr<Snapshot> expected = first;
+        CHECK(!published.compare_exchange_strong(expected, std::make_shared<Snapshot>(4)));
+        CHECK(expected->version == 3);
+        CHECK(published.compare_exchange_strong(expected, std::make_shared<Snapshot>(4)));
+        CHECK(published.load()->version == 4);
+        CHECK(expected.use_count() == 1);
+
+        first.reset();
+        replaced.reset();
+        expected.reset();
+        CHECK(live_snapshots.load() == 1);
+
+        published.store(nullptr);
+        CHECK(published.load() == nullptr);
+        CHECK(live_snapshots.load() == 0);
+        published.store(std::make_shared<Snapshot>(5));
+
+        // nodes replaced by nodes with an equal pointer do not let the exchange fail
+        std::shared_ptr<Snapshot> same = std::make_shared<Snapshot>(6);
+        published.store(same);
+        ConcurrentFW::Atomic<bool> stop {false};
+        std::thread storing(
+            [&]()
+            {
+                while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                    published.store(same);
+            }
+        );
+        uint32_t failed = 0;
+        for (uint32_t i = 0; i < 100000; i++)
+        {
+            expected = same;
+            if (!published.compare_exchange_strong(expected, same))
+                failed++;
+        }
+        stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+        storing.join();
+        CHECK(failed == 0);
+    }
+    CHECK(live_snapshots.load() == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: hot reloaded snapshots with many readers
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr std::chrono::milliseconds snapshot_runtime(250);
+
+template<typename PUBLISHED, typename LOAD, typename STORE>
+static void run_snapshot_readers(PUBLISHED& published, LOAD&& load, STORE&& store, uint64_t& loads, uint64_t& invalid)
+{
+    const uint32_t readers = std::max(2U, std::thread::hardware_concurrency());
+
+    ConcurrentFW::Atomic<bool> stop {false};
+    ConcurrentFW::Atomic<uint64_t> total_loads {0};
+    ConcurrentFW::Atomic<uint64_t> total_invalid {0};
+
+    std::vector<std::thread> threads;
+    for (uint32_t reader = 0; reader < readers; reader++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local_loads = 0;
+                uint64_t local_invalid = 0;
+                uint64_t last_version = 0;
+                while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                {
+                    std::shared_ptr<Snapshot> snapshot = load(published);
+                    if (snapshot->magic != Snapshot::ALIVE || snapshot->version < last_version)
+                        local_invalid++;
+                    last_version = snapshot->version;
+                    local_loads++;
+                }
+                total_loads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_loads);
+                total_invalid.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_invalid);
+            }
+        );
+
+    uint64_t version = 0;
+    auto end = std::chrono::steady_clock::now() + snapshot_runtime;
+    while (std::chrono::steady_clock::now() < end)  // hot reload
+    {
+        store(published, std::make_shared<Snapshot>(++version));
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    loads = total_loads.load();
+    invalid = total_invalid.load();
+}
+
+TEST_CASE("check atomic shared pointer against std::atomic<std::shared_ptr>", "[atomic_shared_ptr]")
+{
+    uint64_t loads_concurrentfw = 0;
+    uint64_t invalid_concurrentfw = 0;
+    {
+        ConcurrentFW::AtomicSharedPtr<Snapshot> published(std::make_shared<Snapshot>(0));
+        run_snapshot_readers(
+            published,
+            [](ConcurrentFW::AtomicSharedPtr<Snapshot>& ptr) { return ptr.load(); },
+            [](ConcurrentFW::AtomicSharedPtr<Snapshot>& ptr, std::shared_ptr<Snapshot>&& snapshot)
+            { ptr.store(std::move(snapshot)); },
+            loads_concurrentfw,
+            invalid_concurrentfw
+        );
+    }
+    CHECK(live_snapshots.load() == 0);
+
+    uint64_t loads_std = 0;
+    uint64_t invalid_std = 0;
+    {
+        std::atomic<std::shared_ptr<Snapshot>> published(std::make_shared<Snapshot>(0));
+        INFO("std::atomic<std::shared_ptr> is lock free: " << published.is_lock_free());
+        run_snapshot_readers(
+            published,
+            [](std::atomic<std::shared_ptr<Snapshot>>& ptr) { return ptr.load(); },
+            [](std::atomic<std::shared_ptr<Snapshot>>& ptr, std::shared_ptr<Snapshot>&& snapshot)
+            { ptr.store(std::move(snapshot)); },
+            loads_std,
+            invalid_std
+        );
+    }
+
+    double seconds = std::chrono::duration<double>(snapshot_runtime).count();
+    auto per_second = [seconds](uint64_t loads) { return static_cast<double>(loads) / seconds; };
+    INFO("Benchmark: ConcurrentFW::AtomicSharedPtr: " << per_second(loads_concurrentfw) << " loads/s");
+    INFO("Benchmark: std::atomic<std::shared_ptr>: " << per_second(loads_std) << " loads/s");
+    CHECK(invalid_concurrentfw == 0);
+    CHECK(invalid_std == 0);
+    CHECK(loads_concurrentfw > 0);
+    CHECK(live_snapshots.load() == 0);
+}
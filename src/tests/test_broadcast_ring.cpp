@@ -0,0 +1,287 @@
+/*
+ * test_broadcast_ring.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/spsc_ring.hpp>
+#include <concurrentfw/broadcast_ring.hpp>
+
+// journal and replicate see every item, apply runs after both
+template<ConcurrentFW::BroadcastWait WAIT>
+static bool run_graph(uint64_t items)
+{
+    ConcurrentFW::BroadcastRing<uint64_t, WAIT> ring(256);
+    auto& journal = ring.add_consumer();
+    auto& replicate = ring.add_consumer();
+    auto& apply = ring.add_consumer({&journal, &replicate});
+
+    std::vector<uint64_t> journaled(items);
+    std::vector<uint64_t> replicated(items);
+    bool journal_ordered = true;
+    bool replicate_ordered = true;
+    bool apply_after_both = true;
+    uint64_t applied = 0;
+
+    std::thread journal_thread(
+        [&]()
+        {
+            uint64_t expected = 0;
+            while (journal.consume(
+                [&](uint64_t item)
+                {
+                    journal_ordered &= item == expected;
+                    journaled[expected++] = item + 1;
+                }
+            ))
+                ;
+        }
+    );
+    std::thread replicate_thread(
+        [&]()
+        {
+            uint64_t expected = 0;
+            while (replicate.consume(
+                [&](uint64_t item)
+                {
+                    replicate_ordered &= item == expected;
+                    replicated[expected++] = item + 2;
+                },
+                7
+            ))
+                ;
+        }
+    );
+    std::thread apply_thread(
+        [&]()
+        {
+            while (apply.consume(
+                [&](uint64_t item)
+                {
+                    apply_after_both &= journaled[item] == item + 1 && replicated[item] == item + 2;
+                    applied++;
+                }
+            ))
+                ;
+        }
+    );
+
+    for (uint64_t item = 0; item < items; item++)
+        ring.push(item);
+    ring.close();
+    journal_thread.join();
+    replicate_thread.join();
+    apply_thread.join();
+
+    return journal_ordered && replicate_ordered && apply_after_both && applied == items
+           && journal.sequence() == items && apply.sequence() == items;
+}
+
+TEST_CASE("check of broadcast ring", "[broadcast_ring]")
+{
+    CHECK_THROWS_AS(ConcurrentFW::BroadcastRing<int>(3), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::BroadcastRing<int>(1), std::invalid_argument);
+
+    ConcurrentFW::BroadcastRing<int> ring(4);
+    ConcurrentFW::BroadcastRing<int> other(4);
+    auto& foreign = other.add_consumer();
+    CHECK_THROWS_AS(ring.add_consumer({&foreign}), std::invalid_argument);
+    auto& first = ring.add_consumer();
+    auto& second = ring.add_consumer({&first});
+    CHECK(ring.capacity() == 4);
+
+    std::vector<int> seen;
+    auto collect = [&](int item) { seen.push_back(item); };
+    CHECK(first.try_consume(collect) == 0);
+    ring.push(1);
+    CHECK_THROWS_AS(ring.add_consumer(), std::logic_error);
+    ring.claim() = 2;
+    ring.publish();
+    CHECK(ring.sequence() == 2);
+    CHECK(second.try_consume(collect) == 0);  // first has not finished
+    CHECK(first.consume(collect, 1) == 1);
+    CHECK(second.try_consume(collect) == 1);
+    CHECK(first.consume(collect) == 1);
+    CHECK(second.consume(collect) == 1);
+    CHECK(seen == std::vector<int> {1, 1, 2, 2});
+
+    // a full ring of four items, then the consumers return 0 after close
+    for (int item = 3; item < 7; item++)
+        ring.push(item);
+    ring.close();
+    CHECK(second.try_consume(collect) == 0);
+    CHECK(first.consume(collect) == 4);
+    CHECK(second.consume(collect) == 4);
+    CHECK(first.consume(collect) == 0);
+    CHECK(second.consume(collect) == 0);
+    CHECK(seen.size() == 12);
+
+    CHECK(run_graph<ConcurrentFW::BroadcastWait::PARK>(200000));
+    CHECK(run_graph<ConcurrentFW::BroadcastWait::YIELD>(200000));
+    CHECK(run_graph<ConcurrentFW::BroadcastWait::BUSY_SPIN>(20000));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: latency percentiles with 1 to 8 consumers, against copies into SpscRings
+///////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+struct Tick
+{
+    uint64_t stamp_ns {0};
+    uint64_t sequence {0};
+    double price {0.0};
+    uint64_t payload[5] {};
+};
+
+constexpr uint64_t ticks {100000};
+constexpr auto tick_interval {std::chrono::microseconds(2)};
+
+uint64_t now_ns()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+// paced producer, so the latency is not dominated by a full ring
+template<typename PUBLISH>
+void produce(PUBLISH&& publish)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t sequence = 0; sequence < ticks; sequence++)
+    {
+        while (std::chrono::steady_clock::now() < start + sequence * tick_interval)
+            std::this_thread::yield();
+        Tick tick {now_ns(), sequence, 100.0 + static_cast<double>(sequence % 100), {}};
+        publish(tick);
+    }
+}
+
+std::string percentiles(std::vector<uint64_t>& latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double fraction)
+    { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()))]; };
+    std::ostringstream text;
+    text << "p50 " << at(0.5) << " ns, p99 " << at(0.99) << " ns, p99.9 " << at(0.999) << " ns";
+    return text.str();
+}
+
+template<ConcurrentFW::BroadcastWait WAIT>
+std::string broadcast_latency(uint32_t consumer_count, bool& complete)
+{
+    ConcurrentFW::BroadcastRing<Tick, WAIT> ring(1024);
+    std::vector<typename ConcurrentFW::BroadcastRing<Tick, WAIT>::Consumer*> consumers;
+    for (uint32_t consumer = 0; consumer < consumer_count; consumer++)
+        consumers.push_back(&ring.add_consumer());
+
+    std::vector<std::vector<uint64_t>> latencies(consumer_count);
+    std::vector<std::thread> threads;
+    for (uint32_t consumer = 0; consumer < consumer_count; consumer++)
+        threads.emplace_back(
+            [&, consumer]()
+            {
+                latencies[consumer].reserve(ticks);
+                while (consumers[consumer]->consume(
+                    [&](const Tick& tick) { latencies[consumer].push_back(now_ns() - tick.stamp_ns); }
+                ))
+                    ;
+            }
+        );
+    produce([&](const Tick& tick) { ring.push(tick); });
+    ring.close();
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<uint64_t> all;
+    for (auto& consumer_latencies : latencies)
+        all.insert(all.end(), consumer_latencies.begin(), consumer_latencies.end());
+    complete &= all.size() == ticks * consumer_count;
+    return percentiles(all);
+}
+
+std::string copy_latency(uint32_t consumer_count, bool& complete)
+{
+    using Ring = ConcurrentFW::SpscRing<Tick, 1024>;
+    std::vector<std::unique_ptr<Ring>> rings;
+    for (uint32_t consumer = 0; consumer < consumer_count; consumer++)
+        rings.push_back(std::make_unique<Ring>());
+
+    ConcurrentFW::Atomic<bool> done {false};
+    std::vector<std::vector<uint64_t>> latencies(consumer_count);
+    std::vector<std::thread> threads;
+    for (uint32_t consumer = 0; consumer < consumer_count; consumer++)
+        threads.emplace_back(
+            [&, consumer]()
+            {
+                latencies[consumer].reserve(ticks);
+                Ring& ring = *rings[consumer];
+                Tick tick;
+                while (true)
+                {
+                    if (ring.try_pop(tick))
+                        latencies[consumer].push_back(now_ns() - tick.stamp_ns);
+                    else if (done.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() && ring.size_approx() == 0)
+                        break;
+                    else
+                        std::this_thread::yield();
+                }
+            }
+        );
+    produce(
+        [&](const Tick& tick)
+        {
+            for (auto& ring : rings)
+                while (!ring->try_push(tick))
+                    std::this_thread::yield();
+        }
+    );
+    done.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<uint64_t> all;
+    for (auto& consumer_latencies : latencies)
+        all.insert(all.end(), consumer_latencies.begin(), consumer_latencies.end());
+    complete &= all.size() == ticks * consumer_count;
+    return percentiles(all);
+}
+
+}  // namespace
+
+TEST_CASE("check broadcast ring latency", "[broadcast_ring]")
+{
+    const uint32_t hw_threads = std::max(1U, std::thread::hardware_concurrency());
+    bool complete = true;
+    std::ostringstream results;
+    for (uint32_t consumers : {1U, 2U, 4U, 8U})
+    {
+        results << "\nconsumers: " << consumers;
+        if (consumers < hw_threads)  // producer and every consumer need their own core
+            results << "\n  Benchmark: BroadcastRing busy-spin: "
+                    << broadcast_latency<ConcurrentFW::BroadcastWait::BUSY_SPIN>(consumers, complete);
+        results << "\n  Benchmark: BroadcastRing yield: "
+                << broadcast_latency<ConcurrentFW::BroadcastWait::YIELD>(consumers, complete);
+        results << "\n  Benchmark: BroadcastRing park: "
+                << broadcast_latency<ConcurrentFW::BroadcastWait::PARK>(consumers, complete);
+        results << "\n  Benchmark: copies into SpscRings: " << copy_latency(consumers, complete);
+    }
+    INFO("threads: " << hw_threads << ", ticks: " << ticks << ", interval: " << tick_interval.count() << " us"
+                     << results.str());
+    CHECK(complete);
+}
@@ -0,0 +1,176 @@
+/*
+ * test_bump_arena.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#include <concurrentfw/bump_arena.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+TEST_CASE("check of bump arena", "[bump_arena]")
+{
+    ConcurrentFW::BumpArena::ChunkPool pool(1);
+    CHECK(pool.chunk_size() == ConcurrentFW::page_size());
+    CHECK_THROWS(ConcurrentFW::BumpArena::ChunkPool(0));
+
+    {
+        ConcurrentFW::BumpArena arena(pool);
+        CHECK(arena.statistics().chunks_in_use == 0);
+
+        void* empty = arena.allocate(0);  // unique pointer, also on a fresh arena
+        CHECK(empty != nullptr);
+        CHECK(arena.allocate(0) != empty);
+        CHECK_THROWS_AS(arena.allocate(SIZE_MAX - 8, 16), std::bad_alloc);  // no overflow of the bump pointer
+
+        void* first = arena.allocate(10, 1);
+        void* second = arena.allocate(8, 64);
+        CHECK(reinterpret_cast<uintptr_t>(second) % 64 == 0);
+        CHECK(static_cast<std::byte*>(second) >= static_cast<std::byte*>(first) + 10);
+
+        struct Point
+        {
+            int x;
+            int y;
+        };
+        Point* point = arena.create<Point>(3, 4);
+        CHECK(point->x == 3);
+        CHECK(point->y == 4);
+
+        for (size_t i = 0; i < 100; i++)
+            std::memset(arena.allocate(100), 0x5A, 100);  // needs several chunks
+
+        ConcurrentFW::BumpArena::Statistics stats = arena.statistics();
+        CHECK(stats.chunks_in_use > 1);
+        CHECK(stats.bytes_in_use >= 10000);
+        CHECK(pool.mapped_chunks() == stats.chunks_in_use);
+
+        void* big = arena.allocate(3 * pool.chunk_size(), 128);
+        CHECK(reinterpret_cast<uintptr_t>(big) % 128 == 0);
+        std::memset(big, 0xA5, 3 * pool.chunk_size());
+        CHECK(arena.statistics().oversized_allocations == 1);
+
+        size_t chunks_before_reset = arena.statistics().chunks_in_use;
+        arena.reset();
+        stats = arena.statistics();
+        CHECK(stats.bytes_in_use == 0);
+        CHECK(stats.chunks_in_use == 1);
+        CHECK(stats.chunks_high_water == chunks_before_reset);
+        CHECK(stats.bytes_high_water >= 10000 + 3 * pool.chunk_size());
+        CHECK(stats.resets == 1);
+
+        // recycled chunks are used again, nothing new is mapped
+        size_t mapped = pool.mapped_chunks();
+        for (size_t i = 0; i < 100; i++)
+            arena.allocate(100);
+        CHECK(pool.mapped_chunks() == mapped);
+    }
+
+    // all chunks are back in the pool
+    ConcurrentFW::BumpArena other(pool);
+    size_t mapped = pool.mapped_chunks();
+    for (size_t i = 0; i < mapped; i++)
+        other.allocate(pool.chunk_size() / 2);
+    CHECK(pool.mapped_chunks() == mapped);
+}
+
+TEST_CASE("check of thread bump arenas", "[bump_arena]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    constexpr size_t requests {2000};
+
+    CHECK(&ConcurrentFW::BumpArena::this_thread() == &ConcurrentFW::BumpArena::this_thread());
+    CHECK(ConcurrentFW::BumpArena::this_thread().chunk_size()
+          == ConcurrentFW::BumpArena::DEFAULT_CHUNK_PAGES * ConcurrentFW::page_size());
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> corrupted(hw_threads, 0);
+    for (uint32_t thread = 0; thread < hw_threads; thread++)
+        threads.emplace_back(
+            [&corrupted, thread]()
+            {
+                ConcurrentFW::BumpArena& arena = ConcurrentFW::BumpArena::this_thread();
+                for (size_t request = 0; request < requests; request++)
+                {
+                    std::vector<uint32_t*> allocations;
+                    for (size_t i = 0; i < 64; i++)
+                    {
+                        auto* values = static_cast<uint32_t*>(arena.allocate(sizeof(uint32_t) * (1 + i * 8)));
+                        std::fill_n(values, 1 + i * 8, thread);
+                        allocations.push_back(values);
+                    }
+                    for (size_t i = 0; i < allocations.size(); i++)
+                        corrupted[thread] += std::count_if(
+                            allocations[i], allocations[i] + 1 + i * 8, [thread](uint32_t v) { return v != thread; }
+                        );
+                    arena.reset();
+                }
+            }
+        );
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(std::all_of(corrupted.begin(), corrupted.end(), [](size_t errors) { return errors == 0; }));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: request scoped allocations
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr size_t allocations_per_request {256};
+
+static size_t request_size(size_t i)
+{
+    return 16 + (i * 37) % 496;  // 16..511 bytes
+}
+
+TEST_CASE("check bump arena against malloc", "[bump_arena]")
+{
+    constexpr size_t requests {20000};
+    std::vector<void*> allocations(allocations_per_request);
+
+    auto start_malloc = std::chrono::steady_clock::now();
+    for (size_t request = 0; request < requests; request++)
+    {
+        for (size_t i = 0; i < allocations_per_request; i++)
+        {
+            allocations[i] = malloc(request_size(i));
+            static_cast<char*>(allocations[i])[0] = 1;
+        }
+        for (void* allocation : allocations)
+            free(allocation);
+    }
+    std::chrono::nanoseconds duration_malloc = std::chrono::steady_clock::now() - start_malloc;
+
+    ConcurrentFW::BumpArena& arena = ConcurrentFW::BumpArena::this_thread();
+    auto start_arena = std::chrono::steady_clock::now();
+    for (size_t request = 0; request < requests; request++)
+    {
+        for (size_t i = 0; i < allocations_per_request; i++)
+        {
+            allocations[i] = arena.allocate(request_size(i));
+            static_cast<char*>(allocations[i])[0] = 1;
+        }
+        arena.reset();
+    }
+    std::chrono::nanoseconds duration_arena = std::chrono::steady_clock::now() - start_arena;
+
+    ConcurrentFW::BumpArena::Statistics stats = arena.statistics();
+    INFO("Benchmark: malloc/free: " << duration_malloc.count() / requests << " ns/request");
+    INFO("Benchmark: BumpArena: " << duration_arena.count() / requests << " ns/request");
+    INFO("Factor: " << static_cast<double>(duration_malloc.count()) / static_cast<double>(duration_arena.count()));
+    INFO("high water: " << stats.bytes_high_water << " bytes, " << stats.chunks_high_water << " chunks");
+    CHECK(duration_arena < duration_malloc);
+}
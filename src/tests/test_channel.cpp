@@ -0,0 +1,441 @@
+/*
+ * test_channel.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/channel.hpp>
+
+// all items of all senders arrive exactly once, in order per sender
+static bool run_senders_receivers(size_t capacity, uint32_t senders, uint32_t receivers, uint32_t items)
+{
+    ConcurrentFW::Channel<uint64_t> channel(capacity);
+    std::vector<std::vector<uint32_t>> last(receivers, std::vector<uint32_t>(senders, 0));
+    std::vector<uint64_t> counts(receivers, 0);
+    std::vector<uint8_t> ordered(receivers, 1);
+
+    std::vector<std::thread> threads;
+    for (uint32_t receiver = 0; receiver < receivers; receiver++)
+        threads.emplace_back(
+            [&, receiver]()
+            {
+                uint64_t item;
+                while (channel.recv(item))
+                {
+                    const uint32_t sender = static_cast<uint32_t>(item >> 32);
+                    const uint32_t sequence = static_cast<uint32_t>(item);
+                    if (sequence <= last[receiver][sender])
+                        ordered[receiver] = 0;
+                    last[receiver][sender] = sequence;
+                    counts[receiver]++;
+                }
+            }
+        );
+    std::vector<std::thread> sending;
+    for (uint32_t sender = 0; sender < senders; sender++)
+        sending.emplace_back(
+            [&, sender]()
+            {
+                for (uint32_t sequence = 1; sequence <= items; sequence++)
+                    channel.send((static_cast<uint64_t>(sender) << 32) | sequence);
+            }
+        );
+    for (auto& thread : sending)
+        thread.join();
+    channel.close();
+    for (auto& thread : threads)
+        thread.join();
+
+    uint64_t total = 0;
+    bool all_ordered = true;
+    for (uint32_t receiver = 0; receiver < receivers; receiver++)
+    {
+        total += counts[receiver];
+        all_ordered = all_ordered && ordered[receiver] != 0;
+    }
+    return all_ordered && total == static_cast<uint64_t>(senders) * items;
+}
+
+TEST_CASE("check of channel", "[channel]")
+{
+    // buffered
+    ConcurrentFW::Channel<int> buffered(3);
+    CHECK(buffered.capacity() == 4);
+    int item = 1;
+    for (; item <= 4; item++)
+        CHECK(buffered.try_send(item));
+    CHECK_FALSE(buffered.try_send(item));
+    CHECK(item == 5);  // not moved from
+    int received = 0;
+    CHECK(buffered.try_recv(received));
+    CHECK(received == 1);
+    CHECK(buffered.send(5));
+    buffered.close();
+    CHECK(buffered.is_closed());
+    CHECK_FALSE(buffered.send(6));
+    int sum = 0;
+    while (buffered.recv(received))
+        sum += received;
+    CHECK(sum == 2 + 3 + 4 + 5);
+    CHECK_FALSE(buffered.recv(received));
+
+    // unbuffered: send() returns after the receiver has taken the item
+    ConcurrentFW::Channel<int> rendezvous;
+    CHECK(rendezvous.capacity() == 0);
+    item = 7;
+    CHECK_FALSE(rendezvous.try_send(item));  // no receiver
+    ConcurrentFW::Atomic<int> taken {0};
+    std::thread receiver(
+        [&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            int value;
+            rendezvous.recv(value);
+            taken.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(value);
+            rendezvous.recv(value);  // waits, try_send() may hand over
+            taken.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(value);
+        }
+    );
+    CHECK(rendezvous.send(8));
+    const bool handed_over = rendezvous.try_send(item) || rendezvous.send(item);
+    receiver.join();
+    CHECK(handed_over);
+    CHECK(taken.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() == 7);
+    rendezvous.close();
+    CHECK_FALSE(rendezvous.recv(received));
+
+    CHECK(run_senders_receivers(64, 4, 4, 50000));
+    CHECK(run_senders_receivers(2, 3, 2, 20000));
+    CHECK(run_senders_receivers(0, 4, 4, 5000));
+}
+
+TEST_CASE("check of channel select", "[channel]")
+{
+    ConcurrentFW::Channel<int> numbers(8);
+    ConcurrentFW::Channel<int> words(8);
+    ConcurrentFW::Channel<int> results(1);
+    int from_numbers = 0;
+    int from_words = 0;
+    auto on_numbers = ConcurrentFW::on_recv(numbers, [&](int value) { from_numbers += value; });
+    auto on_words = ConcurrentFW::on_recv(words, [&](int value) { from_words += value; });
+
+    CHECK(ConcurrentFW::try_select(on_numbers, on_words) == ConcurrentFW::SELECT_NONE);
+    words.send(3);
+    CHECK(ConcurrentFW::select(on_numbers, on_words) == 1);
+    CHECK(from_words == 3);
+    numbers.send(4);
+    CHECK(ConcurrentFW::select(on_numbers, on_words) == 0);
+    CHECK(from_numbers == 4);
+
+    // a send case runs, while the receive cases are not ready
+    bool sent = false;
+    CHECK(ConcurrentFW::select(on_numbers, ConcurrentFW::on_send(results, 9, [&]() { sent = true; })) == 1);
+    CHECK(sent);
+    int result = 0;
+    CHECK(results.try_recv(result));
+    CHECK(result == 9);
+
+    // a parked select is woken by another thread
+    std::thread sender(
+        [&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            numbers.send(5);
+        }
+    );
+    CHECK(ConcurrentFW::select(on_numbers, on_words) == 0);
+    sender.join();
+    CHECK(from_numbers == 9);
+
+    // both channels are closed and drained
+    words.send(1);
+    numbers.close();
+    words.close();
+    CHECK(ConcurrentFW::select(on_numbers, on_words) == 1);
+    CHECK(ConcurrentFW::select(on_numbers, on_words) == ConcurrentFW::SELECT_CLOSED);
+    CHECK(from_words == 4);
+
+    // fan-in of two channels into one select loop, rendezvous and buffered
+    constexpr uint32_t items {20000};
+    ConcurrentFW::Channel<uint32_t> left(0);
+    ConcurrentFW::Channel<uint32_t> right(16);
+    auto produce = [&](ConcurrentFW::Channel<uint32_t>& channel)
+    {
+        for (uint32_t value = 1; value <= items; value++)
+            channel.send(value);
+        channel.close();
+    };
+    std::thread left_sender(produce, std::ref(left));
+    std::thread right_sender(produce, std::ref(right));
+    uint64_t left_sum = 0;
+    uint64_t right_sum = 0;
+    auto on_left = ConcurrentFW::on_recv(left, [&](uint32_t value) { left_sum += value; });
+    auto on_right = ConcurrentFW::on_recv(right, [&](uint32_t value) { right_sum += value; });
+    while (ConcurrentFW::select(on_left, on_right) != ConcurrentFW::SELECT_CLOSED)
+        ;
+    left_sender.join();
+    right_sender.join();
+    const uint64_t expected = static_cast<uint64_t>(items) * (items + 1) / 2;
+    CHECK(left_sum == expected);
+    CHECK(right_sum == expected);
+}
+
+TEST_CASE("check of unbuffered channel hand-off", "[channel]")
+{
+    // try_recv() takes the item of a waiting sender
+    ConcurrentFW::Channel<int> rendezvous;
+    std::thread sender([&]() { CHECK(rendezvous.send(11)); });
+    int received = 0;
+    while (!rendezvous.try_recv(received))
+        std::this_thread::yield();
+    sender.join();
+    CHECK(received == 11);
+
+    // close() releases a waiting sender and a waiting receiver
+    ConcurrentFW::Channel<int> closing_send;
+    ConcurrentFW::Channel<int> closing_recv;
+    std::thread blocked_sender([&]() { CHECK_FALSE(closing_send.send(12)); });
+    std::thread blocked_receiver(
+        [&]()
+        {
+            int value = 0;
+            CHECK_FALSE(closing_recv.recv(value));
+        }
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    closing_send.close();
+    closing_recv.close();
+    blocked_sender.join();
+    blocked_receiver.join();
+    CHECK_FALSE(closing_send.try_recv(received));
+
+    // try_send() does not wait for a select(), which has run another case meanwhile
+    ConcurrentFW::Channel<int> first;
+    ConcurrentFW::Channel<int> second;
+    int selected_value = 0;
+    size_t selected = ConcurrentFW::SELECT_NONE;
+    std::thread selecting(
+        [&]()
+        {
+            selected = ConcurrentFW::select(
+                ConcurrentFW::on_recv(first, [&](int value) { selected_value = value; }),
+                ConcurrentFW::on_recv(second, [&](int value) { selected_value = value; })
+            );
+        }
+    );
+    CHECK(second.send(5));
+    selecting.join();
+    int item = 7;
+    CHECK_FALSE(first.try_send(item));
+    CHECK(selected == 1);
+    CHECK(selected_value == 5);
+
+    // send case of a select() on an unbuffered channel
+    bool sent = false;
+    auto send_first = ConcurrentFW::on_send(first, 1, [&]() { sent = true; });
+    CHECK(ConcurrentFW::try_select(send_first) == ConcurrentFW::SELECT_NONE);
+    CHECK_FALSE(sent);
+    std::thread receiver(
+        [&]()
+        {
+            int value = 0;
+            CHECK(first.recv(value));
+            CHECK(value == 2);
+        }
+    );
+    CHECK(ConcurrentFW::select(ConcurrentFW::on_send(first, 2, [&]() { sent = true; })) == 0);
+    receiver.join();
+    CHECK(sent);
+
+    // mirror-image selects, the send case of each one meets the receive case of the other one
+    constexpr uint32_t rounds {20000};
+    uint32_t sent_left = 0;
+    uint32_t received_left = 0;
+    uint32_t sent_right = 0;
+    uint32_t received_right = 0;
+    std::thread mirror(
+        [&]()
+        {
+            for (uint32_t round = 0; round < rounds; round++)
+                ConcurrentFW::select(
+                    ConcurrentFW::on_send(first, 1, [&]() { sent_right++; }),
+                    ConcurrentFW::on_recv(second, [&](int) { received_right++; })
+                );
+        }
+    );
+    for (uint32_t round = 0; round < rounds; round++)
+        ConcurrentFW::select(
+            ConcurrentFW::on_recv(first, [&](int) { received_left++; }),
+            ConcurrentFW::on_send(second, 1, [&]() { sent_left++; })
+        );
+    mirror.join();
+    CHECK(sent_right == received_left);
+    CHECK(sent_left == received_right);
+    CHECK(sent_left + received_left == rounds);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: ping-pong latency and throughput, against a mutex + condition variable channel
+///////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+template<typename T>
+class MutexChannel
+{
+public:
+    explicit MutexChannel(size_t capacity)
+    : limit(capacity)
+    {}
+
+    bool send(T item)
+    {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [&]() { return items.size() < limit || closed; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool recv(T& item)
+    {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [&]() { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    const size_t limit;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    bool closed {false};
+};
+
+constexpr uint32_t round_trips {20000};
+constexpr uint32_t throughput_items {400000};
+
+// nanoseconds per round trip
+template<typename CHANNEL>
+double ping_pong(CHANNEL& ping, CHANNEL& pong, bool& correct)
+{
+    std::thread partner(
+        [&]()
+        {
+            uint32_t value;
+            while (ping.recv(value))
+                pong.send(value + 1);
+        }
+    );
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t trip = 0; trip < round_trips; trip++)
+    {
+        uint32_t answer = 0;
+        ping.send(trip);
+        pong.recv(answer);
+        correct = correct && answer == trip + 1;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    ping.close();
+    partner.join();
+    return std::chrono::duration<double, std::nano>(end - start).count() / round_trips;
+}
+
+// million items per second, two senders and two receivers
+template<typename CHANNEL>
+double throughput(CHANNEL& channel, bool& correct)
+{
+    ConcurrentFW::Atomic<uint64_t> sum {0};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t receiver = 0; receiver < 2; receiver++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local = 0;
+                uint32_t value;
+                while (channel.recv(value))
+                    local += value;
+                sum.fetch_add<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local);
+            }
+        );
+    std::vector<std::thread> senders;
+    for (uint32_t sender = 0; sender < 2; sender++)
+        senders.emplace_back(
+            [&]()
+            {
+                for (uint32_t value = 1; value <= throughput_items / 2; value++)
+                    channel.send(value);
+            }
+        );
+    for (auto& thread : senders)
+        thread.join();
+    channel.close();
+    for (auto& thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t half = throughput_items / 2;
+    correct = correct && sum.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() == half * (half + 1);
+    return throughput_items / seconds / 1e6;
+}
+
+}  // namespace
+
+TEST_CASE("check channel against mutex channel", "[channel]")
+{
+    bool correct = true;
+
+    ConcurrentFW::Channel<uint32_t> rendezvous_ping(0);
+    ConcurrentFW::Channel<uint32_t> rendezvous_pong(0);
+    const double rendezvous_latency = ping_pong(rendezvous_ping, rendezvous_pong, correct);
+    ConcurrentFW::Channel<uint32_t> buffered_ping(1);
+    ConcurrentFW::Channel<uint32_t> buffered_pong(1);
+    const double buffered_latency = ping_pong(buffered_ping, buffered_pong, correct);
+    MutexChannel<uint32_t> mutex_ping(1);
+    MutexChannel<uint32_t> mutex_pong(1);
+    const double mutex_latency = ping_pong(mutex_ping, mutex_pong, correct);
+
+    ConcurrentFW::Channel<uint32_t> channel(1024);
+    const double channel_throughput = throughput(channel, correct);
+    MutexChannel<uint32_t> mutex_channel(1024);
+    const double mutex_throughput = throughput(mutex_channel, correct);
+
+    INFO("threads: " << std::thread::hardware_concurrency() << ", round trips: " << round_trips);
+    INFO("Benchmark: Channel unbuffered ping-pong: " << rendezvous_latency << " ns/round trip");
+    INFO("Benchmark: Channel buffered(1) ping-pong: " << buffered_latency << " ns/round trip");
+    INFO("Benchmark: mutex + condition_variable ping-pong: " << mutex_latency << " ns/round trip");
+    INFO("Benchmark: Channel buffered(1024) 2x2: " << channel_throughput << " M items/s");
+    INFO("Benchmark: mutex + condition_variable 2x2: " << mutex_throughput << " M items/s");
+    INFO("futex_waitv(): " << (ConcurrentFW::EventCount::wait_any_supported() ? "yes" : "no"));
+    CHECK(correct);
+}
@@ -27,4 +27,7 @@ TEST_CASE("check Concurrent_Ptr", "[concurrent_ptr]")
     test_ptr.set(&x3);
     CHECK(*test_ptr.get() == 0x0815);
     CHECK(test_ptr.get_counter() - counter == (3 * ConcurrentFW::ABA_IS_PLATFORM_DWCAS));
+    CHECK(test_ptr.exchange(&x1) == &x3);
+    CHECK(*test_ptr.get() == 42);
+    CHECK(test_ptr.get_counter() - counter == (4 * ConcurrentFW::ABA_IS_PLATFORM_DWCAS));
 }
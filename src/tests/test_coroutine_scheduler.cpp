@@ -0,0 +1,196 @@
+/*
+ * test_coroutine_scheduler.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <algorithm>
+#include <coroutine>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/async_mutex.hpp>
+#include <concurrentfw/coroutine_scheduler.hpp>
+
+TEST_CASE("check of coroutine scheduler", "[coroutine_scheduler]")
+{
+    ConcurrentFW::CoroutineScheduler scheduler(4);
+    CHECK(scheduler.size() == 4);
+    CHECK(scheduler.worker_index() == -1);
+
+    // tasks hop between the workers and spawn tasks
+    ConcurrentFW::Atomic<uint64_t> sum {0};
+    ConcurrentFW::Atomic<uint32_t> in_worker {0};
+    auto leaf = [&](uint64_t value) -> ConcurrentFW::CoroutineTask
+    {
+        for (uint32_t hop = 0; hop < 10; hop++)
+            co_await ConcurrentFW::schedule_on(scheduler);
+        if (scheduler.worker_index() >= 0)
+            in_worker.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        sum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(value);
+    };
+    auto root = [&](uint64_t first) -> ConcurrentFW::CoroutineTask
+    {
+        for (uint64_t value = first; value < first + 100; value++)
+            ConcurrentFW::co_spawn(scheduler, leaf(value));
+        co_return;
+    };
+    for (uint64_t first = 0; first < 1000; first += 100)
+        ConcurrentFW::co_spawn(scheduler, root(first));
+    scheduler.wait_idle();
+    CHECK(sum.load() == 999 * 1000 / 2);
+    CHECK(in_worker.load() == 1000);
+    CHECK(scheduler.live_tasks() == 0);
+
+    // resumption through AsyncMutex goes to the LIFO slot of the unlocking worker
+    ConcurrentFW::AsyncMutex mutex;
+    uint64_t counter = 0;
+    auto locker = [&]() -> ConcurrentFW::CoroutineTask
+    {
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            co_await mutex.lock_on(scheduler);
+            uint64_t value = counter;
+            co_await ConcurrentFW::schedule_on(scheduler);
+            counter = value + 1;
+            mutex.unlock();
+        }
+    };
+    for (uint32_t task = 0; task < 200; task++)
+        ConcurrentFW::co_spawn(scheduler, locker());
+    scheduler.wait_idle();
+    CHECK(counter == 200 * 100);
+
+    // a task, which is not spawned, is destroyed without running
+    bool executed = false;
+    {
+        auto never = [&]() -> ConcurrentFW::CoroutineTask
+        {
+            executed = true;
+            co_return;
+        };
+        ConcurrentFW::CoroutineTask task = never();
+    }
+    CHECK_FALSE(executed);
+
+    // big frames bypass the cache
+    auto big = [&]() -> ConcurrentFW::CoroutineTask
+    {
+        volatile uint8_t buffer[8192];
+        buffer[0] = 1;
+        co_await ConcurrentFW::schedule_on(scheduler);
+        buffer[8191] = buffer[0];
+        sum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(buffer[8191]);
+    };
+    ConcurrentFW::co_spawn(scheduler, big());
+    scheduler.wait_idle();
+    CHECK(sum.load() == 999 * 1000 / 2 + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: spawn and resumption, against coroutines on the ThreadPool
+///////////////////////////////////////////////////////////////////////////////////////////
+
+// fire-and-forget coroutine on the ThreadPool, frame allocated by operator new
+struct PoolCoroutine
+{
+    struct promise_type
+    {
+        PoolCoroutine get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {}
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+TEST_CASE("check coroutine scheduler against thread pool", "[coroutine_scheduler]")
+{
+    constexpr uint32_t chain {200000};
+    constexpr uint32_t coroutines {1000};
+    constexpr uint32_t resumptions {500};
+    const uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+
+    // spawn+resume latency: each task spawns its successor, one at a time
+    ConcurrentFW::CoroutineScheduler scheduler(threads);
+    ConcurrentFW::Atomic<uint32_t> links {0};
+    std::function<ConcurrentFW::CoroutineTask(uint32_t)> link = [&](uint32_t remaining) -> ConcurrentFW::CoroutineTask
+    {
+        links.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        if (remaining > 0)
+            ConcurrentFW::co_spawn(scheduler, link(remaining - 1));
+        co_return;
+    };
+    auto start_chain = std::chrono::steady_clock::now();
+    ConcurrentFW::co_spawn(scheduler, link(chain - 1));
+    scheduler.wait_idle();
+    std::chrono::duration<double> time_chain = std::chrono::steady_clock::now() - start_chain;
+
+    ConcurrentFW::ThreadPool pool(threads);
+    ConcurrentFW::Atomic<uint32_t> pool_links {0};
+    std::function<PoolCoroutine(uint32_t)> pool_link = [&](uint32_t remaining) -> PoolCoroutine
+    {
+        co_await ConcurrentFW::schedule_on(pool);
+        pool_links.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        if (remaining > 0)
+            pool_link(remaining - 1);
+    };
+    auto start_pool_chain = std::chrono::steady_clock::now();
+    pool_link(chain - 1);
+    pool.wait_idle();
+    std::chrono::duration<double> time_pool_chain = std::chrono::steady_clock::now() - start_pool_chain;
+
+    // sustained resumptions: many coroutines yield to their executor
+    auto yielder = [&]() -> ConcurrentFW::CoroutineTask
+    {
+        for (uint32_t i = 0; i < resumptions; i++)
+            co_await ConcurrentFW::schedule_on(scheduler);
+    };
+    auto start_resume = std::chrono::steady_clock::now();
+    for (uint32_t coroutine = 0; coroutine < coroutines; coroutine++)
+        ConcurrentFW::co_spawn(scheduler, yielder());
+    scheduler.wait_idle();
+    std::chrono::duration<double> time_resume = std::chrono::steady_clock::now() - start_resume;
+
+    auto pool_yielder = [&]() -> PoolCoroutine
+    {
+        for (uint32_t i = 0; i < resumptions; i++)
+            co_await ConcurrentFW::schedule_on(pool);
+    };
+    auto start_pool_resume = std::chrono::steady_clock::now();
+    for (uint32_t coroutine = 0; coroutine < coroutines; coroutine++)
+        pool_yielder();
+    pool.wait_idle();
+    std::chrono::duration<double> time_pool_resume = std::chrono::steady_clock::now() - start_pool_resume;
+
+    constexpr double total_resumptions {static_cast<double>(coroutines) * resumptions};
+    INFO("threads: " << threads);
+    INFO("Benchmark: CoroutineScheduler spawn+resume: " << time_chain.count() * 1e9 / chain << " ns");
+    INFO("Benchmark: ThreadPool spawn+resume: " << time_pool_chain.count() * 1e9 / chain << " ns");
+    INFO("Benchmark: CoroutineScheduler: " << total_resumptions / time_resume.count() / 1e6 << " M resumptions/s");
+    INFO("Benchmark: ThreadPool: " << total_resumptions / time_pool_resume.count() / 1e6 << " M resumptions/s");
+    CHECK(links.load() == chain);
+    CHECK(pool_links.load() == chain);
+}
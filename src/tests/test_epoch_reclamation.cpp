@@ -0,0 +1,273 @@
+/*
+ * test_epoch_reclamation.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/concurrent_ptr.hpp>
+#include <concurrentfw/epoch_reclamation.hpp>
+#include <concurrentfw/hazard_pointer.hpp>
+
+namespace
+{
+
+ConcurrentFW::Atomic<int64_t> live_objects {0};
+
+struct Payload
+{
+    static constexpr uint64_t ALIVE {0xA11CE5A11CE5A11C};
+
+    explicit Payload(uint64_t init)
+    : value(init)
+    {
+        live_objects.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    ~Payload()
+    {
+        magic = 0;
+        live_objects.sub_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    Payload(const Payload&) = delete;
+    Payload& operator=(const Payload&) = delete;
+
+    volatile uint64_t magic {ALIVE};
+    uint64_t value;
+};
+
+}  // namespace
+
+TEST_CASE("check of epoch based reclamation", "[epoch_reclamation]")
+{
+    {
+        ConcurrentFW::EpochDomain domain;
+        CHECK(!domain.has_background_reclaimer());
+        ConcurrentFW::Concurrent_Ptr<Payload> shared(new Payload(1));
+
+        {
+            ConcurrentFW::EpochDomain::Guard guard(domain);
+            Payload* payload = shared.get();
+            domain.retire(shared.exchange(new Payload(2)));
+            CHECK(domain.unreclaimed() == 1);
+            for (int i = 0; i < 4; i++)
+                CHECK(domain.reclaim() == 0);  // own critical region blocks reclamation
+            CHECK(payload->magic == Payload::ALIVE);
+
+            {
+                ConcurrentFW::EpochDomain::Guard nested(domain);
+                CHECK(shared.get()->value == 2);
+            }
+        }
+
+        uint64_t epoch = domain.current_epoch();
+        size_t reclaimed = 0;
+        for (int i = 0; i < 3; i++)
+            reclaimed += domain.reclaim();
+        CHECK(reclaimed == 1);
+        CHECK(domain.unreclaimed() == 0);
+        CHECK(domain.current_epoch() > epoch);
+
+        {
+            // a reader of another thread inside a critical region blocks reclamation
+            ConcurrentFW::Atomic<int> state {0};
+            std::thread reader(
+                [&]()
+                {
+                    ConcurrentFW::EpochDomain::Guard guard(domain);
+                    state.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+                    while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() != 2)
+                        std::this_thread::yield();
+                }
+            );
+            while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() != 1)
+                std::this_thread::yield();
+            domain.retire(shared.exchange(new Payload(3)));
+            for (int i = 0; i < 4; i++)
+                CHECK(domain.reclaim() == 0);
+            state.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(2);
+            reader.join();
+        }
+
+        epoch = domain.current_epoch();
+        reclaimed = 0;
+        for (int i = 0; i < 3; i++)
+            reclaimed += domain.reclaim();
+        CHECK(reclaimed == 1);
+        CHECK(domain.unreclaimed() == 0);
+        CHECK(domain.current_epoch() > epoch);
+
+        for (uint64_t i = 0; i < 1000; i++)
+            domain.retire(shared.exchange(new Payload(i)));  // batches are reclaimed without reader
+        CHECK(domain.unreclaimed() < ConcurrentFW::EpochDomain::RETIRE_THRESHOLD);
+
+        std::thread exiting_thread([&]() { domain.retire(shared.exchange(nullptr)); });
+        exiting_thread.join();  // remaining objects of exited thread are reclaimed by domain destructor
+    }
+    CHECK(live_objects.load() == 0);
+
+    {
+        // objects of exited threads are reclaimed by retire() of other threads, not only by the domain destructor
+        constexpr int64_t threshold = ConcurrentFW::EpochDomain::RETIRE_THRESHOLD;
+        ConcurrentFW::EpochDomain domain;
+        for (int round = 0; round < 8; round++)
+        {
+            std::thread exiting_thread(
+                [&]()
+                {
+                    for (uint64_t i = 0; i < threshold / 2; i++)
+                        domain.retire(new Payload(i));
+                }
+            );
+            exiting_thread.join();
+        }
+        CHECK(live_objects.load() == 4 * threshold);
+        for (uint64_t i = 0; i < 4 * threshold && live_objects.load() >= threshold; i++)
+            domain.retire(new Payload(i));
+        CHECK(live_objects.load() < threshold);
+    }
+    CHECK(live_objects.load() == 0);
+
+    {
+        ConcurrentFW::EpochDomain domain(true);
+        CHECK(domain.has_background_reclaimer());
+        for (uint64_t i = 0; i < 10 * ConcurrentFW::EpochDomain::RETIRE_THRESHOLD; i++)
+            domain.retire(new Payload(i));
+        CHECK(domain.unreclaimed() < ConcurrentFW::EpochDomain::RETIRE_THRESHOLD);  // handed over
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (live_objects.load() >= static_cast<int64_t>(ConcurrentFW::EpochDomain::RETIRE_THRESHOLD)
+               && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CHECK(live_objects.load() < static_cast<int64_t>(ConcurrentFW::EpochDomain::RETIRE_THRESHOLD));
+    }
+    CHECK(live_objects.load() == 0);
+}
+
+TEST_CASE("check of concurrent pointer with epoch reclamation", "[epoch_reclamation]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    const uint32_t readers = std::max(1U, hw_threads - 1);
+    constexpr std::chrono::milliseconds runtime(250);
+
+    ConcurrentFW::Atomic<bool> stop {false};
+    ConcurrentFW::Atomic<uint64_t> invalid_reads {0};
+    ConcurrentFW::Atomic<uint64_t> reads {0};
+    uint64_t replacements = 0;
+
+    ConcurrentFW::Concurrent_Ptr<Payload, ConcurrentFW::EpochReclamation> shared(new Payload(0));
+    std::vector<std::thread> threads;
+    for (uint32_t reader = 0; reader < readers; reader++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local_reads = 0;
+                uint64_t local_invalid = 0;
+                while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                {
+                    ConcurrentFW::EpochDomain::Guard guard;
+                    if (shared.get()->magic != Payload::ALIVE)
+                        local_invalid++;
+                    local_reads++;
+                }
+                reads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_reads);
+                invalid_reads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_invalid);
+            }
+        );
+
+    auto end = std::chrono::steady_clock::now() + runtime;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        shared.replace(new Payload(++replacements));
+        if (replacements % 16 == 0)
+            std::this_thread::yield();
+    }
+    stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    shared.replace(nullptr);
+    for (int i = 0; i < 3; i++)
+        ConcurrentFW::EpochDomain::global().reclaim();
+
+    INFO("replacements: " << replacements << ", reads: " << reads.load());
+    CHECK(invalid_reads.load() == 0);
+    CHECK(live_objects.load() == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: read side overhead of reclamation schemes
+///////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename READ>
+static std::chrono::nanoseconds measure_reads(size_t iterations, READ&& read)
+{
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        sum += read();
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+    CHECK(sum == iterations * 42);
+    return duration;
+}
+
+TEST_CASE("check read side overhead of epoch reclamation", "[epoch_reclamation]")
+{
+    constexpr size_t iterations {10000000};
+
+    ConcurrentFW::EpochDomain epoch_domain;
+    ConcurrentFW::HazardDomain hazard_domain;
+    ConcurrentFW::Concurrent_Ptr<Payload> shared(new Payload(42));
+
+    std::chrono::nanoseconds duration_none = measure_reads(iterations, [&]() { return shared.get()->value; });
+
+    std::chrono::nanoseconds duration_epoch = measure_reads(
+        iterations,
+        [&]()
+        {
+            ConcurrentFW::EpochDomain::Guard guard(epoch_domain);
+            return shared.get()->value;
+        }
+    );
+
+    ConcurrentFW::HazardDomain::Guard hazard_guard(hazard_domain);
+    std::chrono::nanoseconds duration_hazard =
+        measure_reads(iterations, [&]() { return hazard_guard.protect(shared)->value; });
+    hazard_guard.reset();
+
+    // one critical region for several loads, as done by lookups in lock-free data structures
+    constexpr size_t loads_per_region {8};
+    std::chrono::nanoseconds duration_epoch_batched = measure_reads(
+        iterations / loads_per_region,
+        [&]()
+        {
+            ConcurrentFW::EpochDomain::Guard guard(epoch_domain);
+            uint64_t value = 0;
+            for (size_t i = 0; i < loads_per_region; i++)
+                value += shared.get()->value;
+            return value / loads_per_region;
+        }
+    );
+
+    delete shared.exchange(nullptr);
+
+    auto per_read = [](std::chrono::nanoseconds duration)
+    { return static_cast<double>(duration.count()) / static_cast<double>(iterations); };
+    INFO("Benchmark: no reclamation: " << per_read(duration_none) << " ns/read");
+    INFO("Benchmark: epoch guard per read: " << per_read(duration_epoch) << " ns/read");
+    INFO("Benchmark: epoch guard per " << loads_per_region << " reads: " << per_read(duration_epoch_batched)
+                                       << " ns/read");
+    INFO("Benchmark: hazard pointer per read: " << per_read(duration_hazard) << " ns/read");
+    CHECK(live_objects.load() == 0);
+}
@@ -0,0 +1,225 @@
+/*
+ * test_fiber.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/sysconf.hpp>
+#include <concurrentfw/fiber.hpp>
+
+TEST_CASE("check of fibers", "[fiber]")
+{
+    ConcurrentFW::FiberScheduler scheduler(4, 32 * 1024);
+    CHECK_FALSE(ConcurrentFW::FiberScheduler::in_fiber());
+
+    // mutex with yields inside the critical section, fibers migrate between the workers
+    ConcurrentFW::FiberMutex mutex;
+    uint64_t counter = 0;
+    ConcurrentFW::Atomic<uint32_t> in_fiber {0};
+    for (uint32_t fiber = 0; fiber < 100; fiber++)
+        scheduler.spawn(
+            [&]()
+            {
+                if (ConcurrentFW::FiberScheduler::in_fiber())
+                    in_fiber.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                for (uint32_t i = 0; i < 500; i++)
+                {
+                    mutex.lock();
+                    uint64_t value = counter;
+                    if (i % 50 == 0)
+                        ConcurrentFW::FiberScheduler::yield();
+                    counter = value + 1;
+                    mutex.unlock();
+                }
+            }
+        );
+    scheduler.wait_idle();
+    CHECK(counter == 100 * 500);
+    CHECK(in_fiber.load() == 100);
+    CHECK(scheduler.live_fibers() == 0);
+    CHECK(scheduler.stacks().mapped_stacks() <= 100);
+
+    // bounded buffer with condition variables
+    std::deque<uint32_t> buffer;
+    ConcurrentFW::FiberConditionVariable not_full;
+    ConcurrentFW::FiberConditionVariable not_empty;
+    uint64_t consumed_sum = 0;
+    for (uint32_t producer = 0; producer < 4; producer++)
+        scheduler.spawn(
+            [&]()
+            {
+                for (uint32_t i = 1; i <= 1000; i++)
+                {
+                    mutex.lock();
+                    not_full.wait(mutex, [&]() { return buffer.size() < 8; });
+                    buffer.push_back(i);
+                    mutex.unlock();
+                    not_empty.notify_one();
+                }
+            }
+        );
+    for (uint32_t consumer = 0; consumer < 4; consumer++)
+        scheduler.spawn(
+            [&]()
+            {
+                for (uint32_t i = 0; i < 1000; i++)
+                {
+                    mutex.lock();
+                    not_empty.wait(mutex, [&]() { return !buffer.empty(); });
+                    consumed_sum += buffer.front();
+                    buffer.pop_front();
+                    mutex.unlock();
+                    not_full.notify_one();
+                }
+            }
+        );
+    scheduler.wait_idle();
+    CHECK(consumed_sum == 4 * 1000 * 1001 / 2);
+    CHECK(buffer.empty());
+
+    // semaphore released by an OS thread
+    ConcurrentFW::FiberSemaphore semaphore(2);
+    ConcurrentFW::Atomic<uint32_t> acquired {0};
+    for (uint32_t fiber = 0; fiber < 10; fiber++)
+        scheduler.spawn(
+            [&]()
+            {
+                semaphore.acquire();
+                acquired.add_fetch<ConcurrentFW::AtomicMemoryOrder::ACQ_REL>(1);
+            }
+        );
+    while (acquired.load() < 2)
+        std::this_thread::yield();
+    CHECK(acquired.load() == 2);
+    for (uint32_t permit = 0; permit < 8; permit++)
+        semaphore.release();
+    scheduler.wait_idle();
+    CHECK(acquired.load() == 10);
+    CHECK_FALSE(semaphore.try_acquire());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: context switch and memory per blocked fiber, against OS threads
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t resident_bytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0;
+    size_t resident = 0;
+    statm >> size >> resident;
+    return resident * ConcurrentFW::page_size();
+}
+
+TEST_CASE("check fibers against OS threads", "[fiber]")
+{
+    constexpr uint32_t switches {200000};
+    constexpr uint32_t blocked {10000};
+    constexpr uint32_t blocked_threads {500};
+
+    // ping-pong: two fibers yield to each other on one worker
+    ConcurrentFW::FiberScheduler scheduler(1);
+    auto start_fiber = std::chrono::steady_clock::now();
+    for (uint32_t fiber = 0; fiber < 2; fiber++)
+        scheduler.spawn(
+            []()
+            {
+                for (uint32_t i = 0; i < switches / 2; i++)
+                    ConcurrentFW::FiberScheduler::yield();
+            }
+        );
+    scheduler.wait_idle();
+    std::chrono::duration<double> fiber_time = std::chrono::steady_clock::now() - start_fiber;
+
+    // ping-pong: two threads hand over a token with a condition variable
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t turn = 0;
+    auto start_thread = std::chrono::steady_clock::now();
+    std::vector<std::thread> players;
+    for (uint32_t player = 0; player < 2; player++)
+        players.emplace_back(
+            [&, player]()
+            {
+                for (uint32_t i = 0; i < switches / 20; i++)
+                {
+                    std::unique_lock lock(mutex);
+                    changed.wait(lock, [&]() { return turn == player; });
+                    turn = 1 - player;
+                    changed.notify_one();
+                }
+            }
+        );
+    for (auto& player : players)
+        player.join();
+    std::chrono::duration<double> thread_time = std::chrono::steady_clock::now() - start_thread;
+
+    // memory of blocked fibers, stacks are reused from the ping-pong
+    ConcurrentFW::FiberSemaphore fiber_gate;
+    ConcurrentFW::Atomic<uint32_t> fibers_started {0};
+    size_t rss_before_fibers = resident_bytes();
+    for (uint32_t fiber = 0; fiber < blocked; fiber++)
+        scheduler.spawn(
+            [&]()
+            {
+                fibers_started.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                fiber_gate.acquire();
+            }
+        );
+    while (fibers_started.load() < blocked)
+        std::this_thread::yield();
+    size_t rss_fibers = resident_bytes() - rss_before_fibers;
+    for (uint32_t fiber = 0; fiber < blocked; fiber++)
+        fiber_gate.release();
+    scheduler.wait_idle();
+
+    // memory of blocked OS threads
+    bool open = false;
+    uint32_t threads_started = 0;
+    size_t rss_before_threads = resident_bytes();
+    std::vector<std::thread> sleepers;
+    for (uint32_t thread = 0; thread < blocked_threads; thread++)
+        sleepers.emplace_back(
+            [&]()
+            {
+                std::unique_lock lock(mutex);
+                threads_started++;
+                changed.notify_all();
+                changed.wait(lock, [&]() { return open; });
+            }
+        );
+    {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [&]() { return threads_started == blocked_threads; });
+    }
+    size_t rss_threads = resident_bytes() - rss_before_threads;
+    {
+        std::lock_guard lock(mutex);
+        open = true;
+    }
+    changed.notify_all();
+    for (auto& sleeper : sleepers)
+        sleeper.join();
+
+    INFO("Benchmark: fiber yield: " << fiber_time.count() * 1e9 / switches << " ns per yield");
+    INFO("Benchmark: thread handover: " << thread_time.count() * 1e9 / (switches / 10) << " ns per handover");
+    INFO("Benchmark: blocked fiber: " << static_cast<double>(rss_fibers) / blocked << " bytes resident");
+    INFO("Benchmark: blocked thread: " << static_cast<double>(rss_threads) / blocked_threads << " bytes resident");
+    CHECK(fibers_started.load() == blocked);
+    CHECK(threads_started == blocked_threads);
+    CHECK(scheduler.stacks().mapped_stacks() <= blocked + 2);
+}
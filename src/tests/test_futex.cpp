@@ -482,3 +482,37 @@ TEST_CASE("check multiple timeout Futex locks", "[futex]")
     CHECK(test_locked.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() == true);
     CHECK(test_timeout.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() == true);
 }
+
+TEST_CASE("check of event count", "[futex]")
+{
+    ConcurrentFW::EventCount event_count;
+    ConcurrentFW::Atomic<bool> condition {false};
+
+    ConcurrentFW::EventCount::Key key = event_count.prepare_wait();
+    event_count.notify_one();  // epoch changes, wait returns immediately
+    event_count.wait(key);
+
+    key = event_count.prepare_wait();
+    struct timespec timeout {0, 1000000};
+    CHECK(!event_count.wait_timeout(key, &timeout));
+
+    std::thread waiter(
+        [&]()
+        {
+            while (!condition.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>())
+            {
+                ConcurrentFW::EventCount::Key waiter_key = event_count.prepare_wait();
+                if (condition.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>())
+                {
+                    event_count.cancel_wait();
+                    break;
+                }
+                event_count.wait(waiter_key);
+            }
+        }
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    condition.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(true);
+    event_count.notify_all();
+    waiter.join();
+}
@@ -0,0 +1,162 @@
+/*
+ * test_hazard_pointer.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/concurrent_ptr.hpp>
+#include <concurrentfw/hazard_pointer.hpp>
+
+namespace
+{
+
+ConcurrentFW::Atomic<int64_t> live_objects {0};
+
+struct Payload
+{
+    static constexpr uint64_t ALIVE {0xA11CE5A11CE5A11C};
+
+    explicit Payload(uint64_t init)
+    : value(init)
+    {
+        live_objects.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    ~Payload()
+    {
+        magic = 0;
+        live_objects.sub_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    Payload(const Payload&) = delete;
+    Payload& operator=(const Payload&) = delete;
+
+    volatile uint64_t magic {ALIVE};
+    uint64_t value;
+};
+
+}  // namespace
+
+TEST_CASE("check of hazard pointers", "[hazard_pointer]")
+{
+    {
+        ConcurrentFW::HazardDomain domain;
+        ConcurrentFW::Concurrent_Ptr<Payload> shared(new Payload(1));
+
+        {
+            ConcurrentFW::HazardDomain::Guard guard(domain);
+            Payload* protected_payload = guard.protect(shared);
+            CHECK(protected_payload->value == 1);
+
+            domain.retire(shared.exchange(new Payload(2)));
+            CHECK(domain.unreclaimed() == 1);
+            CHECK(domain.reclaim() == 0);  // still protected
+            CHECK(protected_payload->magic == Payload::ALIVE);
+
+            guard.reset();
+            CHECK(domain.reclaim() == 1);
+            CHECK(domain.unreclaimed() == 0);
+        }
+
+        {
+            ConcurrentFW::HazardDomain::Guard guard1(domain);
+            ConcurrentFW::HazardDomain::Guard guard2(domain);
+            ConcurrentFW::HazardDomain::Guard guard3(domain);
+            ConcurrentFW::HazardDomain::Guard guard4(domain);
+            CHECK_THROWS_AS(ConcurrentFW::HazardDomain::Guard(domain), std::length_error);
+        }
+        ConcurrentFW::HazardDomain::Guard reused(domain);  // slots are free again
+
+        ConcurrentFW::Atomic<Payload*> atomic_ptr {shared.get()};
+        CHECK(reused.protect(atomic_ptr) == shared.get());
+        CHECK(reused.protect(shared.aba_ptr) == shared.get());
+
+        domain.retire(shared.exchange(nullptr));  // protected by 'reused', reclaimed by domain destructor
+        CHECK(domain.unreclaimed_bound() == ConcurrentFW::HazardDomain::MIN_RETIRE_THRESHOLD);
+    }
+    CHECK(live_objects.load() == 0);
+}
+
+TEST_CASE("check hazard pointer reclamation throughput", "[hazard_pointer]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    const uint32_t writers = std::max(1U, hw_threads / 2);
+    const uint32_t readers = std::max(1U, hw_threads - writers);
+    constexpr std::chrono::milliseconds runtime(250);
+
+    ConcurrentFW::Atomic<bool> stop {false};
+    ConcurrentFW::Atomic<uint64_t> retires {0};
+    ConcurrentFW::Atomic<uint64_t> reads {0};
+    ConcurrentFW::Atomic<uint64_t> invalid_reads {0};
+    ConcurrentFW::Atomic<uint64_t> bound_violations {0};
+    size_t bound = 0;
+
+    {
+        ConcurrentFW::HazardDomain domain;
+        ConcurrentFW::Concurrent_Ptr<Payload> shared(new Payload(0));
+
+        std::vector<std::thread> threads;
+        for (uint32_t writer = 0; writer < writers; writer++)
+            threads.emplace_back(
+                [&]()
+                {
+                    uint64_t local_retires = 0;
+                    while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                    {
+                        domain.retire(shared.exchange(new Payload(local_retires)));
+                        local_retires++;
+                        if (domain.unreclaimed() > domain.unreclaimed_bound())
+                            bound_violations.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                    }
+                    retires.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_retires);
+                }
+            );
+        for (uint32_t reader = 0; reader < readers; reader++)
+            threads.emplace_back(
+                [&]()
+                {
+                    uint64_t local_reads = 0;
+                    uint64_t local_invalid = 0;
+                    ConcurrentFW::HazardDomain::Guard guard(domain);
+                    while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                    {
+                        Payload* payload = guard.protect(shared);
+                        if (payload->magic != Payload::ALIVE)
+                            local_invalid++;
+                        local_reads++;
+                    }
+                    reads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_reads);
+                    invalid_reads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_invalid);
+                }
+            );
+
+        std::this_thread::sleep_for(runtime);
+        stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+        for (auto& thread : threads)
+            thread.join();
+
+        bound = domain.unreclaimed_bound();
+        domain.retire(shared.exchange(nullptr));
+    }
+
+    double seconds = std::chrono::duration<double>(runtime).count();
+    INFO("writers: " << writers << ", readers: " << readers << ", unreclaimed bound per thread: " << bound);
+    INFO("Benchmark: retire+reclaim: " << static_cast<double>(retires.load()) / seconds << " objects/s");
+    INFO("Benchmark: protected reads: " << static_cast<double>(reads.load()) / seconds << " reads/s");
+    CHECK(retires.load() > 0);
+    CHECK(invalid_reads.load() == 0);
+    CHECK(bound_violations.load() == 0);
+    CHECK(live_objects.load() == 0);  // everything reclaimed
+}
@@ -0,0 +1,211 @@
+/*
+ * test_mpmc_queue.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/mpmc_queue.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+TEST_CASE("check of mpmc queue", "[mpmc_queue]")
+{
+    CHECK_THROWS_AS(ConcurrentFW::MpmcQueue<int>(0), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::MpmcQueue<int>(1), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::MpmcQueue<int>(12), std::invalid_argument);
+
+    ConcurrentFW::MpmcQueue<int> queue(8);
+    CHECK(queue.capacity() == 8);
+
+    int item = 0;
+    CHECK(!queue.try_pop(item));
+    for (int i = 0; i < 8; i++)
+        CHECK(queue.try_push(i));
+    CHECK(!queue.try_push(8));  // full
+    CHECK(queue.size_approx() == 8);
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(queue.try_pop(item));
+        CHECK(item == i);
+    }
+    CHECK(!queue.try_pop(item));
+
+    // batches wrap around the ring
+    int input[6] = {10, 11, 12, 13, 14, 15};
+    int output[8] = {};
+    for (int round = 0; round < 5; round++)
+    {
+        CHECK(queue.try_push_n(input, 6) == 6);
+        CHECK(queue.try_push_n(input, 6) == 2);  // only partially
+        CHECK(queue.try_pop_n(output, 8) == 8);
+        CHECK(std::equal(input, input + 6, output));
+        CHECK(output[6] == 10);
+        CHECK(output[7] == 11);
+    }
+    CHECK(queue.try_pop_n(output, 8) == 0);
+
+    queue.push(42);
+    CHECK(queue.pop() == 42);
+    CHECK(queue.push_n(input, 6) == 6);
+    CHECK(queue.pop_n(output, 3) == 3);
+    CHECK(queue.pop_n(output, 8) == 3);
+    CHECK(output[2] == 15);
+
+    // remaining elements are destroyed with the queue
+    auto tracked = std::make_shared<int>(0);
+    {
+        ConcurrentFW::MpmcQueue<std::shared_ptr<int>> shared_queue(4);
+        CHECK(shared_queue.try_push(tracked));
+        CHECK(shared_queue.try_push(tracked));
+        CHECK(tracked.use_count() == 3);
+        std::shared_ptr<int> popped;
+        CHECK(shared_queue.try_pop(popped));
+        popped.reset();
+        CHECK(tracked.use_count() == 2);
+    }
+    CHECK(tracked.use_count() == 1);
+
+    // copies of types with a throwing copy constructor are made before a slot is claimed
+    ConcurrentFW::MpmcQueue<std::string> strings(4);
+    std::string words[3] = {"first", "second", "third"};
+    CHECK(strings.try_push_n(words, 3) == 3);
+    std::string word;
+    CHECK(strings.try_pop(word));
+    CHECK(word == "first");
+    CHECK(strings.try_push(std::string("fourth")));
+    CHECK(strings.try_push_n(words, 3) == 1);  // only partially
+    for (const char* expected : {"second", "third", "fourth", "first"})
+    {
+        CHECK(strings.try_pop(word));
+        CHECK(word == expected);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: throughput and latency with different producer/consumer ratios
+///////////////////////////////////////////////////////////////////////////////////////////
+
+struct QueueResult
+{
+    double messages_per_second;
+    uint64_t latency_median_ns;
+    uint64_t latency_99_ns;
+    bool complete;
+};
+
+static QueueResult run_queue(uint32_t producers, uint32_t consumers, size_t messages)
+{
+    constexpr size_t latency_sampling {16};  // every 16th message
+
+    ConcurrentFW::MpmcQueue<uint64_t> queue(1024);
+    const size_t per_producer = messages / producers;
+    const size_t total = per_producer * producers;
+    ConcurrentFW::Atomic<size_t> consumed {0};
+    ConcurrentFW::Atomic<uint64_t> checksum {0};
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+
+    auto now_ns = []()
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count()
+        );
+    };
+
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t consumer = 0; consumer < consumers; consumer++)
+        threads.emplace_back(
+            [&, consumer]()
+            {
+                uint64_t local_checksum = 0;
+                size_t local_consumed = 0;
+                uint64_t batch[32];
+                while (consumed.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() < total)
+                {
+                    const size_t popped = queue.try_pop_n(batch, 32);
+                    if (popped == 0)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    const uint64_t now = now_ns();
+                    for (size_t i = 0; i < popped; i++)
+                    {
+                        local_checksum += batch[i] & 0xFF;
+                        if ((local_consumed + i) % latency_sampling == 0)
+                            latencies[consumer].push_back(now - (batch[i] >> 8));
+                    }
+                    local_consumed += popped;
+                    consumed.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(popped);
+                }
+                checksum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_checksum);
+            }
+        );
+    for (uint32_t producer = 0; producer < producers; producer++)
+        threads.emplace_back(
+            [&]()
+            {
+                for (size_t i = 0; i < per_producer; i++)
+                    queue.push((now_ns() << 8) | (i & 0xFF));  // timestamp and payload
+            }
+        );
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    uint64_t expected_checksum = 0;
+    for (size_t i = 0; i < per_producer; i++)
+        expected_checksum += i & 0xFF;
+    expected_checksum *= producers;
+
+    std::vector<uint64_t> all_latencies;
+    for (auto& consumer_latencies : latencies)
+        all_latencies.insert(all_latencies.end(), consumer_latencies.begin(), consumer_latencies.end());
+    std::sort(all_latencies.begin(), all_latencies.end());
+    auto percentile = [&all_latencies](size_t percent)
+    { return all_latencies.empty() ? 0 : all_latencies[(all_latencies.size() - 1) * percent / 100]; };
+
+    return {
+        static_cast<double>(total) / duration.count(),
+        percentile(50),
+        percentile(99),
+        consumed.load() == total && checksum.load() == expected_checksum};
+}
+
+TEST_CASE("check mpmc queue throughput and latency", "[mpmc_queue]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    const uint32_t n = std::max(2U, hw_threads / 2);
+    constexpr size_t messages {1000000};
+
+    struct Ratio
+    {
+        uint32_t producers;
+        uint32_t consumers;
+    };
+    const Ratio ratios[] = {{1, 1}, {1, n}, {n, 1}, {n, n}};
+
+    for (const Ratio& ratio : ratios)
+    {
+        QueueResult result = run_queue(ratio.producers, ratio.consumers, messages);
+        INFO("Benchmark: " << ratio.producers << ":" << ratio.consumers << " " << result.messages_per_second
+                           << " msgs/s, latency median " << result.latency_median_ns << " ns, 99% "
+                           << result.latency_99_ns << " ns");
+        CHECK(result.complete);
+    }
+}
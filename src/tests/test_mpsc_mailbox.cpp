@@ -0,0 +1,186 @@
+/*
+ * test_mpsc_mailbox.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/stack.hpp>
+#include <concurrentfw/mpsc_mailbox.hpp>
+
+struct Message : ConcurrentFW::MailboxLink
+{
+    uint64_t value {0};
+};
+
+TEST_CASE("check of mpsc mailbox", "[mpsc_mailbox]")
+{
+    ConcurrentFW::MpscMailbox<Message> mailbox;
+    CHECK(mailbox.empty());
+    CHECK(mailbox.pop() == nullptr);
+
+    std::vector<Message> messages(10);
+    for (uint64_t round = 0; round < 3; round++)  // messages are reused, also the stub
+    {
+        for (uint64_t i = 0; i < messages.size(); i++)
+        {
+            messages[i].value = i;
+            mailbox.push(&messages[i]);
+        }
+        CHECK(!mailbox.empty());
+        Message* first = mailbox.pop();
+        REQUIRE(first != nullptr);
+        CHECK(first->value == 0);
+
+        uint64_t expected = 1;
+        bool ordered = true;
+        CHECK(mailbox.drain([&](Message* message) { ordered &= message->value == expected++; }) == 9);
+        CHECK(ordered);
+        CHECK(mailbox.empty());
+        CHECK(mailbox.pop() == nullptr);
+    }
+
+    // owner parks until a message arrives
+    Message late;
+    late.value = 42;
+    std::thread producer(
+        [&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            mailbox.push(&late);
+        }
+    );
+    CHECK(mailbox.pop_wait()->value == 42);
+    producer.join();
+
+    size_t received = 0;
+    std::thread batch_producer(
+        [&]()
+        {
+            for (Message& message : messages)
+                mailbox.push(&message);
+        }
+    );
+    while (received < messages.size())
+        received += mailbox.drain_wait([](Message*) {});
+    batch_producer.join();
+    CHECK(received == messages.size());
+    CHECK(mailbox.empty());
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: mailbox against Stack push with reversal by the owner
+///////////////////////////////////////////////////////////////////////////////////////////
+
+struct StackMessage
+{
+    void* link;  // used by Stack
+    uint64_t value;
+};
+
+static constexpr size_t mailbox_per_producer {1000000};
+
+template<typename MESSAGE, typename PUSH, typename DRAIN>
+static std::chrono::nanoseconds run_mailbox(
+    uint32_t producers, PUSH&& push, DRAIN&& drain, bool& complete, bool& ordered
+)
+{
+    std::vector<std::vector<MESSAGE>> messages(producers, std::vector<MESSAGE>(mailbox_per_producer));
+    for (uint32_t producer = 0; producer < producers; producer++)
+        for (size_t i = 0; i < mailbox_per_producer; i++)
+            messages[producer][i].value = (static_cast<uint64_t>(producer) << 32) | (i + 1);
+
+    const size_t total = mailbox_per_producer * producers;
+    std::vector<uint64_t> last(producers, 0);
+    uint64_t checksum = 0;
+    ordered = true;
+    auto consume = [&](const MESSAGE* message)
+    {
+        const uint64_t producer = message->value >> 32;
+        const uint64_t sequence = message->value & 0xFFFFFFFF;
+        ordered &= sequence > last[producer];
+        last[producer] = sequence;
+        checksum += sequence;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t producer = 0; producer < producers; producer++)
+        threads.emplace_back(
+            [&, producer]()
+            {
+                for (MESSAGE& message : messages[producer])
+                    push(&message);
+            }
+        );
+    size_t received = 0;
+    while (received < total)
+    {
+        const size_t drained = drain(consume);
+        if (drained == 0)
+            std::this_thread::yield();
+        received += drained;
+    }
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+
+    complete = checksum == producers * mailbox_per_producer * (mailbox_per_producer + 1) / 2;
+    return duration;
+}
+
+TEST_CASE("check mpsc mailbox against stack with reversal", "[mpsc_mailbox]")
+{
+    const uint32_t producers = std::max(2U, std::thread::hardware_concurrency() - 1);
+
+    ConcurrentFW::MpscMailbox<Message> mailbox;
+    bool complete_mailbox = false;
+    bool ordered_mailbox = false;
+    std::chrono::nanoseconds duration_mailbox = run_mailbox<Message>(
+        producers,
+        [&](Message* message) { mailbox.push(message); },
+        [&](auto&& consume) { return mailbox.drain(consume); },
+        complete_mailbox,
+        ordered_mailbox
+    );
+
+    ConcurrentFW::Stack stack;
+    std::vector<StackMessage*> reversed;
+    bool complete_stack = false;
+    bool ordered_stack = false;  // popping is no atomic snapshot, the reversal only approximates FIFO
+    std::chrono::nanoseconds duration_stack = run_mailbox<StackMessage>(
+        producers,
+        [&](StackMessage* message) { stack.push(message); },
+        [&](auto&& consume)
+        {
+            reversed.clear();
+            void* block;
+            while ((block = stack.pop()) != nullptr)
+                reversed.push_back(static_cast<StackMessage*>(block));
+            std::for_each(reversed.rbegin(), reversed.rend(), consume);
+            return reversed.size();
+        },
+        complete_stack,
+        ordered_stack
+    );
+
+    const double messages = static_cast<double>(producers * mailbox_per_producer);
+    auto per_second = [messages](std::chrono::nanoseconds duration)
+    { return messages / std::chrono::duration<double>(duration).count(); };
+    INFO("producers: " << producers);
+    INFO("Benchmark: MpscMailbox: " << per_second(duration_mailbox) << " msgs/s");
+    INFO("Benchmark: Stack + reverse: " << per_second(duration_stack) << " msgs/s");
+    CHECK(complete_mailbox);
+    CHECK(ordered_mailbox);
+    CHECK(complete_stack);
+}
@@ -0,0 +1,179 @@
+/*
+ * test_ms_queue.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/ms_queue.hpp>
+
+TEST_CASE("check of Michael-Scott queue", "[ms_queue]")
+{
+    ConcurrentFW::MsQueue<uint64_t> queue(4);
+    uint64_t value = 0;
+    CHECK(queue.empty());
+    CHECK(!queue.dequeue(value));
+
+    for (uint64_t round = 0; round < 3; round++)  // nodes are recycled
+    {
+        for (uint64_t i = 0; i < 1000; i++)
+            queue.enqueue(i);
+        CHECK(!queue.empty());
+        for (uint64_t i = 0; i < 1000; i++)
+        {
+            CHECK(queue.dequeue(value));
+            CHECK(value == i);
+        }
+        CHECK(!queue.dequeue(value));
+    }
+
+    queue.enqueue(42);  // remaining nodes are freed by destructor
+
+    // a queue, which is never empty, never reports empty, although its nodes are recycled all the time
+    const uint32_t threads_count = std::max(4U, std::thread::hardware_concurrency());
+    ConcurrentFW::MsQueue<uint64_t> filled;
+    for (uint64_t i = 0; i < 2 * threads_count; i++)
+        filled.enqueue(i);
+    ConcurrentFW::Atomic<uint64_t> failed {0};
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < threads_count; thread++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local_failed = 0;
+                for (uint32_t i = 0; i < 200000; i++)
+                {
+                    uint64_t item;
+                    if (filled.dequeue(item))  // each thread holds at most one item
+                        filled.enqueue(item);
+                    else
+                        local_failed++;
+                }
+                failed.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_failed);
+            }
+        );
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(failed.load() == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: MsQueue against Futex protected std::deque
+///////////////////////////////////////////////////////////////////////////////////////////
+
+class FutexDeque
+{
+public:
+    void enqueue(uint64_t value)
+    {
+        futex.lock();
+        deque.push_back(value);
+        futex.unlock();
+    }
+
+    bool dequeue(uint64_t& value)
+    {
+        futex.lock();
+        bool available = !deque.empty();
+        if (available)
+        {
+            value = deque.front();
+            deque.pop_front();
+        }
+        futex.unlock();
+        return available;
+    }
+
+private:
+    ConcurrentFW::Futex futex {false};
+    std::deque<uint64_t> deque;
+};
+
+template<typename QUEUE>
+static std::chrono::nanoseconds run_fifo(QUEUE& queue, uint32_t threads_per_side, size_t per_producer, bool& valid)
+{
+    const size_t total = per_producer * threads_per_side;
+    ConcurrentFW::Atomic<size_t> consumed {0};
+    ConcurrentFW::Atomic<uint64_t> checksum {0};
+    ConcurrentFW::Atomic<uint64_t> order_violations {0};
+
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t consumer = 0; consumer < threads_per_side; consumer++)
+        threads.emplace_back(
+            [&]()
+            {
+                std::vector<uint64_t> last(threads_per_side, 0);  // FIFO order per producer
+                uint64_t local_checksum = 0;
+                uint64_t local_violations = 0;
+                uint64_t value;
+                while (consumed.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() < total)
+                {
+                    if (!queue.dequeue(value))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    const uint64_t producer = value >> 32;
+                    const uint64_t sequence = value & 0xFFFFFFFF;
+                    if (sequence < last[producer])
+                        local_violations++;
+                    last[producer] = sequence;
+                    local_checksum += sequence;
+                    consumed.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                }
+                checksum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_checksum);
+                order_violations.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_violations);
+            }
+        );
+    for (uint32_t producer = 0; producer < threads_per_side; producer++)
+        threads.emplace_back(
+            [&, producer]()
+            {
+                for (uint64_t i = 1; i <= per_producer; i++)
+                    queue.enqueue((static_cast<uint64_t>(producer) << 32) | i);
+            }
+        );
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+
+    valid = checksum.load() == threads_per_side * per_producer * (per_producer + 1) / 2
+            && order_violations.load() == 0;
+    return duration;
+}
+
+TEST_CASE("check Michael-Scott queue against futex protected deque", "[ms_queue]")
+{
+    const uint32_t threads_per_side = std::max(2U, std::thread::hardware_concurrency() / 2);
+    constexpr size_t per_producer {500000};
+
+    bool valid_ms_queue = false;
+    ConcurrentFW::MsQueue<uint64_t> ms_queue;
+    std::chrono::nanoseconds duration_ms_queue = run_fifo(ms_queue, threads_per_side, per_producer, valid_ms_queue);
+
+    bool valid_deque = false;
+    FutexDeque futex_deque;
+    std::chrono::nanoseconds duration_deque = run_fifo(futex_deque, threads_per_side, per_producer, valid_deque);
+
+    const double messages = static_cast<double>(threads_per_side * per_producer);
+    auto per_second = [messages](std::chrono::nanoseconds duration)
+    { return messages / std::chrono::duration<double>(duration).count(); };
+    INFO("producers: " << threads_per_side << ", consumers: " << threads_per_side);
+    INFO("Benchmark: MsQueue: " << per_second(duration_ms_queue) << " msgs/s");
+    INFO("Benchmark: Futex + std::deque: " << per_second(duration_deque) << " msgs/s");
+    CHECK(valid_ms_queue);
+    CHECK(valid_deque);
+}
@@ -0,0 +1,166 @@
+/*
+ * test_numa_pool.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/numa_pool.hpp>
+
+TEST_CASE("check of NUMA pool", "[numa_pool]")
+{
+    constexpr size_t blocks_per_node {16};
+    ConcurrentFW::NumaPool pool(40, blocks_per_node);
+
+    CHECK(pool.nodes() == ConcurrentFW::numa_nodes());
+    CHECK(ConcurrentFW::numa_current_node() < pool.nodes());
+    CHECK(pool.block_size() == 48);  // rounded up to alignment
+    CHECK_THROWS_AS(ConcurrentFW::NumaPool(64, 0), std::invalid_argument);
+    CHECK_THROWS_AS(pool.allocate_on(pool.nodes()), std::out_of_range);
+
+    for (size_t node = 0; node < pool.nodes(); node++)
+    {
+        std::vector<void*> blocks;
+        void* block;
+        while ((block = pool.allocate_on(node)) != nullptr)
+        {
+            CHECK(pool.home_node(block) == node);
+            CHECK(reinterpret_cast<uintptr_t>(block) % ConcurrentFW::NumaPool::BLOCK_ALIGNMENT == 0);
+            std::memset(block, 0xA5, pool.block_size());
+            blocks.push_back(block);
+        }
+        CHECK(blocks.size() == blocks_per_node);
+
+        pool.deallocate(blocks.back());
+        CHECK(pool.allocate_on(node) == blocks.back());  // returned to home node
+
+        for (void* returned : blocks)
+            pool.deallocate(returned);
+    }
+
+    int foreign;
+    CHECK_FALSE(pool.owns(&foreign));
+    CHECK_THROWS_AS(pool.deallocate(&foreign), std::invalid_argument);
+}
+
+TEST_CASE("check of concurrent NUMA pool", "[numa_pool]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    constexpr size_t blocks_per_thread {64};
+    constexpr std::chrono::milliseconds runtime(250);
+
+    ConcurrentFW::NumaPool pool(64, hw_threads * blocks_per_thread);
+    ConcurrentFW::Atomic<bool> stop {false};
+    ConcurrentFW::Atomic<uint64_t> corrupted {0};
+    ConcurrentFW::Atomic<uint64_t> operations {0};
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < hw_threads; thread++)
+        threads.emplace_back(
+            [&, thread]()
+            {
+                uint64_t local_operations = 0;
+                std::vector<uint64_t*> blocks;
+                while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                {
+                    for (size_t i = 0; i < blocks_per_thread; i++)
+                    {
+                        auto* block = static_cast<uint64_t*>(pool.allocate());
+                        if (block == nullptr)
+                            break;
+                        block[1] = thread;
+                        blocks.push_back(block);
+                    }
+                    for (uint64_t* block : blocks)
+                    {
+                        if (block[1] != thread)
+                            corrupted.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                        pool.deallocate(block);
+                    }
+                    local_operations += blocks.size();
+                    blocks.clear();
+                }
+                operations.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_operations);
+            }
+        );
+
+    std::this_thread::sleep_for(runtime);
+    stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    size_t available = 0;
+    for (size_t node = 0; node < pool.nodes(); node++)
+        while (pool.allocate_on(node) != nullptr)
+            available++;
+
+    INFO("allocate/deallocate pairs: " << operations.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>());
+    CHECK(corrupted.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() == 0);
+    CHECK(available == pool.nodes() * pool.blocks_per_node());  // no block lost
+}
+
+// touches all pooled blocks of one node repeatedly from the calling thread
+static double access_throughput(ConcurrentFW::NumaPool& pool, size_t node, std::chrono::milliseconds runtime)
+{
+    std::vector<uint64_t*> blocks;
+    void* block;
+    while ((block = pool.allocate_on(node)) != nullptr)
+        blocks.push_back(static_cast<uint64_t*>(block));
+
+    const size_t words = pool.block_size() / sizeof(uint64_t);
+    uint64_t bytes = 0;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed {};
+    do
+    {
+        for (uint64_t* words_ptr : blocks)
+        {
+            for (size_t word = 0; word < words; word++)
+            {
+                words_ptr[word] += word;
+                checksum += words_ptr[word];
+            }
+        }
+        bytes += blocks.size() * pool.block_size();
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    while (elapsed < runtime);
+
+    for (uint64_t* returned : blocks)
+        pool.deallocate(returned);
+
+    if (checksum == 0)  // prevents optimizing away the access loop
+        throw std::logic_error("checksum must not be zero");
+    return static_cast<double>(bytes) / elapsed.count() / (1024.0 * 1024.0);
+}
+
+TEST_CASE("check NUMA pool local vs. remote access", "[numa_pool]")
+{
+    constexpr std::chrono::milliseconds runtime(200);
+    ConcurrentFW::NumaPool pool(256, 16384);  // 4 MiB per node, beyond most L2 caches
+
+    const size_t local_node = ConcurrentFW::numa_current_node();
+    const size_t remote_node = (local_node + 1) % pool.nodes();  // equals local node on single node systems
+
+    double local = access_throughput(pool, local_node, runtime);
+    double remote = access_throughput(pool, remote_node, runtime);
+
+    INFO("NUMA nodes: " << pool.nodes() << ", local node: " << local_node << ", remote node: " << remote_node);
+    INFO("Benchmark: local access " << local << " MiB/s, remote access " << remote << " MiB/s");
+    INFO("Factor: " << local / remote);
+    CHECK(local > 0.0);
+    CHECK(remote > 0.0);
+}
@@ -0,0 +1,228 @@
+/*
+ * test_parallel_algorithms.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+
+#ifdef CONCURRENTFW_TEST_TBB  // libstdc++ parallel algorithms need the TBB backend
+#include <execution>
+#endif
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/parallel_algorithms.hpp>
+
+TEST_CASE("check of parallel algorithms", "[parallel_algorithms]")
+{
+    ConcurrentFW::ThreadPool pool(3);
+
+    // every index exactly once, also with explicit grain and nested in a task
+    std::vector<uint32_t> visits(100000, 0);
+    ConcurrentFW::parallel_for(
+        pool,
+        0,
+        visits.size(),
+        [&](size_t first, size_t last)
+        {
+            for (size_t index = first; index < last; index++)
+                visits[index]++;
+        }
+    );
+    ConcurrentFW::parallel_for(
+        pool,
+        10,
+        visits.size(),
+        [&](size_t first, size_t last)
+        {
+            for (size_t index = first; index < last; index++)
+                visits[index]++;
+        },
+        7
+    );
+    CHECK(std::all_of(visits.begin(), visits.begin() + 10, [](uint32_t visit) { return visit == 1; }));
+    CHECK(std::all_of(visits.begin() + 10, visits.end(), [](uint32_t visit) { return visit == 2; }));
+    ConcurrentFW::parallel_for(pool, 5, 5, [](size_t, size_t) { FAIL("empty range"); });
+
+    ConcurrentFW::Atomic<uint64_t> nested {0};
+    pool.submit(
+        [&]()
+        {
+            ConcurrentFW::parallel_for(
+                pool,
+                0,
+                10000,
+                [&](size_t first, size_t last)
+                { nested.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(last - first); }
+            );
+        }
+    );
+    pool.wait_idle();
+    CHECK(nested.load() == 10000);
+
+    // reduction with a non-commutative operation keeps the order
+    std::string letters = ConcurrentFW::parallel_reduce(
+        pool,
+        0,
+        26000,
+        std::string(),
+        [](size_t first, size_t last, std::string init)
+        {
+            for (size_t index = first; index < last; index += 1000)
+                init += static_cast<char>('a' + index / 1000);
+            return init;
+        },
+        [](const std::string& left, const std::string& right) { return left + right; },
+        1000
+    );
+    CHECK(letters == "abcdefghijklmnopqrstuvwxyz");
+
+    std::vector<uint64_t> values(123457);
+    std::iota(values.begin(), values.end(), 1);
+    std::vector<uint64_t> scanned(values.size());
+    CHECK(
+        ConcurrentFW::parallel_inclusive_scan(pool, values.begin(), values.end(), scanned.begin()) == scanned.end()
+    );
+    std::vector<uint64_t> expected(values.size());
+    std::inclusive_scan(values.begin(), values.end(), expected.begin());
+    CHECK(scanned == expected);
+    ConcurrentFW::parallel_inclusive_scan(pool, values.begin(), values.end(), values.begin());  // in place
+    CHECK(values == expected);
+
+    std::mt19937_64 random(42);
+    std::vector<uint32_t> unsorted(300000);
+    for (uint32_t& value : unsorted)
+        value = static_cast<uint32_t>(random() % 1000);  // many equal keys
+    std::vector<uint32_t> sorted = unsorted;
+    ConcurrentFW::parallel_sort(pool, sorted.begin(), sorted.end());
+    CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+    ConcurrentFW::parallel_sort(pool, unsorted.begin(), unsorted.end(), std::greater<>());
+    CHECK(std::is_sorted(unsorted.begin(), unsorted.end(), std::greater<>()));
+    std::reverse(unsorted.begin(), unsorted.end());
+    CHECK(unsorted == sorted);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: against serial code and std::execution::par
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static constexpr size_t parallel_elements {10000000};  // 10M, larger inputs up to 1B need ~8 GB per array
+
+template<typename FUNC>
+static double milliseconds(FUNC&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST_CASE("check parallel algorithms against serial and std::execution::par", "[parallel_algorithms]")
+{
+    ConcurrentFW::ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));  // caller participates
+    std::mt19937_64 random(7);
+    std::vector<uint64_t> input(parallel_elements);
+    for (uint64_t& value : input)
+        value = random() >> 16;
+    std::vector<uint64_t> work = input;
+    std::vector<uint64_t> serial_result(parallel_elements);
+    std::vector<uint64_t> parallel_result(parallel_elements);
+
+    // for
+    auto transform = [](uint64_t value) { return value * 3 + 1; };
+    const double for_serial = milliseconds([&]() { std::transform(input.begin(), input.end(), work.begin(), transform); });
+    const double for_pool = milliseconds(
+        [&]()
+        {
+            ConcurrentFW::parallel_for(
+                pool,
+                0,
+                input.size(),
+                [&](size_t first, size_t last)
+                {
+                    for (size_t index = first; index < last; index++)
+                        parallel_result[index] = transform(input[index]);
+                }
+            );
+        }
+    );
+    const bool for_valid = parallel_result == work;
+
+    // reduce
+    uint64_t sum_serial = 0;
+    uint64_t sum_pool = 0;
+    const double reduce_serial = milliseconds([&]() { sum_serial = std::accumulate(input.begin(), input.end(), 0ULL); });
+    const double reduce_pool = milliseconds(
+        [&]()
+        {
+            sum_pool = ConcurrentFW::parallel_reduce(
+                pool,
+                0,
+                input.size(),
+                uint64_t {0},
+                [&](size_t first, size_t last, uint64_t init)
+                { return std::accumulate(input.begin() + first, input.begin() + last, init); },
+                std::plus<>()
+            );
+        }
+    );
+
+    // scan
+    const double scan_serial
+        = milliseconds([&]() { std::inclusive_scan(input.begin(), input.end(), serial_result.begin()); });
+    const double scan_pool = milliseconds(
+        [&]() { ConcurrentFW::parallel_inclusive_scan(pool, input.begin(), input.end(), parallel_result.begin()); }
+    );
+    const bool scan_valid = parallel_result == serial_result;
+
+    // sort
+    serial_result = input;
+    parallel_result = input;
+    const double sort_serial = milliseconds([&]() { std::sort(serial_result.begin(), serial_result.end()); });
+    const double sort_pool
+        = milliseconds([&]() { ConcurrentFW::parallel_sort(pool, parallel_result.begin(), parallel_result.end()); });
+    const bool sort_valid = parallel_result == serial_result;
+
+#ifdef CONCURRENTFW_TEST_TBB
+    const double for_par = milliseconds(
+        [&]() { std::transform(std::execution::par, input.begin(), input.end(), work.begin(), transform); }
+    );
+    uint64_t sum_par = 0;
+    const double reduce_par
+        = milliseconds([&]() { sum_par = std::reduce(std::execution::par, input.begin(), input.end(), 0ULL); });
+    const double scan_par = milliseconds(
+        [&]() { std::inclusive_scan(std::execution::par, input.begin(), input.end(), parallel_result.begin()); }
+    );
+    const bool scan_par_valid = parallel_result.back() == sum_serial;
+    work = input;
+    const double sort_par = milliseconds([&]() { std::sort(std::execution::par, work.begin(), work.end()); });
+    const bool sort_par_valid = work == serial_result;  // no CHECK of vectors, expansion of 10M elements
+    INFO("Benchmark: std::execution::par: for " << for_par << " ms, reduce " << reduce_par << " ms, scan "
+                                               << scan_par << " ms, sort " << sort_par << " ms");
+    CHECK(sum_par == sum_serial);
+    CHECK(scan_par_valid);
+    CHECK(sort_par_valid);
+#endif
+
+    INFO("elements: " << parallel_elements << ", threads: " << pool.size() + 1);
+    INFO("Benchmark: for:    serial " << for_serial << " ms, pool " << for_pool << " ms");
+    INFO("Benchmark: reduce: serial " << reduce_serial << " ms, pool " << reduce_pool << " ms");
+    INFO("Benchmark: scan:   serial " << scan_serial << " ms, pool " << scan_pool << " ms");
+    INFO("Benchmark: sort:   serial " << sort_serial << " ms, pool " << sort_pool << " ms");
+    CHECK(for_valid);
+    CHECK(sum_pool == sum_serial);
+    CHECK(scan_valid);
+    CHECK(sort_valid);
+}
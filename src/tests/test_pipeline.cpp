@@ -0,0 +1,346 @@
+/*
+ * test_pipeline.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <pthread.h>  // pthread_setaffinity_np()
+#include <sched.h>    // cpu_set_t
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <condition_variable>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/pipeline.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+TEST_CASE("check of pipeline", "[pipeline]")
+{
+    CHECK_THROWS_AS(ConcurrentFW::Pipeline(0), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::Pipeline(ConcurrentFW::Pipeline::RING_CAPACITY + 1), std::invalid_argument);
+
+    {
+        ConcurrentFW::Pipeline incomplete;
+        auto builder = incomplete.source<int>("source", [](int&) { return false; });
+        CHECK_THROWS_AS(incomplete.start(), std::logic_error);
+        CHECK_THROWS_AS(std::move(builder).stage("none", [](int&& item) { return item; }, 0), std::invalid_argument);
+        CHECK_THROWS_AS(incomplete.source<int>("second", [](int&) { return false; }), std::logic_error);
+    }
+
+    // order is kept through parallel stages with different numbers of workers (reassembly in between)
+    constexpr uint64_t items {100000};
+    for (size_t batch_size : {size_t(1), size_t(7), ConcurrentFW::Pipeline::DEFAULT_BATCH_SIZE})
+    {
+        ConcurrentFW::Pipeline pipeline(batch_size, true);
+        uint64_t next = 0;
+        uint64_t expected = 0;
+        bool ordered = true;
+        pipeline.source<uint64_t>("count", [&](uint64_t& item) { item = next; return next++ < items; })
+            .stage("box", [](uint64_t&& item) { return std::make_unique<uint64_t>(item); }, 3)
+            .stage("square", [](std::unique_ptr<uint64_t>&& item) { return *item * *item; }, 2)
+            .stage("add", [](uint64_t&& item) { return item + 1; })
+            .sink(
+                "check",
+                [&](uint64_t&& item)
+                {
+                    ordered &= item == expected * expected + 1;
+                    expected++;
+                }
+            );
+        pipeline.start();
+        CHECK_THROWS_AS(pipeline.start(), std::logic_error);
+        pipeline.wait();
+
+        CHECK(ordered);
+        CHECK(expected == items);
+        const auto stats = pipeline.stats();
+        REQUIRE(stats.size() == 6);
+        CHECK(stats[2].name == "reassembly");
+        CHECK(stats[1].workers == 3);
+        CHECK(stats[3].workers == 2);
+        bool all_items = true;
+        for (const auto& stage : stats)
+            all_items &= stage.items == items;
+        CHECK(all_items);
+        CHECK(stats[5].max_occupancy <= 2 * ConcurrentFW::Pipeline::RING_CAPACITY);
+    }
+
+    // a slow sink throttles the source
+    ConcurrentFW::Pipeline throttled;
+    uint32_t produced = 0;
+    ConcurrentFW::Atomic<uint32_t> consumed {0};
+    throttled.source<uint32_t>("source", [&](uint32_t& item) { item = produced; return produced++ < 20000; })
+        .sink(
+            "slow",
+            [&](uint32_t&&)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(consumed.load() % 256 == 0 ? 1000 : 0));
+                consumed.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+            }
+        );
+    throttled.start();
+    throttled.wait();
+    const auto throttled_stats = throttled.stats();
+    CHECK(consumed.load() == 20000);
+    CHECK(throttled_stats[0].output_waits > 0);
+    CHECK(throttled_stats[1].max_occupancy <= ConcurrentFW::Pipeline::RING_CAPACITY);
+    CHECK(throttled_stats[1].busy_ns > 0);
+
+    // pinned stages only use the allowed CPUs of the starting thread (e.g. restricted by a cpuset)
+    uint32_t pinned_items = 0;
+    bool started = false;
+    std::thread restricted(
+        [&]()
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(ConcurrentFW::allowed_cpus().back(), &cpus);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+                return;
+            ConcurrentFW::Pipeline pinned(ConcurrentFW::Pipeline::DEFAULT_BATCH_SIZE, true);
+            uint32_t next = 0;
+            pinned.source<uint32_t>("source", [&](uint32_t& item) { item = next; return next++ < 1000; })
+                .stage("add", [](uint32_t&& item) { return item + 1; }, 2)
+                .sink("count", [&](uint32_t&&) { pinned_items++; });
+            try
+            {
+                pinned.start();
+                started = true;
+            }
+            catch (const std::system_error&)  // pinned to a CPU outside of the affinity mask
+            {}
+        }
+    );
+    restricted.join();
+    CHECK(started);
+    CHECK(pinned_items == 1000);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: parse -> enrich -> serialise -> write, against threads wired with mutex queues
+///////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+struct Record
+{
+    uint64_t id {0};
+    uint64_t created_ns {0};
+    uint64_t fields[4] {};
+};
+
+struct Serialised
+{
+    uint64_t id {0};
+    uint64_t created_ns {0};
+    uint32_t length {0};
+    char text[120] {};
+};
+
+uint64_t now_ns()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+Record parse(uint64_t id)
+{
+    Record record {id, now_ns(), {}};
+    uint64_t random = 0x9E3779B97F4A7C15ULL * (id + 1);
+    for (uint64_t& field : record.fields)
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        field = random;
+    }
+    return record;
+}
+
+Record enrich(Record&& record)
+{
+    for (uint32_t round = 0; round < 16; round++)
+        for (uint64_t& field : record.fields)
+            field = (field ^ (field >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    return record;
+}
+
+Serialised serialise(Record&& record)
+{
+    Serialised serialised {record.id, record.created_ns, 0, {}};
+    const int length = std::snprintf(
+        serialised.text,
+        sizeof(serialised.text),
+        "%llu;%llx;%llx;%llx;%llx",
+        static_cast<unsigned long long>(record.id),
+        static_cast<unsigned long long>(record.fields[0]),
+        static_cast<unsigned long long>(record.fields[1]),
+        static_cast<unsigned long long>(record.fields[2]),
+        static_cast<unsigned long long>(record.fields[3])
+    );
+    serialised.length = static_cast<uint32_t>(std::max(length, 0));
+    return serialised;
+}
+
+class Writer
+{
+public:
+    void write(const Serialised& serialised)
+    {
+        for (uint32_t index = 0; index < serialised.length; index++)
+            checksum = checksum * 31 + static_cast<unsigned char>(serialised.text[index]);
+        ordered &= serialised.id == written;
+        written++;
+        latency_sum += now_ns() - serialised.created_ns;
+    }
+
+    uint64_t checksum {0};
+    uint64_t written {0};
+    uint64_t latency_sum {0};
+    bool ordered {true};
+};
+
+template<typename T>
+class BlockingQueue  // bounded, as hand-wired pipelines use them
+{
+public:
+    void push(T&& item)
+    {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [this]() { return items.size() < ConcurrentFW::Pipeline::RING_CAPACITY; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    bool pop(T& item)  // false: closed and empty
+    {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [this]() { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    bool closed {false};
+};
+
+}  // namespace
+
+TEST_CASE("check pipeline against mutex queues", "[pipeline]")
+{
+    constexpr uint64_t records {1000000};
+    constexpr uint32_t serialisers {4};
+
+    Writer pipeline_writer;
+    auto pipeline_start = std::chrono::steady_clock::now();
+    std::vector<ConcurrentFW::PipelineStageStats> stats;
+    {
+        ConcurrentFW::Pipeline pipeline;
+        uint64_t id = 0;
+        pipeline.source<Record>("parse", [&](Record& record) { record = parse(id); return id++ < records; })
+            .stage("enrich", enrich)
+            .stage("serialise", serialise, serialisers)
+            .sink("write", [&](Serialised&& serialised) { pipeline_writer.write(serialised); });
+        pipeline.start();
+        pipeline.wait();
+        stats = pipeline.stats();
+    }
+    std::chrono::duration<double> pipeline_time = std::chrono::steady_clock::now() - pipeline_start;
+
+    Writer queue_writer;
+    auto queue_start = std::chrono::steady_clock::now();
+    {
+        BlockingQueue<Record> parsed;
+        BlockingQueue<Record> enriched;
+        BlockingQueue<Serialised> serialised;
+        std::thread parser(
+            [&]()
+            {
+                for (uint64_t id = 0; id < records; id++)
+                    parsed.push(parse(id));
+                parsed.close();
+            }
+        );
+        std::thread enricher(
+            [&]()
+            {
+                Record record;
+                while (parsed.pop(record))
+                    enriched.push(enrich(std::move(record)));
+                enriched.close();
+            }
+        );
+        std::thread serialiser(
+            [&]()
+            {
+                Record record;
+                while (enriched.pop(record))
+                    serialised.push(serialise(std::move(record)));
+                serialised.close();
+            }
+        );
+        std::thread writer(
+            [&]()
+            {
+                Serialised item;
+                while (serialised.pop(item))
+                    queue_writer.write(item);
+            }
+        );
+        parser.join();
+        enricher.join();
+        serialiser.join();
+        writer.join();
+    }
+    std::chrono::duration<double> queue_time = std::chrono::steady_clock::now() - queue_start;
+
+    const double pipeline_rate = records / pipeline_time.count();
+    const double queue_rate = records / queue_time.count();
+    std::ostringstream stages;
+    for (const auto& stage : stats)
+        stages << "\nstage " << stage.name << " x" << stage.workers << ": " << stage.latency_ns() << " ns/item, "
+               << stage.items / std::max<uint64_t>(1, stage.batches) << " items/batch, occupancy "
+               << stage.occupancy() << " (max " << stage.max_occupancy << "), waits in/out " << stage.input_waits
+               << "/" << stage.output_waits;
+    INFO("threads: " << std::thread::hardware_concurrency() << ", records: " << records << stages.str());
+    INFO("Benchmark: Pipeline: " << pipeline_rate / 1e6 << " M records/s, mean latency "
+                                 << pipeline_writer.latency_sum / records / 1000 << " us");
+    INFO("Benchmark: mutex queues: " << queue_rate / 1e6 << " M records/s, mean latency "
+                                     << queue_writer.latency_sum / records / 1000 << " us");
+    CHECK(pipeline_writer.written == records);
+    CHECK(pipeline_writer.ordered);
+    CHECK(queue_writer.written == records);
+    CHECK(queue_writer.ordered);
+    CHECK(pipeline_writer.checksum == queue_writer.checksum);
+}
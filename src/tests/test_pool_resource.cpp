@@ -0,0 +1,194 @@
+/*
+ * test_pool_resource.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory_resource>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <stdexcept>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/pool_resource.hpp>
+
+// upstream resource counting all calls, forwarding to new_delete_resource()
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    ConcurrentFW::Atomic<uint64_t> allocations {0};
+    ConcurrentFW::Atomic<uint64_t> deallocations {0};
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        allocations.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* block, size_t bytes, size_t alignment) override
+    {
+        deallocations.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+TEST_CASE("check of pool resource size classes", "[pool_resource]")
+{
+    using Resource = ConcurrentFW::SynchronizedPoolResource;
+    CHECK(Resource::size_class(1, 1) == 0);
+    CHECK(Resource::size_class(16, 8) == 0);
+    CHECK(Resource::size_class(17, 8) == 1);
+    CHECK(Resource::size_class(8, 64) == 2);
+    CHECK(Resource::size_class(4096, 16) == Resource::SIZE_CLASSES - 1);
+    CHECK(Resource::size_class(4097, 16) == Resource::SIZE_CLASSES);
+}
+
+template<typename RESOURCE>
+static void check_pool_resource()
+{
+    CountingResource upstream;
+    {
+        RESOURCE resource(&upstream);
+        CHECK(resource.upstream_resource() == &upstream);
+        CHECK(resource.is_equal(resource));
+        CHECK_FALSE(resource.is_equal(upstream));
+
+        void* small1 = resource.allocate(24, 8);
+        void* small2 = resource.allocate(24, 8);
+        CHECK(upstream.allocations.load() == 1);  // one chunk for size class 32
+        CHECK(small1 != small2);
+        CHECK(reinterpret_cast<uintptr_t>(small1) % 32 == 0);
+
+        resource.deallocate(small1, 24, 8);
+        CHECK(resource.allocate(32, 16) == small1);  // same size class, reused
+
+        void* aligned = resource.allocate(8, 256);
+        CHECK(reinterpret_cast<uintptr_t>(aligned) % 256 == 0);
+        CHECK(upstream.allocations.load() == 2);
+
+        void* large = resource.allocate(100000, 16);
+        CHECK(upstream.allocations.load() == 3);  // passed through
+        resource.deallocate(large, 100000, 16);
+        CHECK(upstream.deallocations.load() == 1);
+
+        resource.deallocate(small1, 32, 16);
+        resource.deallocate(small2, 24, 8);
+        resource.deallocate(aligned, 8, 256);
+    }
+    CHECK(upstream.allocations.load() == upstream.deallocations.load());  // all chunks returned
+
+    CHECK_THROWS_AS(RESOURCE(nullptr), std::invalid_argument);
+    CHECK_THROWS_AS(RESOURCE(&upstream, 1024), std::invalid_argument);
+}
+
+TEST_CASE("check of synchronized pool resource", "[pool_resource]")
+{
+    check_pool_resource<ConcurrentFW::SynchronizedPoolResource>();
+}
+
+TEST_CASE("check of unsynchronized pool resource", "[pool_resource]")
+{
+    check_pool_resource<ConcurrentFW::UnsynchronizedPoolResource>();
+
+    ConcurrentFW::UnsynchronizedPoolResource* main_resource = &ConcurrentFW::thread_pool_resource();
+    ConcurrentFW::UnsynchronizedPoolResource* thread_resource = nullptr;
+    std::thread([&thread_resource]() { thread_resource = &ConcurrentFW::thread_pool_resource(); }).join();
+    CHECK(main_resource == &ConcurrentFW::thread_pool_resource());
+    CHECK(main_resource != thread_resource);
+}
+
+TEST_CASE("check of concurrent synchronized pool resource", "[pool_resource]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    constexpr size_t iterations {20000};
+    ConcurrentFW::SynchronizedPoolResource resource;
+    ConcurrentFW::Atomic<uint64_t> corrupted {0};
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < hw_threads; thread++)
+        threads.emplace_back(
+            [&, thread]()
+            {
+                std::pmr::vector<std::pmr::vector<uint32_t>> vectors(&resource);
+                for (size_t i = 0; i < iterations; i++)
+                {
+                    vectors.emplace_back(i % 100, thread);  // different sizes, all using the resource
+                    if (vectors.size() > 32)
+                    {
+                        for (auto& vector : vectors)
+                            if (std::any_of(vector.begin(), vector.end(), [thread](uint32_t v) { return v != thread; }))
+                                corrupted.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                        vectors.clear();
+                    }
+                }
+            }
+        );
+    for (auto& thread : threads)
+        thread.join();
+
+    CHECK(corrupted.load() == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmarks
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static std::chrono::nanoseconds churn(std::pmr::memory_resource* resource, size_t rounds)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (size_t round = 0; round < rounds; round++)
+    {
+        std::pmr::vector<uint64_t> vector(resource);
+        for (uint64_t i = 0; i < 256; i++)
+            vector.push_back(i);  // growing: several reallocations
+
+        std::pmr::unordered_map<uint64_t, uint64_t> map(resource);
+        for (uint64_t i = 0; i < 256; i++)
+            map.emplace(i, vector[i]);
+        for (uint64_t i = 0; i < 256; i += 2)
+            map.erase(i);
+        sum += map.size();
+    }
+    if (sum != rounds * 128)
+        throw std::logic_error("unexpected churn result");
+    return std::chrono::steady_clock::now() - start;
+}
+
+TEST_CASE("check pool resource churn against std::pmr resources", "[pool_resource]")
+{
+    constexpr size_t rounds {2000};
+    ConcurrentFW::SynchronizedPoolResource concurrentfw_synchronized;
+    ConcurrentFW::UnsynchronizedPoolResource concurrentfw_unsynchronized;
+    std::pmr::synchronized_pool_resource std_synchronized;
+    std::pmr::unsynchronized_pool_resource std_unsynchronized;
+
+    auto duration_new_delete = churn(std::pmr::new_delete_resource(), rounds);
+    auto duration_std_synchronized = churn(&std_synchronized, rounds);
+    auto duration_std_unsynchronized = churn(&std_unsynchronized, rounds);
+    auto duration_synchronized = churn(&concurrentfw_synchronized, rounds);
+    auto duration_unsynchronized = churn(&concurrentfw_unsynchronized, rounds);
+
+    INFO("Benchmark: new_delete_resource: " << duration_new_delete.count() / rounds << " ns/round");
+    INFO("Benchmark: synchronized_pool_resource: " << duration_std_synchronized.count() / rounds << " ns/round");
+    INFO("Benchmark: unsynchronized_pool_resource: " << duration_std_unsynchronized.count() / rounds << " ns/round");
+    INFO("Benchmark: SynchronizedPoolResource: " << duration_synchronized.count() / rounds << " ns/round");
+    INFO("Benchmark: UnsynchronizedPoolResource: " << duration_unsynchronized.count() / rounds << " ns/round");
+    CHECK(duration_synchronized.count() > 0);
+    CHECK(duration_unsynchronized.count() > 0);
+}
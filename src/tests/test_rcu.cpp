@@ -0,0 +1,217 @@
+/*
+ * test_rcu.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/concurrent_ptr.hpp>
+#include <concurrentfw/rcu.hpp>
+
+namespace
+{
+
+ConcurrentFW::Atomic<int64_t> live_configs {0};
+
+struct Config
+{
+    static constexpr uint64_t ALIVE {0xC0F1C0F1C0F1C0F1};
+
+    explicit Config(uint64_t init)
+    : version(init)
+    {
+        live_configs.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    ~Config()
+    {
+        magic = 0;
+        live_configs.sub_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+    }
+
+    Config(const Config&) = delete;
+    Config& operator=(const Config&) = delete;
+
+    volatile uint64_t magic {ALIVE};
+    uint64_t version;
+};
+
+}  // namespace
+
+TEST_CASE("check of rcu grace periods", "[rcu]")
+{
+    {
+        ConcurrentFW::RcuDomain domain(false);
+        CHECK(!domain.has_callback_thread());
+        INFO("membarrier expedited: " << domain.is_expedited());
+
+        ConcurrentFW::Atomic<int> state {0};
+        ConcurrentFW::Atomic<bool> synchronized {false};
+        std::thread reader(
+            [&]()
+            {
+                ConcurrentFW::RcuDomain::ReadGuard guard(domain);
+                domain.read_lock();  // nested
+                state.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+                while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() != 2)
+                    std::this_thread::yield();
+                domain.read_unlock();
+            }
+        );
+        while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() != 1)
+            std::this_thread::yield();
+
+        std::thread writer(
+            [&]()
+            {
+                domain.synchronize();
+                synchronized.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(true);
+            }
+        );
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(!synchronized.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>());  // reader blocks grace period
+        state.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(2);
+        writer.join();
+        reader.join();
+        CHECK(synchronized.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>());
+
+        domain.synchronize();  // no readers
+        for (uint64_t i = 0; i < 10; i++)
+            domain.call_rcu(new Config(i));
+        CHECK(live_configs.load() == 10);
+        CHECK(domain.process_callbacks() == 10);
+        CHECK(domain.process_callbacks() == 0);
+        CHECK(live_configs.load() == 0);
+
+        domain.call_rcu(new Config(10));  // executed by domain destructor
+    }
+    CHECK(live_configs.load() == 0);
+
+    {
+        ConcurrentFW::RcuDomain domain;
+        CHECK(domain.has_callback_thread());
+        for (uint64_t i = 0; i < 1000; i++)
+            domain.call_rcu(new Config(i));
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (live_configs.load() != 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CHECK(live_configs.load() == 0);
+    }
+}
+
+TEST_CASE("check of concurrent pointer with rcu reclamation", "[rcu]")
+{
+    const uint32_t hw_threads = std::max(2U, std::thread::hardware_concurrency());
+    const uint32_t readers = std::max(1U, hw_threads - 1);
+    constexpr std::chrono::milliseconds runtime(250);
+
+    ConcurrentFW::Atomic<bool> stop {false};
+    ConcurrentFW::Atomic<uint64_t> invalid_reads {0};
+    uint64_t versions = 0;
+
+    ConcurrentFW::Concurrent_Ptr<Config, ConcurrentFW::RcuReclamation> config(new Config(0));
+    std::vector<std::thread> threads;
+    for (uint32_t reader = 0; reader < readers; reader++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local_invalid = 0;
+                while (!stop.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>())
+                {
+                    ConcurrentFW::rcu_read_lock();
+                    if (config.get()->magic != Config::ALIVE)
+                        local_invalid++;
+                    ConcurrentFW::rcu_read_unlock();
+                }
+                invalid_reads.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_invalid);
+            }
+        );
+
+    auto end = std::chrono::steady_clock::now() + runtime;
+    while (std::chrono::steady_clock::now() < end)  // hot reload
+    {
+        config.replace(new Config(++versions));
+        if (versions % 16 == 0)
+            std::this_thread::yield();
+    }
+
+    // synchronous update
+    Config* old_config = config.exchange(new Config(++versions));
+    ConcurrentFW::synchronize_rcu();
+    delete old_config;
+
+    stop.store<ConcurrentFW::AtomicMemoryOrder::RELAXED>(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    config.replace(nullptr);
+    ConcurrentFW::RcuDomain::global().process_callbacks();
+
+    INFO("versions: " << versions);
+    CHECK(invalid_reads.load() == 0);
+    CHECK(live_configs.load() == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: read side cost of rcu against futex locked reads
+///////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("check rcu read side against futex", "[rcu]")
+{
+    constexpr size_t iterations {10000000};
+
+    ConcurrentFW::RcuDomain domain(false);
+    ConcurrentFW::Futex futex(false);
+    ConcurrentFW::Concurrent_Ptr<Config> config(new Config(42));
+    uint64_t sum_plain = 0;
+    uint64_t sum_rcu = 0;
+    uint64_t sum_futex = 0;
+
+    auto start_plain = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        sum_plain += config.get()->version;
+    std::chrono::nanoseconds duration_plain = std::chrono::steady_clock::now() - start_plain;
+
+    auto start_rcu = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        domain.read_lock();
+        sum_rcu += config.get()->version;
+        domain.read_unlock();
+    }
+    std::chrono::nanoseconds duration_rcu = std::chrono::steady_clock::now() - start_rcu;
+
+    auto start_futex = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        futex.lock();
+        sum_futex += config.get()->version;
+        futex.unlock();
+    }
+    std::chrono::nanoseconds duration_futex = std::chrono::steady_clock::now() - start_futex;
+
+    delete config.exchange(nullptr);
+
+    auto per_read = [](std::chrono::nanoseconds duration)
+    { return static_cast<double>(duration.count()) / static_cast<double>(iterations); };
+    INFO("membarrier expedited: " << domain.is_expedited());
+    INFO("Benchmark: Concurrent_Ptr::get(): " << per_read(duration_plain) << " ns/read");
+    INFO("Benchmark: rcu_read_lock() + get(): " << per_read(duration_rcu) << " ns/read");
+    INFO("Benchmark: Futex + get(): " << per_read(duration_futex) << " ns/read");
+    CHECK(sum_plain == 42 * iterations);
+    CHECK(sum_rcu == 42 * iterations);
+    CHECK(sum_futex == 42 * iterations);
+    CHECK(duration_rcu < duration_futex);
+}
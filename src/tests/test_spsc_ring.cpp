@@ -0,0 +1,187 @@
+/*
+ * test_spsc_ring.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <pthread.h>  // pthread_setaffinity_np()
+#include <sched.h>    // cpu_set_t
+
+#include <memory>
+#include <string>
+#include <span>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/spsc_ring.hpp>
+#include <concurrentfw/mpmc_queue.hpp>
+
+TEST_CASE("check of spsc ring", "[spsc_ring]")
+{
+    ConcurrentFW::SpscRing<std::string, 8> ring;
+    CHECK(ring.capacity() == 8);
+
+    std::string item;
+    CHECK(!ring.try_pop(item));
+    for (int i = 0; i < 8; i++)
+        CHECK(ring.try_push(std::to_string(i)));
+    CHECK(!ring.try_push(std::to_string(8)));
+    CHECK(ring.size_approx() == 8);
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(ring.try_pop(item));
+        CHECK(item == std::to_string(i));
+    }
+    CHECK(!ring.try_pop(item));
+
+    // zero copy spans end at the wrap-around
+    std::span<std::string> writable = ring.prepare_write(8);
+    CHECK(writable.size() == 8);  // head is at position 8 == 0
+    for (size_t i = 0; i < 3; i++)
+        writable[i] = std::to_string(10 + i);
+    ring.commit_write(3);
+    std::span<std::string> readable = ring.peek_read(2);
+    CHECK(readable.size() == 2);
+    CHECK(readable[0] == "10");
+    CHECK(readable[1] == "11");
+    ring.release_read(2);
+
+    writable = ring.prepare_write(8);
+    CHECK(writable.size() == 5);  // positions 3..7
+    ring.commit_write(0);
+
+    ConcurrentFW::SpscRing<int, 8> numbers;
+    const int input[7] = {1, 2, 3, 4, 5, 6, 7};
+    int output[8] = {};
+    for (int round = 0; round < 5; round++)  // batches across the wrap-around
+    {
+        CHECK(numbers.try_push_n(input, 7) == 7);
+        CHECK(numbers.try_push_n(input, 7) == 1);
+        CHECK(numbers.try_pop_n(output, 8) == 8);
+        CHECK(std::equal(input, input + 7, output));
+        CHECK(output[7] == 1);
+    }
+    CHECK(numbers.try_pop_n(output, 8) == 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: throughput between two pinned threads
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static void pin_to_cpu(std::thread& thread, unsigned cpu)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % std::max(1U, std::thread::hardware_concurrency()), &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+static constexpr size_t ring_messages {100000000};
+static constexpr size_t ring_batch {256};
+
+TEST_CASE("check spsc ring throughput", "[spsc_ring]")
+{
+    auto ring = std::make_unique<ConcurrentFW::SpscRing<uint64_t, 4096>>();
+    uint64_t checksum_ring = 0;
+
+    auto start_ring = std::chrono::steady_clock::now();
+    std::thread consumer(
+        [&]()
+        {
+            size_t received = 0;
+            while (received < ring_messages)
+            {
+                std::span<uint64_t> readable = ring->peek_read(ring_batch);
+                if (readable.empty())
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (uint64_t message : readable)
+                    checksum_ring += message;
+                ring->release_read(readable.size());
+                received += readable.size();
+            }
+        }
+    );
+    std::thread producer(
+        [&]()
+        {
+            size_t sent = 0;
+            while (sent < ring_messages)
+            {
+                std::span<uint64_t> writable = ring->prepare_write(std::min(ring_batch, ring_messages - sent));
+                if (writable.empty())
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (uint64_t& message : writable)
+                    message = sent++;
+                ring->commit_write(writable.size());
+            }
+        }
+    );
+    pin_to_cpu(consumer, 0);
+    pin_to_cpu(producer, 1);
+    producer.join();
+    consumer.join();
+    std::chrono::duration<double> duration_ring = std::chrono::steady_clock::now() - start_ring;
+
+    // same batches with the MPMC queue
+    constexpr size_t queue_messages {ring_messages / 10};
+    ConcurrentFW::MpmcQueue<uint64_t> queue(4096);
+    uint64_t checksum_queue = 0;
+    auto start_queue = std::chrono::steady_clock::now();
+    std::thread queue_consumer(
+        [&]()
+        {
+            uint64_t batch[ring_batch];
+            size_t received = 0;
+            while (received < queue_messages)
+            {
+                size_t popped = queue.try_pop_n(batch, ring_batch);
+                if (popped == 0)
+                    std::this_thread::yield();
+                for (size_t i = 0; i < popped; i++)
+                    checksum_queue += batch[i];
+                received += popped;
+            }
+        }
+    );
+    std::thread queue_producer(
+        [&]()
+        {
+            uint64_t batch[ring_batch];
+            size_t sent = 0;
+            while (sent < queue_messages)
+            {
+                size_t count = std::min(ring_batch, queue_messages - sent);
+                for (size_t i = 0; i < count; i++)
+                    batch[i] = sent + i;
+                size_t pushed = queue.try_push_n(batch, count);
+                if (pushed == 0)
+                    std::this_thread::yield();
+                sent += pushed;
+            }
+        }
+    );
+    pin_to_cpu(queue_consumer, 0);
+    pin_to_cpu(queue_producer, 1);
+    queue_producer.join();
+    queue_consumer.join();
+    std::chrono::duration<double> duration_queue = std::chrono::steady_clock::now() - start_queue;
+
+    const double rate_ring = static_cast<double>(ring_messages) / duration_ring.count();
+    const double rate_queue = static_cast<double>(queue_messages) / duration_queue.count();
+    INFO("Benchmark: SpscRing: " << rate_ring << " msgs/s");
+    INFO("Benchmark: MpmcQueue: " << rate_queue << " msgs/s");
+    CHECK(checksum_ring == ring_messages * (ring_messages - 1) / 2);
+    CHECK(checksum_queue == queue_messages * (queue_messages - 1) / 2);
+}
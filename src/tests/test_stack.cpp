@@ -32,6 +32,22 @@ TEST_CASE("check of one stack", "[stack]")
     CHECK(test_stack.pop() == nullptr);
 }
 
+TEST_CASE("check of stack list push", "[stack]")
+{
+    ConcurrentFW::Stack test_stack;
+    void* blocks[3][8];
+
+    CHECK_THROWS(test_stack.push_list(nullptr, &blocks[0]));
+    CHECK_THROWS(test_stack.push_list(&blocks[0], nullptr));
+    test_stack.push(&blocks[2]);
+    blocks[0][0] = &blocks[1];  // link blocks[0] -> blocks[1]
+    test_stack.push_list(&blocks[0], &blocks[1]);
+    CHECK(test_stack.pop() == &blocks[0]);
+    CHECK(test_stack.pop() == &blocks[1]);
+    CHECK(test_stack.pop() == &blocks[2]);
+    CHECK(test_stack.pop() == nullptr);
+}
+
 static ConcurrentFW::Stack* stacks {nullptr};  // vector<> won't work, as Stack<> is not move-constructable
 static ConcurrentFW::Atomic<bool> end_test {false};
 static ConcurrentFW::Atomic<uint64_t> overall_stack_operations {0};
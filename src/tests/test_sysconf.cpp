@@ -8,6 +8,11 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
 #include <concurrentfw/sysconf.hpp>
 
 TEST_CASE("check of sysconf access", "[sysconf]")
@@ -17,4 +22,9 @@ TEST_CASE("check of sysconf access", "[sysconf]")
     CHECK_NOTHROW(ConcurrentFW::page_size());
     CHECK(ConcurrentFW::cache_line() == 64);
     CHECK(ConcurrentFW::page_size() == 4096);
+
+    const std::vector<uint32_t> cpus = ConcurrentFW::allowed_cpus();
+    CHECK(!cpus.empty());
+    CHECK(cpus.size() <= std::max(1U, std::thread::hardware_concurrency()));
+    CHECK(std::is_sorted(cpus.begin(), cpus.end()));
 }
@@ -0,0 +1,129 @@
+/*
+ * test_task_graph.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/task_graph.hpp>
+
+TEST_CASE("check of task graph", "[task_graph]")
+{
+    ConcurrentFW::ThreadPool pool(3);
+    ConcurrentFW::TaskGraph graph;
+    graph.run(pool);  // empty graph
+
+    // diamond: a -> (b, c) -> d, order is recorded with a sequence counter
+    ConcurrentFW::Atomic<uint32_t> sequence {0};
+    uint32_t order[4] = {};
+    auto record = [&](uint32_t node)
+    { return [&, node]() { order[node] = sequence.add_fetch<ConcurrentFW::AtomicMemoryOrder::ACQ_REL>(1); }; };
+    const auto a = graph.add(record(0));
+    const auto b = graph.add(record(1));
+    const auto c = graph.add(record(2));
+    const auto d = graph.add(record(3));
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+    CHECK(graph.size() == 4);
+
+    for (uint32_t run = 1; run <= 3; run++)  // built graph is reused
+    {
+        graph.run(pool);
+        CHECK(sequence.load() == 4 * run);
+        CHECK(order[0] < order[1]);
+        CHECK(order[0] < order[2]);
+        CHECK(order[1] < order[3]);
+        CHECK(order[2] < order[3]);
+    }
+
+    CHECK_THROWS_AS(graph.precede(a, 4), std::out_of_range);
+    CHECK_THROWS_AS(graph.precede(a, a), std::logic_error);
+    graph.precede(d, a);
+    CHECK_THROWS_AS(graph.run(pool), std::logic_error);  // cycle
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: layered graph with one slow node per level, dependencies against barriers
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static void busy_work(std::chrono::nanoseconds duration)
+{
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+        ;
+}
+
+TEST_CASE("check task graph against barrier per level", "[task_graph]")
+{
+    const uint32_t threads = std::max(2U, std::thread::hardware_concurrency());
+    const uint32_t width = 2 * threads;
+    constexpr uint32_t levels {40};
+    constexpr std::chrono::microseconds fast {20};
+    constexpr std::chrono::microseconds slow {200};
+
+    // node (level, column) depends on (level - 1, column) and (level - 1, column + 1)
+    auto duration = [width](uint32_t level, uint32_t column)
+    { return column == (level * 5) % width ? slow : fast; };
+    std::chrono::microseconds total_work {0};
+    for (uint32_t level = 0; level < levels; level++)
+        for (uint32_t column = 0; column < width; column++)
+            total_work += duration(level, column);
+
+    ConcurrentFW::ThreadPool pool(threads - 1);  // caller helps
+    ConcurrentFW::TaskGraph graph;
+    std::vector<ConcurrentFW::TaskGraph::NodeId> previous;
+    std::vector<ConcurrentFW::TaskGraph::NodeId> current;
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        current.clear();
+        for (uint32_t column = 0; column < width; column++)
+        {
+            current.push_back(graph.add([work = duration(level, column)]() { busy_work(work); }));
+            if (level > 0)
+            {
+                graph.precede(previous[column], current.back());
+                graph.precede(previous[(column + 1) % width], current.back());
+            }
+        }
+        std::swap(previous, current);
+    }
+
+    graph.run(pool);  // warm-up, also validation
+    auto start_graph = std::chrono::steady_clock::now();
+    graph.run(pool);
+    std::chrono::duration<double> makespan_graph = std::chrono::steady_clock::now() - start_graph;
+
+    auto start_barrier = std::chrono::steady_clock::now();
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        for (uint32_t column = 0; column < width; column++)
+            pool.submit([work = duration(level, column)]() { busy_work(work); });
+        pool.wait_idle();
+    }
+    std::chrono::duration<double> makespan_barrier = std::chrono::steady_clock::now() - start_barrier;
+
+    const double work_seconds = std::chrono::duration<double>(total_work).count();
+    auto utilisation = [&](std::chrono::duration<double> makespan)
+    { return 100.0 * work_seconds / (makespan.count() * threads); };
+    INFO("threads: " << threads << ", nodes: " << graph.size());
+    INFO("Benchmark: TaskGraph: " << makespan_graph.count() * 1000 << " ms, utilisation "
+                                  << utilisation(makespan_graph) << " %");
+    INFO("Benchmark: barrier per level: " << makespan_barrier.count() * 1000 << " ms, utilisation "
+                                          << utilisation(makespan_barrier) << " %");
+    CHECK(makespan_graph.count() > 0);
+    CHECK(makespan_barrier.count() > 0);
+}
@@ -0,0 +1,249 @@
+/*
+ * test_thread_pool.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <pthread.h>  // pthread_setaffinity_np()
+#include <sched.h>    // cpu_set_t
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <system_error>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+TEST_CASE("check of thread pool", "[thread_pool]")
+{
+    ConcurrentFW::ThreadPool pool(4);
+    CHECK(pool.size() == 4);
+    CHECK(pool.worker_index() == -1);
+
+    ConcurrentFW::Atomic<uint64_t> sum {0};
+    ConcurrentFW::Atomic<uint32_t> in_worker {0};
+    for (uint64_t i = 1; i <= 1000; i++)
+        pool.submit(
+            [&, i]()
+            {
+                sum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(i);
+                if (pool.worker_index() >= 0)
+                    in_worker.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+            }
+        );
+    pool.wait_idle();
+    CHECK(sum.load() == 1000 * 1001 / 2);
+    CHECK(in_worker.load() == 1000);
+
+    // tasks submitted by tasks go to the local deque of the worker and are stolen by the others
+    ConcurrentFW::Atomic<uint32_t> leaves {0};
+    std::function<void(uint32_t)> fork = [&](uint32_t depth)
+    {
+        if (depth == 0)
+        {
+            leaves.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+            return;
+        }
+        pool.submit([&, depth]() { fork(depth - 1); });
+        pool.submit([&, depth]() { fork(depth - 1); });
+    };
+    pool.submit([&]() { fork(12); });
+    pool.wait_idle();
+    CHECK(leaves.load() == 4096);
+
+    // pinned workers, destructor waits for remaining tasks
+    ConcurrentFW::Atomic<uint32_t> done {0};
+    {
+        ConcurrentFW::ThreadPool pinned(2, true);
+        for (uint32_t i = 0; i < 100; i++)
+            pinned.submit([&]() { done.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1); });
+    }
+    CHECK(done.load() == 100);
+
+    // pinned workers only use the allowed CPUs of the creating thread (e.g. restricted by a cpuset)
+    size_t allowed = 0;
+    bool created = false;
+    std::thread restricted(
+        [&]()
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(ConcurrentFW::allowed_cpus().back(), &cpus);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+                return;
+            allowed = ConcurrentFW::allowed_cpus().size();
+            try
+            {
+                ConcurrentFW::ThreadPool pinned(3, true);
+                created = true;
+                for (uint32_t i = 0; i < 100; i++)
+                    pinned.submit([&]() { done.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1); });
+            }
+            catch (const std::system_error&)  // pinned to a CPU outside of the affinity mask
+            {}
+        }
+    );
+    restricted.join();
+    CHECK(allowed == 1);
+    CHECK(created);
+    CHECK(done.load() == 200);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: fine-grained tasks against a std::mutex + std::condition_variable pool
+///////////////////////////////////////////////////////////////////////////////////////////
+
+class MutexPool
+{
+public:
+    explicit MutexPool(uint32_t workers)
+    {
+        for (uint32_t i = 0; i < workers; i++)
+            threads.emplace_back([this]() { worker_loop(); });
+    }
+
+    ~MutexPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    template<typename FUNC>
+    void submit(FUNC&& func)
+    {
+        {
+            std::lock_guard lock(mutex);
+            tasks.emplace_back(std::forward<FUNC>(func));
+            pending++;
+        }
+        work_available.notify_one();
+    }
+
+    void wait_idle()
+    {
+        std::unique_lock lock(mutex);
+        all_done.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    void worker_loop()
+    {
+        std::unique_lock lock(mutex);
+        while (true)
+        {
+            work_available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+            if (--pending == 0)
+                all_done.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    std::deque<std::function<void()>> tasks;
+    size_t pending {0};
+    bool stopping {false};
+    std::vector<std::thread> threads;
+};
+
+static void busy_work(std::chrono::nanoseconds duration)  // ~1 us of work without sleeping
+{
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+        ;
+}
+
+struct PoolResult
+{
+    double spawn_ns;  // per task, from outside of the pool
+    double tasks_per_second;
+    bool complete;
+};
+
+template<typename POOL>
+static PoolResult run_pool(POOL& pool, uint32_t tasks)
+{
+    ConcurrentFW::Atomic<uint32_t> done {0};
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < tasks; i++)
+        pool.submit(
+            [&]()
+            {
+                busy_work(std::chrono::microseconds(1));
+                done.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+            }
+        );
+    std::chrono::duration<double, std::nano> spawn = std::chrono::steady_clock::now() - start;
+    pool.wait_idle();
+    std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+    return {spawn.count() / tasks, tasks / total.count(), done.load() == tasks};
+}
+
+TEST_CASE("check thread pool with fine-grained tasks", "[thread_pool]")
+{
+    const uint32_t workers = std::max(2U, std::thread::hardware_concurrency());
+    constexpr uint32_t tasks {200000};
+
+    PoolResult result_pool;
+    {
+        ConcurrentFW::ThreadPool pool(workers);
+        result_pool = run_pool(pool, tasks);
+    }
+    PoolResult result_mutex;
+    {
+        MutexPool pool(workers);
+        result_mutex = run_pool(pool, tasks);
+    }
+
+    // tasks spawned by a task, pushed to the deque of its worker
+    constexpr uint32_t children {100000};
+    ConcurrentFW::Atomic<uint32_t> children_done {0};
+    double spawn_inside_ns = 0;
+    {
+        ConcurrentFW::ThreadPool pool(workers);
+        pool.submit(
+            [&]()
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < children; i++)
+                    pool.submit([&]() { children_done.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1); });
+                std::chrono::duration<double, std::nano> spawn = std::chrono::steady_clock::now() - start;
+                spawn_inside_ns = spawn.count() / children;
+            }
+        );
+        pool.wait_idle();
+    }
+
+    INFO("workers: " << workers);
+    INFO("Benchmark: ThreadPool: spawn " << result_pool.spawn_ns << " ns/task (external), " << spawn_inside_ns
+                                         << " ns/task (inside worker), " << result_pool.tasks_per_second
+                                         << " tasks/s");
+    INFO("Benchmark: std::mutex + std::condition_variable: spawn " << result_mutex.spawn_ns << " ns/task, "
+                                                                   << result_mutex.tasks_per_second << " tasks/s");
+    CHECK(result_pool.complete);
+    CHECK(result_mutex.complete);
+    CHECK(children_done.load() == children);
+}
@@ -0,0 +1,122 @@
+/*
+ * test_thread_registry.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/thread_registry.hpp>
+
+TEST_CASE("check of thread registry", "[thread_registry]")
+{
+    const uint32_t own_index = ConcurrentFW::ThreadRegistry::index();
+    CHECK(ConcurrentFW::ThreadRegistry::index() == own_index);
+    CHECK(own_index < ConcurrentFW::ThreadRegistry::high_water());
+
+    constexpr uint32_t threads_count {16};
+    ConcurrentFW::Atomic<int> state {0};
+    std::vector<uint32_t> indices(threads_count);
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < threads_count; thread++)
+        threads.emplace_back(
+            [&indices, &state, thread]()
+            {
+                indices[thread] = ConcurrentFW::ThreadRegistry::index();
+                state.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+                while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() >= 0)  // keep all threads alive
+                    std::this_thread::yield();
+            }
+        );
+    while (state.load<ConcurrentFW::AtomicMemoryOrder::ACQUIRE>() != static_cast<int>(threads_count))
+        std::this_thread::yield();
+
+    // all indices are unique and dense
+    std::vector<uint32_t> live;
+    ConcurrentFW::ThreadRegistry::for_each([&live](uint32_t index) { live.push_back(index); });
+    CHECK(ConcurrentFW::ThreadRegistry::live_threads() == live.size());
+    CHECK(std::find(live.begin(), live.end(), own_index) != live.end());
+    for (uint32_t index : indices)
+        CHECK(std::find(live.begin(), live.end(), index) != live.end());
+    std::vector<uint32_t> sorted(indices);
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+    const uint32_t high_water = ConcurrentFW::ThreadRegistry::high_water();
+    CHECK(high_water <= live.size() + 64);  // other test cases may have left some free indices
+
+    state.store<ConcurrentFW::AtomicMemoryOrder::RELEASE>(-1);
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(ConcurrentFW::ThreadRegistry::live_threads() == live.size() - threads_count);
+
+    // indices of exited threads are recycled
+    for (uint32_t round = 0; round < 100; round++)
+    {
+        std::thread short_lived([]() { ConcurrentFW::ThreadRegistry::index(); });
+        short_lived.join();
+    }
+    CHECK(ConcurrentFW::ThreadRegistry::high_water() == high_water);
+
+    // an index taken again by a later thread local destructor is released as well
+    struct LateUser
+    {
+        ~LateUser()
+        {
+            ConcurrentFW::ThreadRegistry::index();
+        }
+    };
+    const uint32_t live_before = ConcurrentFW::ThreadRegistry::live_threads();
+    for (uint32_t round = 0; round < 100; round++)
+    {
+        std::thread late_registering(
+            []()
+            {
+                thread_local LateUser late_user;  // constructed first, so destructed after the releaser of the index
+                static_cast<void>(&late_user);
+                ConcurrentFW::ThreadRegistry::index();
+            }
+        );
+        late_registering.join();
+    }
+    CHECK(ConcurrentFW::ThreadRegistry::live_threads() == live_before);
+    CHECK(ConcurrentFW::ThreadRegistry::high_water() == high_water);
+}
+
+TEST_CASE("check thread registry index against thread id", "[thread_registry]")
+{
+    constexpr size_t iterations {100000000};
+
+    uint64_t sum_index = 0;
+    auto start_index = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        sum_index += ConcurrentFW::ThreadRegistry::index();
+        ConcurrentFW::compiler_barrier();
+    }
+    std::chrono::nanoseconds duration_index = std::chrono::steady_clock::now() - start_index;
+
+    uint64_t sum_hash = 0;
+    auto start_hash = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        sum_hash += std::hash<std::thread::id>()(std::this_thread::get_id()) % 64;
+        ConcurrentFW::compiler_barrier();
+    }
+    std::chrono::nanoseconds duration_hash = std::chrono::steady_clock::now() - start_hash;
+
+    auto per_lookup = [](std::chrono::nanoseconds duration)
+    { return static_cast<double>(duration.count()) / static_cast<double>(iterations); };
+    INFO("Benchmark: ThreadRegistry::index(): " << per_lookup(duration_index) << " ns/lookup");
+    INFO("Benchmark: hashed std::this_thread::get_id(): " << per_lookup(duration_hash) << " ns/lookup");
+    CHECK(sum_index == iterations * ConcurrentFW::ThreadRegistry::index());
+    CHECK(sum_hash > 0);
+}
@@ -0,0 +1,199 @@
+/*
+ * test_timer_wheel.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/timer_wheel.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("check of timer wheel", "[timer_wheel]")
+{
+    ConcurrentFW::TimerWheel wheel(1ms);
+    CHECK(wheel.resolution() == 1ms);
+    CHECK_FALSE(wheel.cancel(ConcurrentFW::TimerWheel::TimerId()));
+
+    // short timers (level 0) and timers, which are cascaded from higher levels
+    constexpr uint32_t timers {200};
+    const auto base = ConcurrentFW::TimerWheel::Clock::now();
+    std::vector<ConcurrentFW::TimerWheel::Clock::time_point> deadlines(timers);
+    std::vector<ConcurrentFW::TimerWheel::Clock::time_point> fired(timers);
+    std::vector<ConcurrentFW::TimerWheel::TimerId> ids(timers);
+    ConcurrentFW::Atomic<uint32_t> fired_count {0};
+    for (uint32_t timer = 0; timer < timers; timer++)
+    {
+        deadlines[timer] = base + std::chrono::milliseconds((timer * 37) % 300);
+        ids[timer] = wheel.schedule_at(
+            deadlines[timer],
+            [&, timer]()
+            {
+                fired[timer] = ConcurrentFW::TimerWheel::Clock::now();
+                fired_count.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELEASE>(1);
+            }
+        );
+    }
+    uint32_t cancelled = 0;
+    for (uint32_t timer = 0; timer < timers; timer += 3)
+        if (wheel.cancel(ids[timer]))
+            cancelled++;
+    CHECK(cancelled > timers / 3 - 10);  // a few with deadline 0 may have fired already
+
+    while (fired_count.load() < timers - cancelled)
+        std::this_thread::sleep_for(5ms);
+    std::this_thread::sleep_for(20ms);
+    CHECK(fired_count.load() == timers - cancelled);
+    bool never_early = true;
+    for (uint32_t timer = 0; timer < timers; timer++)
+        if (fired[timer] != ConcurrentFW::TimerWheel::Clock::time_point() && fired[timer] < deadlines[timer])
+            never_early = false;
+    CHECK(never_early);
+    bool stale_cancelled = false;  // fired or cancelled before, also after reuse of the node
+    for (uint32_t timer = 0; timer < timers; timer++)
+        stale_cancelled |= wheel.cancel(ids[timer]);
+    CHECK_FALSE(stale_cancelled);
+
+    // callbacks can schedule timers, cancelled timers do not fire
+    ConcurrentFW::Atomic<uint32_t> chain {0};
+    std::function<void()> next = [&]()
+    {
+        if (chain.add_fetch<ConcurrentFW::AtomicMemoryOrder::ACQ_REL>(1) < 5)
+            wheel.schedule_after(2ms, next);
+    };
+    wheel.schedule_after(1ms, next);
+    bool late_fired = false;
+    auto late = wheel.schedule_after(100ms, [&]() { late_fired = true; });
+    CHECK(wheel.cancel(late));
+    CHECK_FALSE(wheel.cancel(late));
+    while (chain.load() < 5)
+        std::this_thread::sleep_for(1ms);
+    std::this_thread::sleep_for(150ms);
+    CHECK(chain.load() == 5);
+    CHECK_FALSE(late_fired);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: 10M outstanding timers, 90% cancelled, against std::multimap with mutex
+///////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("check timer wheel against multimap", "[timer_wheel]")
+{
+    constexpr uint32_t total_timers {10000000};
+    const uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    const uint32_t per_thread = total_timers / threads;
+    ConcurrentFW::Atomic<uint32_t> fired {0};
+
+    // deadlines 10 s to 70 s ahead, nothing fires during the benchmark
+    auto deadline = [](ConcurrentFW::TimerWheel::Clock::time_point now, uint32_t index)
+    { return now + 10s + std::chrono::milliseconds((index * 7919ULL) % 60000); };
+
+    auto run_threads = [&](auto&& body)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (uint32_t thread = 0; thread < threads; thread++)
+            workers.emplace_back(body, thread);
+        for (auto& worker : workers)
+            worker.join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double wheel_schedule = 0;
+    double wheel_cancel = 0;
+    uint64_t wheel_cancelled = 0;
+    size_t wheel_nodes = 0;
+    {
+        ConcurrentFW::TimerWheel wheel(1ms);
+        std::vector<std::vector<ConcurrentFW::TimerWheel::TimerId>> ids(threads);
+        ConcurrentFW::Atomic<uint64_t> cancelled {0};
+        wheel_schedule = run_threads(
+            [&](uint32_t thread)
+            {
+                ids[thread].reserve(per_thread);
+                const auto now = ConcurrentFW::TimerWheel::Clock::now();
+                for (uint32_t index = 0; index < per_thread; index++)
+                    ids[thread].push_back(wheel.schedule_at(
+                        deadline(now, index),
+                        [&]() { fired.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1); }
+                    ));
+            }
+        );
+        wheel_cancel = run_threads(
+            [&](uint32_t thread)
+            {
+                uint64_t count = 0;
+                for (uint32_t index = 0; index < per_thread; index++)
+                    if (index % 10 != 0 && wheel.cancel(ids[thread][index]))
+                        count++;
+                cancelled.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(count);
+            }
+        );
+        wheel_cancelled = cancelled.load();
+        wheel_nodes = wheel.allocated_nodes();
+    }
+
+    double map_schedule = 0;
+    double map_cancel = 0;
+    uint64_t map_cancelled = 0;
+    {
+        std::mutex mutex;
+        std::multimap<ConcurrentFW::TimerWheel::Clock::time_point, std::function<void()>> timeouts;
+        using Iterator = decltype(timeouts)::iterator;
+        std::vector<std::vector<Iterator>> ids(threads);
+        ConcurrentFW::Atomic<uint64_t> cancelled {0};
+        map_schedule = run_threads(
+            [&](uint32_t thread)
+            {
+                ids[thread].reserve(per_thread);
+                const auto now = ConcurrentFW::TimerWheel::Clock::now();
+                for (uint32_t index = 0; index < per_thread; index++)
+                {
+                    std::lock_guard lock(mutex);
+                    ids[thread].push_back(timeouts.emplace(
+                        deadline(now, index),
+                        [&]() { fired.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1); }
+                    ));
+                }
+            }
+        );
+        map_cancel = run_threads(
+            [&](uint32_t thread)
+            {
+                uint64_t count = 0;
+                for (uint32_t index = 0; index < per_thread; index++)
+                    if (index % 10 != 0)
+                    {
+                        std::lock_guard lock(mutex);
+                        timeouts.erase(ids[thread][index]);
+                        count++;
+                    }
+                cancelled.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(count);
+            }
+        );
+        map_cancelled = cancelled.load();
+    }
+
+    const double timers = static_cast<double>(per_thread) * threads;
+    INFO("threads: " << threads << ", timers: " << timers << ", wheel nodes: " << wheel_nodes);
+    INFO("Benchmark: TimerWheel schedule: " << timers / wheel_schedule / 1e6 << " M/s, cancel: "
+                                            << wheel_cancelled / wheel_cancel / 1e6 << " M/s");
+    INFO("Benchmark: multimap+mutex schedule: " << timers / map_schedule / 1e6 << " M/s, cancel: "
+                                                << map_cancelled / map_cancel / 1e6 << " M/s");
+    CHECK(fired.load() == 0);
+    CHECK(wheel_cancelled == map_cancelled);
+    CHECK(wheel_nodes >= timers);
+}
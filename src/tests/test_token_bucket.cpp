@@ -0,0 +1,188 @@
+/*
+ * test_token_bucket.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/token_bucket.hpp>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("check of token bucket", "[token_bucket]")
+{
+    CHECK_THROWS_AS(ConcurrentFW::TokenBucket(0.0, 10), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::TokenBucket(100.0, 0), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::TokenBucket(100.0, ConcurrentFW::TokenBucket::MAX_BURST + 1), std::invalid_argument);
+
+    // starts full, consumes all or nothing
+    ConcurrentFW::TokenBucket bucket(1000.0, 100);
+    CHECK(bucket.burst() == 100);
+    CHECK(bucket.available() == 100);
+    CHECK_FALSE(bucket.try_consume(101));
+    CHECK(bucket.try_consume(60));
+    CHECK_FALSE(bucket.try_consume(41));
+    CHECK(bucket.try_consume(40));
+    CHECK_FALSE(bucket.try_consume());
+
+    // refill with 1000 tokens/s, fractions are not lost by frequent refills (no token at all otherwise)
+    auto start = std::chrono::steady_clock::now();
+    uint32_t consumed = 0;
+    while (std::chrono::steady_clock::now() - start < 50ms)
+        if (bucket.try_consume())
+            consumed++;
+    std::chrono::duration<double> refill_time = std::chrono::steady_clock::now() - start;
+    CHECK(consumed >= 10);  // wide bounds, the thread may be descheduled
+    CHECK(consumed <= static_cast<uint32_t>(refill_time.count() * 1000) + 1);
+
+    // refill is capped at the burst
+    std::this_thread::sleep_for(150ms);
+    CHECK(bucket.available() == 100);
+
+    // blocking acquire waits for the refill time
+    CHECK_THROWS_AS(bucket.acquire(101), std::invalid_argument);
+    bucket.acquire(100);
+    auto before_acquire = std::chrono::steady_clock::now();
+    bucket.acquire(20);
+    std::chrono::duration<double> waited = std::chrono::steady_clock::now() - before_acquire;
+    CHECK(waited.count() >= 0.018);
+
+    // concurrent consumers never take more than burst + refill
+    ConcurrentFW::TokenBucket shared(10000.0, 1000);
+    ConcurrentFW::Atomic<uint32_t> taken {0};
+    auto shared_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> consumers;
+    for (uint32_t thread = 0; thread < 4; thread++)
+        consumers.emplace_back(
+            [&]()
+            {
+                while (std::chrono::steady_clock::now() - shared_start < 100ms)
+                    if (shared.try_consume(3))
+                        taken.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(3);
+            }
+        );
+    for (auto& consumer : consumers)
+        consumer.join();
+    std::chrono::duration<double> shared_time = std::chrono::steady_clock::now() - shared_start;
+    CHECK(taken.load() <= 1000 + static_cast<uint32_t>(shared_time.count() * 10000) + 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: one bucket and many buckets, against mutex-protected buckets
+///////////////////////////////////////////////////////////////////////////////////////////
+
+class MutexTokenBucket
+{
+public:
+    MutexTokenBucket(double tokens_per_second, uint32_t burst)
+    : rate(tokens_per_second / 1e9)
+    , capacity(burst)
+    , tokens(burst)
+    , stamp(std::chrono::steady_clock::now())
+    {}
+
+    bool try_consume(uint32_t requested = 1)
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard lock(mutex);
+        const double elapsed = std::chrono::duration<double, std::nano>(now - stamp).count();
+        tokens = std::min(capacity, tokens + elapsed * rate);
+        stamp = now;
+        if (tokens < requested)
+            return false;
+        tokens -= requested;
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    const double rate;
+    const double capacity;
+    double tokens;
+    std::chrono::steady_clock::time_point stamp;
+};
+
+template<typename BUCKET>
+static double consume_rate(std::vector<std::unique_ptr<BUCKET>>& buckets, uint32_t threads, uint64_t& granted)
+{
+    constexpr auto duration {200ms};
+    ConcurrentFW::Atomic<uint64_t> attempts {0};
+    ConcurrentFW::Atomic<uint64_t> successes {0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t thread = 0; thread < threads; thread++)
+        workers.emplace_back(
+            [&, thread]()
+            {
+                uint64_t random = 0x9E3779B97F4A7C15ULL * (thread + 1);
+                uint64_t local_attempts = 0;
+                uint64_t local_successes = 0;
+                while (std::chrono::steady_clock::now() - start < duration)
+                    for (uint32_t batch = 0; batch < 64; batch++)
+                    {
+                        random ^= random << 13;
+                        random ^= random >> 7;
+                        random ^= random << 17;
+                        if (buckets[random % buckets.size()]->try_consume())
+                            local_successes++;
+                        local_attempts++;
+                    }
+                attempts.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_attempts);
+                successes.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_successes);
+            }
+        );
+    for (auto& worker : workers)
+        worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    granted = successes.load();
+    return static_cast<double>(attempts.load()) / elapsed.count();
+}
+
+TEST_CASE("check token bucket against mutex", "[token_bucket]")
+{
+    const uint32_t threads = std::max(1U, std::thread::hardware_concurrency());
+    constexpr double rate {1e9};  // effectively unlimited, contention on the bucket dominates
+    constexpr uint32_t burst {ConcurrentFW::TokenBucket::MAX_BURST};
+    constexpr uint32_t many {1024};
+
+    std::vector<std::unique_ptr<ConcurrentFW::TokenBucket>> single_lockfree;
+    std::vector<std::unique_ptr<MutexTokenBucket>> single_mutex;
+    single_lockfree.push_back(std::make_unique<ConcurrentFW::TokenBucket>(rate, burst));
+    single_mutex.push_back(std::make_unique<MutexTokenBucket>(rate, burst));
+    std::vector<std::unique_ptr<ConcurrentFW::TokenBucket>> many_lockfree;
+    std::vector<std::unique_ptr<MutexTokenBucket>> many_mutex;
+    for (uint32_t bucket = 0; bucket < many; bucket++)
+    {
+        many_lockfree.push_back(std::make_unique<ConcurrentFW::TokenBucket>(rate, burst));
+        many_mutex.push_back(std::make_unique<MutexTokenBucket>(rate, burst));
+    }
+
+    uint64_t granted[4];
+    const double single_lockfree_rate = consume_rate(single_lockfree, threads, granted[0]);
+    const double single_mutex_rate = consume_rate(single_mutex, threads, granted[1]);
+    const double many_lockfree_rate = consume_rate(many_lockfree, threads, granted[2]);
+    const double many_mutex_rate = consume_rate(many_mutex, threads, granted[3]);
+
+    INFO("threads: " << threads << ", buckets: 1 and " << many);
+    INFO("Benchmark: TokenBucket, single: " << single_lockfree_rate / 1e6 << " M/s, many: "
+                                            << many_lockfree_rate / 1e6 << " M/s");
+    INFO("Benchmark: mutex bucket, single: " << single_mutex_rate / 1e6 << " M/s, many: " << many_mutex_rate / 1e6
+                                             << " M/s");
+    CHECK(granted[0] > 0);
+    CHECK(granted[1] > 0);
+    CHECK(granted[2] > 0);
+    CHECK(granted[3] > 0);
+}
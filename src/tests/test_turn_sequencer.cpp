@@ -0,0 +1,161 @@
+/*
+ * test_turn_sequencer.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/turn_sequencer.hpp>
+
+// each turn appends itself to the log, returns true if the log is in order
+static bool run_turns(
+    uint32_t first_turn, uint32_t turns, uint32_t threads, std::function<uint32_t(uint32_t, uint32_t)> turn_of
+)
+{
+    ConcurrentFW::TurnSequencer sequencer(first_turn);
+    std::vector<uint32_t> log;
+    log.reserve(turns);
+    std::vector<std::thread> workers;
+    for (uint32_t thread = 0; thread < threads; thread++)
+        workers.emplace_back(
+            [&, thread]()
+            {
+                for (uint32_t index = 0; index < turns / threads; index++)
+                {
+                    const uint32_t turn = first_turn + turn_of(thread, index);
+                    sequencer.wait_for_turn(turn);
+                    log.push_back(turn);
+                    sequencer.complete_turn(turn);
+                }
+            }
+        );
+    for (auto& worker : workers)
+        worker.join();
+
+    bool ordered = log.size() == turns;
+    for (uint32_t index = 0; index < log.size() && ordered; index++)
+        ordered = log[index] == first_turn + index;
+    return ordered;
+}
+
+TEST_CASE("check of turn sequencer", "[turn_sequencer]")
+{
+    ConcurrentFW::TurnSequencer sequencer;
+    CHECK(sequencer.is_turn(0));
+    CHECK_FALSE(sequencer.is_turn(1));
+    CHECK(sequencer.wait_for_turn(0));
+    sequencer.complete_turn(0);
+    CHECK(sequencer.current_turn() == 1);
+    CHECK_FALSE(sequencer.wait_for_turn(0));  // in the past
+    CHECK(sequencer.wait_for_turn(1));
+
+    // a sleeping waiter is woken by its turn
+    bool woken = false;
+    std::thread waiter(
+        [&]()
+        {
+            sequencer.wait_for_turn(3);
+            woken = true;
+            sequencer.complete_turn(3);
+        }
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sequencer.complete_turn(1);
+    sequencer.complete_turn(2);
+    waiter.join();
+    CHECK(woken);
+    CHECK(sequencer.current_turn() == 4);
+
+    // round-robin turns: waiters are close to their turn
+    CHECK(run_turns(0, 64000, 8, [](uint32_t thread, uint32_t index) { return index * 8 + thread; }));
+    // blocks of turns: waiters up to 700 turns ahead, the recorded distance saturates
+    CHECK(run_turns(0, 800, 8, [](uint32_t thread, uint32_t index) { return thread * 100 + index; }));
+    // wrap-around of the turn counter
+    const uint32_t wrap = 1U << ConcurrentFW::TurnSequencer::TURN_BITS;
+    CHECK(run_turns(wrap - 500, 1000, 4, [](uint32_t thread, uint32_t index) { return index * 4 + thread; }));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: ordered commit with 32 workers, against Futex + condition variable
+///////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t work(uint64_t seed)
+{
+    for (uint32_t round = 0; round < 64; round++)
+        seed = (seed ^ (seed >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    return seed;
+}
+
+TEST_CASE("check turn sequencer against condition variable", "[turn_sequencer]")
+{
+    constexpr uint32_t workers {32};
+    constexpr uint32_t turns {workers * 2000};
+
+    auto run = [&](auto&& commit)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t worker = 0; worker < workers; worker++)
+            threads.emplace_back(
+                [&, worker]()
+                {
+                    for (uint32_t turn = worker; turn < turns; turn += workers)
+                        commit(turn, work(turn));
+                }
+            );
+        for (auto& thread : threads)
+            thread.join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<uint64_t> sequencer_log;
+    sequencer_log.reserve(turns);
+    ConcurrentFW::TurnSequencer sequencer;
+    const double sequencer_time = run(
+        [&](uint32_t turn, uint64_t result)
+        {
+            sequencer.wait_for_turn(turn);
+            sequencer_log.push_back(result);
+            sequencer.complete_turn(turn);
+        }
+    );
+
+    std::vector<uint64_t> condvar_log;
+    condvar_log.reserve(turns);
+    ConcurrentFW::Futex futex;
+    std::condition_variable_any condition;
+    uint32_t current = 0;
+    const double condvar_time = run(
+        [&](uint32_t turn, uint64_t result)
+        {
+            std::unique_lock lock(futex);
+            condition.wait(lock, [&]() { return current == turn; });
+            condvar_log.push_back(result);
+            current++;
+            condition.notify_all();
+        }
+    );
+
+    const bool same = sequencer_log == condvar_log;
+    bool ordered = sequencer_log.size() == turns;
+    for (uint32_t turn = 0; turn < sequencer_log.size() && ordered; turn++)
+        ordered = sequencer_log[turn] == work(turn);
+
+    INFO("workers: " << workers << ", turns: " << turns);
+    INFO("Benchmark: TurnSequencer: " << turns / sequencer_time / 1e6 << " M commits/s");
+    INFO("Benchmark: Futex + condition_variable_any: " << turns / condvar_time / 1e6 << " M commits/s");
+    CHECK(ordered);
+    CHECK(same);
+}
@@ -0,0 +1,181 @@
+/*
+ * test_work_stealing_deque.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/atomic.hpp>
+#include <concurrentfw/futex.hpp>
+#include <concurrentfw/work_stealing_deque.hpp>
+
+TEST_CASE("check of work stealing deque", "[work_stealing_deque]")
+{
+    CHECK_THROWS_AS(ConcurrentFW::WorkStealingDeque<uint64_t>(1), std::invalid_argument);
+    CHECK_THROWS_AS(ConcurrentFW::WorkStealingDeque<uint64_t>(6), std::invalid_argument);
+
+    ConcurrentFW::WorkStealingDeque<uint64_t> deque(4);
+    uint64_t item = 0;
+    CHECK(!deque.pop(item));
+    CHECK(!deque.steal(item));
+
+    for (uint64_t i = 0; i < 10; i++)  // grows twice
+        deque.push(i);
+    CHECK(deque.capacity() == 16);
+    CHECK(deque.size_approx() == 10);
+
+    CHECK(deque.steal(item));  // thieves take the oldest
+    CHECK(item == 0);
+    CHECK(deque.pop(item));  // owner takes the newest
+    CHECK(item == 9);
+    for (uint64_t i = 8; i >= 1; i--)
+    {
+        CHECK(deque.pop(item));
+        CHECK(item == i);
+    }
+    CHECK(!deque.pop(item));
+    CHECK(!deque.steal(item));
+    CHECK(deque.size_approx() == 0);
+
+    deque.push(42);  // deque is usable again after it was empty
+    CHECK(deque.steal(item));
+    CHECK(item == 42);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// benchmark: steal-heavy, one owner produces, all other threads steal
+///////////////////////////////////////////////////////////////////////////////////////////
+
+class FutexStealDeque
+{
+public:
+    void push(uint64_t item)
+    {
+        futex.lock();
+        deque.push_back(item);
+        futex.unlock();
+    }
+
+    bool pop(uint64_t& item)
+    {
+        futex.lock();
+        bool available = !deque.empty();
+        if (available)
+        {
+            item = deque.back();
+            deque.pop_back();
+        }
+        futex.unlock();
+        return available;
+    }
+
+    bool steal(uint64_t& item)
+    {
+        futex.lock();
+        bool available = !deque.empty();
+        if (available)
+        {
+            item = deque.front();
+            deque.pop_front();
+        }
+        futex.unlock();
+        return available;
+    }
+
+private:
+    ConcurrentFW::Futex futex {false};
+    std::deque<uint64_t> deque;
+};
+
+struct StealResult
+{
+    std::chrono::nanoseconds duration;
+    size_t stolen;
+    bool complete;
+};
+
+template<typename DEQUE>
+static StealResult run_stealing(DEQUE& deque, uint32_t thieves, uint64_t items)
+{
+    ConcurrentFW::Atomic<uint64_t> taken {0};
+    ConcurrentFW::Atomic<uint64_t> checksum {0};
+    ConcurrentFW::Atomic<size_t> stolen {0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t thief = 0; thief < thieves; thief++)
+        threads.emplace_back(
+            [&]()
+            {
+                uint64_t local_checksum = 0;
+                size_t local_stolen = 0;
+                uint64_t item;
+                while (taken.load<ConcurrentFW::AtomicMemoryOrder::RELAXED>() < items)
+                {
+                    if (deque.steal(item))
+                    {
+                        local_checksum += item;
+                        local_stolen++;
+                        taken.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+                    }
+                    else
+                        std::this_thread::yield();
+                }
+                checksum.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_checksum);
+                stolen.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(local_stolen);
+            }
+        );
+
+    // owner pushes everything and only pops every 8th item itself
+    uint64_t owner_checksum = 0;
+    uint64_t item;
+    for (uint64_t i = 1; i <= items; i++)
+    {
+        deque.push(i);
+        if (i % 8 == 0 && deque.pop(item))
+        {
+            owner_checksum += item;
+            taken.add_fetch<ConcurrentFW::AtomicMemoryOrder::RELAXED>(1);
+        }
+    }
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - start;
+
+    return {
+        duration,
+        stolen.load(),
+        taken.load() == items && checksum.load() + owner_checksum == items * (items + 1) / 2};
+}
+
+TEST_CASE("check work stealing deque with many thieves", "[work_stealing_deque]")
+{
+    const uint32_t thieves = std::max(2U, std::thread::hardware_concurrency() - 1);
+    constexpr uint64_t items {2000000};
+
+    ConcurrentFW::WorkStealingDeque<uint64_t> deque(64);  // grows during the benchmark
+    StealResult result_deque = run_stealing(deque, thieves, items);
+    FutexStealDeque futex_deque;
+    StealResult result_futex = run_stealing(futex_deque, thieves, items);
+
+    auto per_second = [](size_t count, std::chrono::nanoseconds duration)
+    { return static_cast<double>(count) / std::chrono::duration<double>(duration).count(); };
+    INFO("thieves: " << thieves);
+    INFO("Benchmark: WorkStealingDeque: " << per_second(items, result_deque.duration) << " items/s, "
+                                          << result_deque.stolen << " stolen");
+    INFO("Benchmark: Futex + std::deque: " << per_second(items, result_futex.duration) << " items/s, "
+                                           << result_futex.stolen << " stolen");
+    CHECK(result_deque.complete);
+    CHECK(result_futex.complete);
+}
@@ -0,0 +1,198 @@
+/*
+ * thread_pool.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <pthread.h>  // pthread_setaffinity_np()
+#include <sched.h>    // cpu_set_t
+
+#include <vector>
+#include <algorithm>
+#include <system_error>
+
+#include <concurrentfw/thread_pool.hpp>
+#include <concurrentfw/sysconf.hpp>
+
+namespace ConcurrentFW
+{
+
+ThreadPool::ThreadPool(uint32_t worker_count, bool pin_to_cpus)
+{
+    if (worker_count == 0)
+        worker_count = std::max(1U, std::thread::hardware_concurrency());
+    // a cpuset may restrict the process to some of the online CPUs
+    const std::vector<uint32_t> cpus = pin_to_cpus ? allowed_cpus() : std::vector<uint32_t> {};
+
+    workers.reserve(worker_count);
+    for (uint32_t index = 0; index < worker_count; index++)
+        workers.push_back(std::make_unique<Worker>(*this, index));
+    for (auto& worker : workers)  // all deques exist before the first worker steals
+        worker->thread = std::thread(&ThreadPool::worker_loop, this, std::ref(*worker));
+
+    if (pin_to_cpus)
+    {
+        try
+        {
+            for (auto& worker : workers)
+                pin(worker->thread, cpus[worker->index % cpus.size()]);
+        }
+        catch (...)
+        {
+            shutdown();
+            throw;
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait_idle();
+    shutdown();
+}
+
+void ThreadPool::submit_task(PoolTask* task)
+{
+    pending.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    Worker* worker = current_worker;
+    if (worker != nullptr && &worker->pool == this)
+        worker->deque.push(task);
+    else
+        injection.enqueue(task);
+    idle_workers.notify_one();  // only a syscall, if a worker is parked
+}
+
+void ThreadPool::wait_idle()
+{
+    while (true)
+    {
+        EventCount::Key key = idle_pool.prepare_wait();
+        if (pending.load<AtomicMemoryOrder::ACQUIRE>() == 0)
+        {
+            idle_pool.cancel_wait();
+            return;
+        }
+        idle_pool.wait(key);
+    }
+}
+
+int32_t ThreadPool::worker_index() const noexcept
+{
+    Worker* worker = current_worker;
+    return (worker != nullptr && &worker->pool == this) ? static_cast<int32_t>(worker->index) : -1;
+}
+
+size_t ThreadPool::local_backlog() const noexcept
+{
+    Worker* worker = current_worker;
+    return (worker != nullptr && &worker->pool == this) ? worker->deque.size_approx() : 0;
+}
+
+void ThreadPool::worker_loop(Worker& worker)
+{
+    current_worker = &worker;
+    PoolTask* task;
+    while (true)
+    {
+        if (find_task(worker, task))
+        {
+            run_task(task);
+            continue;
+        }
+
+        bool found = false;
+        for (uint32_t spins = 0; spins < SPINS_BEFORE_PARKING && !found; spins++)
+        {
+            cpu_relax();
+            found = find_task(worker, task);
+        }
+        if (found)
+        {
+            run_task(task);
+            continue;
+        }
+
+        EventCount::Key key = idle_workers.prepare_wait();
+        if (find_task(worker, task))
+        {
+            idle_workers.cancel_wait();
+            run_task(task);
+            continue;
+        }
+        if (stopping.load<AtomicMemoryOrder::ACQUIRE>())
+        {
+            idle_workers.cancel_wait();
+            break;
+        }
+        idle_workers.wait(key);
+    }
+    current_worker = nullptr;
+}
+
+bool ThreadPool::find_task(Worker& worker, PoolTask*& task)
+{
+    if (worker.deque.pop(task))
+        return true;
+    if (injection.dequeue(task))
+        return true;
+    return steal_task(worker.random_state, worker.index, task);
+}
+
+bool ThreadPool::steal_task(uint64_t& random_state, uint32_t thief, PoolTask*& task)
+{
+    const uint32_t worker_count = size();
+    for (uint32_t attempt = 0; attempt < worker_count; attempt++)
+    {
+        // xorshift64
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        const uint32_t victim = static_cast<uint32_t>(random_state % worker_count);
+        if (victim != thief && workers[victim]->deque.steal(task))
+            return true;
+    }
+    return false;
+}
+
+bool ThreadPool::help(PoolTask*& task)
+{
+    Worker* worker = current_worker;
+    if (worker != nullptr && &worker->pool == this)
+        return find_task(*worker, task);
+
+    static constinit thread_local uint64_t random_state {0};  // other threads help as thieves
+    if (random_state == 0)
+        random_state = 0x9E3779B97F4A7C15ULL ^ reinterpret_cast<uintptr_t>(&random_state);
+    return injection.dequeue(task) || steal_task(random_state, UINT32_MAX, task);
+}
+
+void ThreadPool::run_task(PoolTask* task) noexcept
+{
+    task->run();
+    task->release();
+    if (pending.sub_fetch<AtomicMemoryOrder::ACQ_REL>(1) == 0)
+        idle_pool.notify_all();
+}
+
+void ThreadPool::shutdown() noexcept
+{
+    stopping.store<AtomicMemoryOrder::RELEASE>(true);
+    idle_workers.notify_all();
+    for (auto& worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+}
+
+void ThreadPool::pin(std::thread& thread, uint32_t cpu)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    const int error = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    if (error != 0)
+        throw std::system_error(error, std::system_category(), "error in pthread_setaffinity_np()");
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,109 @@
+/*
+ * thread_registry.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <stdexcept>
+#include <system_error>
+
+#include <pthread.h>
+
+#include <concurrentfw/thread_registry.hpp>
+
+namespace ConcurrentFW
+{
+
+ThreadRegistry::Slot ThreadRegistry::slots[MAX_THREADS] {};
+Stack ThreadRegistry::free_slots;
+Atomic<uint32_t> ThreadRegistry::used_indices;  // zero initialized before any dynamic initialization
+Atomic<uint32_t> ThreadRegistry::live_count;
+
+// releases the index at thread exit, only constructed by registered threads
+struct ThreadRegistryReleaser
+{
+    bool registered {false};
+
+    ~ThreadRegistryReleaser()
+    {
+        if (registered)
+            ThreadRegistry::unregister_thread();
+    }
+
+    // second path for threads, which register again in a later thread local destructor:
+    // the destructors of pthread keys run after all thread local destructors
+    static void release_late(void* /* slot */) noexcept
+    {
+        ThreadRegistry::unregister_thread();
+    }
+
+    static pthread_key_t late_key()
+    {
+        static const pthread_key_t key = []()
+        {
+            pthread_key_t created;
+            const int error = pthread_key_create(&created, &release_late);
+            if (error != 0) [[unlikely]]
+                throw std::system_error(error, std::system_category(), "error in pthread_key_create()");
+            return created;
+        }();
+        return key;
+    }
+};
+
+static thread_local ThreadRegistryReleaser releaser;
+static constinit thread_local bool exited {false};  // releaser is destroyed, later registrations use the pthread key
+
+uint32_t ThreadRegistry::register_thread()
+{
+    const pthread_key_t late_key = exited ? ThreadRegistryReleaser::late_key() : pthread_key_t {};
+    uint32_t slot_index;
+    Slot* slot = static_cast<Slot*>(free_slots.pop());
+    if (slot != nullptr)
+        slot_index = static_cast<uint32_t>(slot - slots);
+    else
+    {
+        slot_index = used_indices.load<AtomicMemoryOrder::RELAXED>();
+        do
+        {
+            if (slot_index >= MAX_THREADS) [[unlikely]]
+                throw std::length_error("too many threads registered");
+        }
+        while (!used_indices.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(
+            slot_index, slot_index + 1
+        ));
+        slot = &slots[slot_index];
+    }
+
+    slot->live.store<AtomicMemoryOrder::RELEASE>(true);
+    live_count.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    if (exited)
+    {
+        const int error = pthread_setspecific(late_key, slot);
+        if (error != 0) [[unlikely]]
+        {
+            free_slots.push(slot);
+            throw std::system_error(error, std::system_category(), "error in pthread_setspecific()");
+        }
+    }
+    current_index = slot_index + 1;
+    if (!exited)
+        releaser.registered = true;
+    return slot_index;
+}
+
+void ThreadRegistry::unregister_thread() noexcept
+{
+    const uint32_t slot_index = current_index - 1;
+    current_index = 0;
+    exited = true;
+
+    Slot& slot = slots[slot_index];
+    slot.live.store<AtomicMemoryOrder::RELEASE>(false);
+    live_count.sub_fetch<AtomicMemoryOrder::RELAXED>(1);
+    free_slots.push(&slot);
+}
+
+}  // namespace ConcurrentFW
@@ -0,0 +1,304 @@
+/*
+ * timer_wheel.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <ctime>
+#include <bit>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/timer_wheel.hpp>
+
+namespace ConcurrentFW
+{
+
+TimerWheel::TimerWheel(std::chrono::nanoseconds resolution)
+: tick(resolution)
+, start(Clock::now())
+{
+    if (tick.count() <= 0)
+        throw std::invalid_argument("TimerWheel: resolution must be positive");
+    driver = std::thread(&TimerWheel::driver_loop, this);
+}
+
+TimerWheel::~TimerWheel()
+{
+    stopping.store<AtomicMemoryOrder::RELEASE>(true);
+    driver_event.notify_one();
+    driver.join();
+
+    Chunk* chunk = chunks.load<AtomicMemoryOrder::ACQUIRE>();
+    while (chunk != nullptr)  // also destroys the callbacks of pending timers
+        delete std::exchange(chunk, chunk->next);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// any thread
+//////////////////////////////////////////////////////////////////////////
+
+TimerWheel::TimerId TimerWheel::schedule_function(Clock::time_point deadline, std::function<void()>&& callback)
+{
+    Node* node = allocate_node();
+    const uint64_t generation = node->state.load<AtomicMemoryOrder::RELAXED>() >> STATUS_BITS;
+    const uint64_t ticks = deadline_tick(deadline);
+    node->deadline = ticks;
+    node->callback = std::move(callback);
+    node->linked = false;
+    node->inserted = false;
+    node->cancel_seen = false;
+    node->state.store<AtomicMemoryOrder::RELAXED>((generation << STATUS_BITS) | PENDING);
+    insertions.push(node);  // publishes the node, it may already be fired and recycled afterwards
+
+    // memory order: insertion must be visible before the sleep deadline of the driver is checked
+    atomic_thread_fence<AtomicMemoryOrder::SEQ_CST>();
+    if (ticks < sleep_until.load<AtomicMemoryOrder::RELAXED>())
+        driver_event.notify_one();
+    return TimerId(node, generation);
+}
+
+bool TimerWheel::cancel(TimerId timer) noexcept
+{
+    if (timer.node == nullptr)
+        return false;
+    uint64_t expected = (timer.generation << STATUS_BITS) | PENDING;
+    if (!timer.node->state.compare_exchange_strong<AtomicMemoryOrder::ACQ_REL, AtomicMemoryOrder::RELAXED>(
+            expected, (timer.generation << STATUS_BITS) | CANCELLED
+        ))
+        return false;  // fired, cancelled or node already reused
+    timer.node->cancel_link.node = timer.node;
+    cancellations.push(&timer.node->cancel_link);
+    return true;
+}
+
+TimerWheel::Node* TimerWheel::allocate_node()
+{
+    void* block = free_nodes.pop();
+    if (block != nullptr) [[likely]]
+        return static_cast<Node*>(block);
+
+    Chunk* chunk = new Chunk;
+    for (size_t index = 1; index < NODES_PER_CHUNK; index++)
+        free_nodes.push(&chunk->nodes[index]);
+    Chunk* head = chunks.load<AtomicMemoryOrder::RELAXED>();
+    do  // chunks are only pushed, no ABA problem
+        chunk->next = head;
+    while (!chunks.compare_exchange_weak<AtomicMemoryOrder::RELEASE, AtomicMemoryOrder::RELAXED>(head, chunk));
+    chunk_count.add_fetch<AtomicMemoryOrder::RELAXED>(1);
+    return &chunk->nodes[0];
+}
+
+uint64_t TimerWheel::deadline_tick(Clock::time_point deadline) const noexcept
+{
+    if (deadline <= start)
+        return 0;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - start);
+    return static_cast<uint64_t>((elapsed.count() + tick.count() - 1) / tick.count());  // never early
+}
+
+uint64_t TimerWheel::current_tick() const noexcept
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+    return static_cast<uint64_t>(elapsed.count() / tick.count());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// driver thread
+//////////////////////////////////////////////////////////////////////////
+
+void TimerWheel::driver_loop()
+{
+    const auto start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+    while (!stopping.load<AtomicMemoryOrder::ACQUIRE>())
+    {
+        sleep_until.store<AtomicMemoryOrder::RELAXED>(0);  // awake, inserters need not wake us
+        drain();
+        advance(current_tick());
+
+        // wake up at least once per level-0 rotation to recycle cancelled nodes
+        const uint64_t wakeup = std::min(next_expiry(), now_tick + SLOTS);
+        sleep_until.store<AtomicMemoryOrder::RELAXED>(wakeup);
+        EventCount::Key key = driver_event.prepare_wait();
+        if (!insertions.empty() || stopping.load<AtomicMemoryOrder::ACQUIRE>() || wakeup <= current_tick())
+        {
+            driver_event.cancel_wait();
+            continue;
+        }
+        const int64_t deadline_ns = start_ns + static_cast<int64_t>(wakeup) * tick.count();
+        const struct timespec deadline {deadline_ns / 1000000000, deadline_ns % 1000000000};
+        driver_event.wait_deadline(key, &deadline);  // steady_clock is CLOCK_MONOTONIC
+    }
+}
+
+void TimerWheel::drain()
+{
+    insertions.drain(
+        [this](Node* node)
+        {
+            node->inserted = true;
+            if ((node->state.load<AtomicMemoryOrder::ACQUIRE>() & STATUS_MASK) == CANCELLED)
+                dropped(node);
+            else
+                link(node, now_tick + 1);
+        }
+    );
+    cancellations.drain(
+        [this](CancelLink* cancel_link)
+        {
+            Node* node = cancel_link->node;
+            node->cancel_seen = true;
+            if (node->linked)
+                unlink(node);
+            if (node->inserted)  // otherwise recycled when the insertion is drained
+                recycle(node);
+        }
+    );
+}
+
+void TimerWheel::advance(uint64_t target_tick)
+{
+    while (now_tick < target_tick)
+    {
+        if (occupied[0] == 0)  // nothing to expire up to the next level-0 rotation
+        {
+            bool empty = true;
+            for (uint32_t level = 1; level < LEVELS && empty; level++)
+                empty = occupied[level] == 0;
+            if (empty)
+            {
+                now_tick = target_tick;
+                return;
+            }
+            now_tick = std::min(target_tick, now_tick | (SLOTS - 1));
+            if (now_tick == target_tick)
+                return;
+        }
+
+        now_tick++;
+        for (uint32_t level = 1; level < LEVELS; level++)
+        {
+            if ((now_tick & ((1ULL << (level * SLOT_BITS)) - 1)) != 0)
+                break;
+            cascade(level, static_cast<uint32_t>(now_tick >> (level * SLOT_BITS)) & (SLOTS - 1));
+        }
+        expire(static_cast<uint32_t>(now_tick) & (SLOTS - 1));
+    }
+}
+
+void TimerWheel::link(Node* node, uint64_t earliest_tick) noexcept
+{
+    constexpr uint64_t range {1ULL << (LEVELS * SLOT_BITS)};
+    uint64_t deadline = std::max(node->deadline, earliest_tick);
+    if (deadline - now_tick >= range)  // cascaded again later
+        deadline = now_tick + range - 1;
+
+    const uint64_t delta = deadline - now_tick;
+    uint32_t level = 0;
+    while (delta >= (1ULL << ((level + 1) * SLOT_BITS)))
+        level++;
+    const uint32_t index = static_cast<uint32_t>(deadline >> (level * SLOT_BITS)) & (SLOTS - 1);
+
+    Node*& head = slots[level][index];
+    node->slot = level * SLOTS + index;
+    node->previous = nullptr;
+    node->next_in_slot = head;
+    if (head != nullptr)
+        head->previous = node;
+    head = node;
+    occupied[level] |= 1ULL << index;
+    node->linked = true;
+}
+
+void TimerWheel::unlink(Node* node) noexcept
+{
+    const uint32_t level = node->slot / SLOTS;
+    const uint32_t index = node->slot % SLOTS;
+    if (node->previous != nullptr)
+        node->previous->next_in_slot = node->next_in_slot;
+    else
+        slots[level][index] = node->next_in_slot;
+    if (node->next_in_slot != nullptr)
+        node->next_in_slot->previous = node->previous;
+    if (slots[level][index] == nullptr)
+        occupied[level] &= ~(1ULL << index);
+    node->linked = false;
+}
+
+TimerWheel::Node* TimerWheel::take_slot(uint32_t level, uint32_t index) noexcept
+{
+    Node* list = std::exchange(slots[level][index], nullptr);
+    occupied[level] &= ~(1ULL << index);
+    return list;
+}
+
+void TimerWheel::cascade(uint32_t level, uint32_t index) noexcept
+{
+    Node* node = take_slot(level, index);
+    while (node != nullptr)
+    {
+        Node* next = node->next_in_slot;
+        node->linked = false;
+        if ((node->state.load<AtomicMemoryOrder::ACQUIRE>() & STATUS_MASK) == CANCELLED)
+            dropped(node);
+        else
+            link(node, now_tick);  // due now: expired in this tick
+        node = next;
+    }
+}
+
+void TimerWheel::expire(uint32_t index)
+{
+    Node* node = take_slot(0, index);
+    while (node != nullptr)
+    {
+        Node* next = node->next_in_slot;
+        node->linked = false;
+        uint64_t expected = node->state.load<AtomicMemoryOrder::RELAXED>();
+        if ((expected & STATUS_MASK) == PENDING
+            && node->state.compare_exchange_strong<AtomicMemoryOrder::ACQ_REL, AtomicMemoryOrder::RELAXED>(
+                expected, (expected & ~STATUS_MASK) | FIRED
+            ))
+        {
+            node->callback();
+            recycle(node);
+        }
+        else
+            dropped(node);
+        node = next;
+    }
+}
+
+void TimerWheel::dropped(Node* node) noexcept
+{
+    if (node->cancel_seen)  // otherwise recycled when the cancellation is drained
+        recycle(node);
+}
+
+void TimerWheel::recycle(Node* node) noexcept
+{
+    node->callback = nullptr;
+    const uint64_t generation = (node->state.load<AtomicMemoryOrder::RELAXED>() >> STATUS_BITS) + 1;
+    node->state.store<AtomicMemoryOrder::RELEASE>((generation << STATUS_BITS) | FREE);
+    free_nodes.push(node);
+}
+
+uint64_t TimerWheel::next_expiry() const noexcept
+{
+    uint64_t next = NO_EXPIRY;
+    for (uint32_t level = 0; level < LEVELS; level++)
+    {
+        if (occupied[level] == 0)
+            continue;
+        // slot index of the current tick at this level, the first candidate is the following slot
+        const uint64_t base = now_tick >> (level * SLOT_BITS);
+        const int rotation = static_cast<int>((base + 1) & (SLOTS - 1));
+        const uint64_t steps = static_cast<uint64_t>(std::countr_zero(std::rotr(occupied[level], rotation))) + 1;
+        next = std::min(next, (base + steps) << (level * SLOT_BITS));
+    }
+    return next;
+}
+
+}  // namespace ConcurrentFW
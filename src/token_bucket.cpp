@@ -0,0 +1,56 @@
+/*
+ * token_bucket.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <cmath>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+#include <concurrentfw/token_bucket.hpp>
+
+namespace ConcurrentFW
+{
+
+TokenBucket::TokenBucket(double tokens_per_second, uint32_t burst)
+: start(Clock::now())
+, units_per_token(units_per_token_of(tokens_per_second))
+, capacity(burst)
+, nanoseconds_per_token(1e9 / tokens_per_second)
+, state(burst)  // full, timestamp 0
+{
+    if (burst == 0 || burst > MAX_BURST)
+        throw std::invalid_argument("TokenBucket: burst out of range");
+}
+
+uint64_t TokenBucket::units_per_token_of(double tokens_per_second)
+{
+    // validated before the conversion, an infinite time per token cannot be converted to an integer
+    if (!(tokens_per_second > 0) || !std::isfinite(tokens_per_second)
+        || 1e9 / tokens_per_second / (1U << TIME_UNIT_SHIFT) >= static_cast<double>(TIME_MASK / 2))
+        throw std::invalid_argument("TokenBucket: rate out of range");
+    return static_cast<uint64_t>(
+        std::max(1.0, std::round(1e9 / tokens_per_second / (1U << TIME_UNIT_SHIFT) * (1U << FRACTION_BITS)))
+    );
+}
+
+void TokenBucket::acquire(uint32_t tokens)
+{
+    if (tokens > capacity)
+        throw std::invalid_argument("TokenBucket: more tokens requested than the burst");
+    while (!try_consume(tokens))
+    {
+        // sleep for the refill time of the missing tokens, at least one time unit
+        const uint32_t missing = tokens - std::min(tokens, available());
+        const auto wait = std::chrono::nanoseconds(static_cast<int64_t>(
+            std::max(nanoseconds_per_token * missing, static_cast<double>(1U << TIME_UNIT_SHIFT))
+        ));
+        std::this_thread::sleep_for(wait);
+    }
+}
+
+}  // namespace ConcurrentFW
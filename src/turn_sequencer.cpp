@@ -0,0 +1,56 @@
+/*
+ * turn_sequencer.cpp
+ *
+ * (C) 2023 by Simon Gleissner <simon@gleissner.de>, http://concurrentfw.de
+ *
+ * This file is distributed under the MIT license, see file LICENSE.
+ */
+
+#include <cerrno>
+#include <algorithm>
+#include <system_error>
+
+#include <concurrentfw/turn_sequencer.hpp>
+
+namespace ConcurrentFW
+{
+
+bool TurnSequencer::wait_slow(uint32_t turn)
+{
+    const uint32_t own = turn << DELTA_BITS;
+    uint32_t spins = 0;
+    while (true)
+    {
+        uint32_t state = static_cast<uint32_t>(value.load<AtomicMemoryOrder::ACQUIRE>());
+        const uint32_t current = state & ~DELTA_MASK;
+        if (current == own)
+            return true;
+        if (own - current >= 1U << 31)  // wrap-safe: turn is in the past
+            return false;
+
+        const uint32_t delta = (own - current) >> DELTA_BITS;
+        if (delta <= SPIN_DISTANCE && spins < SPINS_BEFORE_PARKING)
+        {
+            spins++;
+            cpu_relax();
+            continue;
+        }
+
+        const uint32_t recorded = std::min(delta, DELTA_MASK);
+        if (recorded > (state & DELTA_MASK))
+        {
+            int expected = static_cast<int>(state);
+            state = current | recorded;
+            if (!value.compare_exchange_strong<AtomicMemoryOrder::RELAXED, AtomicMemoryOrder::RELAXED>(
+                    expected, static_cast<int>(state)
+                ))
+                continue;
+        }
+        // EAGAIN: the turn or the recorded distance has changed
+        if ((futex_wait_bitset(channel(turn), static_cast<int>(state), nullptr) != 0) && (errno != EAGAIN)
+            && (errno != EINTR)) [[unlikely]]
+            throw std::system_error(errno, std::system_category(), "FutexBase::futex_wait_bitset()");
+    }
+}
+
+}  // namespace ConcurrentFW